@@ -0,0 +1,19 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace vkext {
+// Converts tightly packed texels to 8-bit RGBA. Float formats are clamped
+// to [0, 1] without tone mapping. Throws for unsupported formats.
+std::vector<uint8_t> toRgba8(VkFormat format, VkExtent3D extent,
+                             std::span<std::byte const> data);
+
+// Writes an RGBA8 PNG through stb_image_write.
+void writePng(std::filesystem::path const &path, uint32_t width,
+              uint32_t height, std::span<uint8_t const> rgba);
+
+void writeRaw(std::filesystem::path const &path,
+              std::span<std::byte const> data);
+}
\ No newline at end of file
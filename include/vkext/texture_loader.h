@@ -0,0 +1,122 @@
+#pragma once
+#include <vkt/upload_context.h>
+#include <vkt/image_view.h>
+#include <filesystem>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+namespace vkext {
+struct TextureLoaderCreateInfo {
+  // 0 picks one worker per hardware thread, minus the caller's.
+  uint32_t workerCount = 0;
+  // Decoded texels held by workers until they are copied into the staging
+  // ring. A single texture larger than this is decoded on its own.
+  size_t maxBytesInFlight = (size_t)256 << 20;
+  // Largest dimension of the low-resolution copy made available before the
+  // full image; 0 uploads only the full image.
+  uint32_t placeholderSize = 64;
+  VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT;
+  VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  std::set<uint32_t> queueFamilyIndices;
+  // Needs an UploadContext with a MipGenerator.
+  bool generateMips = false;
+  VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+  VkAccessFlags dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  VkImageLayout dstLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+};
+
+enum class TextureState { Queued, Placeholder, Resident, Failed };
+
+class Texture {
+public:
+  explicit Texture(std::filesystem::path path);
+
+  // Latest level of detail whose upload has completed, or null.
+  std::shared_ptr<Image> getImage() const;
+  std::shared_ptr<ImageView> getView() const;
+  TextureState getState() const;
+  // Bumped whenever getImage() changes, so that descriptors referring to
+  // the previous view can be rewritten.
+  uint32_t getGeneration() const;
+
+  std::filesystem::path const path;
+
+private:
+  friend class TextureLoader;
+
+  struct Version {
+    std::shared_ptr<Image> image;
+    std::shared_ptr<ImageView> view;
+    UploadToken token;
+    TextureState state;
+  };
+
+  mutable std::mutex mutex;
+  std::shared_ptr<Image> image = {};
+  std::shared_ptr<ImageView> view = {};
+  TextureState state = TextureState::Queued;
+  uint32_t generation = 0;
+  std::vector<Version> pending;
+
+  // Publishes the newest pending version whose upload has completed and,
+  // when `needsAcquire`, whose ownership is covered by `acquired`.
+  bool update(UploadContext &uploadContext, UploadToken acquired,
+              bool needsAcquire);
+};
+
+// Decodes images on a pool of worker threads and hands them straight to an
+// UploadContext, so that decoding overlaps the staging copies.
+class TextureLoader {
+public:
+  TextureLoader(std::shared_ptr<Device> device,
+                std::shared_ptr<UploadContext> uploadContext,
+                TextureLoaderCreateInfo const &createInfo = {});
+
+  TextureLoader(TextureLoader const &) = delete;
+  TextureLoader &operator=(TextureLoader const &) = delete;
+
+  ~TextureLoader();
+
+  // Returns immediately; the texture has no image until a later poll().
+  std::shared_ptr<Texture> load(std::filesystem::path const &path);
+
+  // Submits what the workers uploaded since the last call and publishes
+  // completed uploads. Returns the number of textures whose image changed.
+  // Call once per frame.
+  uint32_t poll();
+
+  // Records the acquire of every texture uploaded so far into `recording`,
+  // which must run on the UploadContext's dstQueueFamilyIndex. With
+  // EXCLUSIVE sharing across families, textures are only published by
+  // poll() once acquired, so call this each frame before poll() and make
+  // the submission of `recording` wait on the returned semaphores.
+  OwnershipAcquire acquireOwnership(CommandBufferRecording &recording);
+
+  // Blocks until every queued texture is decoded, uploaded and published.
+  void waitIdle();
+
+private:
+  std::shared_ptr<Device> device = {};
+  std::shared_ptr<UploadContext> uploadContext = {};
+  TextureLoaderCreateInfo createInfo;
+
+  std::mutex mutex;
+  std::condition_variable jobReady, budgetFreed, jobsDone;
+  std::deque<std::shared_ptr<Texture>> jobs;
+  std::vector<std::shared_ptr<Texture>> loading;
+  size_t bytesInFlight = 0;
+  uint32_t jobsRunning = 0;
+  bool uploadsSinceFlush = false;
+  UploadToken acquired = {};
+  bool stopping = false;
+
+  std::vector<std::jthread> workers;
+
+  void work();
+  void decode(Texture &texture);
+  Texture::Version upload(void const *texels, uint32_t width,
+                          uint32_t height, bool placeholder);
+};
+}
\ No newline at end of file
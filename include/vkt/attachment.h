@@ -0,0 +1,49 @@
+#pragma once
+#include <vkt/device.h>
+#include <vkt/image.h>
+#include <vkt/image_view.h>
+
+struct AttachmentCreateInfo {
+  // VK_FORMAT_UNDEFINED picks a depth format, with a stencil aspect only if
+  // `stencil` is set.
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  VkExtent2D extent;
+  VkImageUsageFlags usage;
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+  // Contents never leave the render pass, so tiled GPUs may keep them in
+  // on-chip memory. Ignored when `usage` reads the image outside a pass.
+  bool transient = true;
+  bool stencil = false;
+};
+
+class Attachment {
+public:
+  Attachment() = default;
+  Attachment(std::shared_ptr<Device> device,
+             AttachmentCreateInfo const &createInfo);
+
+  operator VkImageView();
+
+  std::shared_ptr<Image> getImage() const;
+  std::shared_ptr<ImageView> getView() const;
+  VkFormat getFormat() const;
+  VkImageAspectFlags getAspects() const;
+  bool isTransient() const;
+
+  // The image is only recreated when it is too small for the new extent,
+  // since framebuffers may be smaller than their attachments. Returns
+  // whether it was recreated.
+  bool resize(VkExtent2D extent);
+
+  VkAttachmentDescription
+  description(VkAttachmentLoadOp loadOp, VkImageLayout finalLayout,
+              VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED) const;
+
+private:
+  std::shared_ptr<Device> device = {};
+  AttachmentCreateInfo createInfo = {};
+  std::shared_ptr<Image> image = {};
+  std::shared_ptr<ImageView> view = {};
+
+  void create();
+};
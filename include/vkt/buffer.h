@@ -3,12 +3,14 @@
 #include <set>
 #include <vkt/queue.h>
 #include <vkt/device_memory.h>
+#include <vkt/memory_allocator.h>
 
 struct BufferCreateInfo {
   VkDeviceSize size;
   VkBufferUsageFlags usage;
   VkSharingMode sharingMode;
   std::set<uint32_t> queueFamilyIndices;
+  VkExternalMemoryHandleTypeFlags externalMemoryHandleTypes = 0;
 };
 
 class Buffer {
@@ -16,17 +18,33 @@ public:
   Buffer() = default;
   Buffer(std::shared_ptr<Device> device, BufferCreateInfo const &createInfo);
 
-  DeviceMemory &allocMemory(VkMemoryPropertyFlags properties);
+  // Wraps host memory in a buffer without copying it. [data, data + size)
+  // must outlive the buffer and stay unmodified while the GPU reads it.
+  // Returns null when the device cannot import it, including when `data` or
+  // `size` is not a multiple of Device::getHostPointerAlignment().
+  static std::shared_ptr<Buffer>
+  importHostMemory(std::shared_ptr<Device> device, void const *data,
+                   VkDeviceSize size,
+                   VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+  MemoryAllocation &allocMemory(VkMemoryPropertyFlags properties,
+                                VkMemoryPropertyFlags preferred = 0,
+                                VkMemoryPropertyFlags avoided = 0);
+  void bindMemory(std::shared_ptr<MemoryAllocation> allocation);
   void bindMemory(std::shared_ptr<DeviceMemory> deviceMemory,
                   VkDeviceSize offset = 0);
 
   VkMemoryRequirements getMemoryRequirements();
+  VkSharingMode getSharingMode() const;
+  // Blocking one-off upload; batch through UploadContext instead. Copies
+  // straight from `data` when it can be imported.
   void stage(const void *data, VkDeviceSize size, Queue &transferQueue);
 
   operator VkBuffer();
 
 private:
   std::shared_ptr<Device> device = {};
+  std::shared_ptr<MemoryAllocation> memory;
   Handle<VkBuffer, Device> buffer = {};
-  std::shared_ptr<DeviceMemory> memory;
+  VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 };
\ No newline at end of file
@@ -0,0 +1,107 @@
+#pragma once
+#include <vkt/device_dispatch.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Capture files start with captureMagic and captureVersion, followed by
+// records of {CaptureOp op, uint32_t size, size bytes of payload}. Handles
+// are stored as the 64-bit values the capturing process saw and serve as
+// ids; structs are stored as raw bytes, so a file is only readable on the
+// ABI that wrote it.
+constexpr uint32_t captureMagic = 0x43544b56; // "VKTC"
+constexpr uint32_t captureVersion = 2;
+
+enum class CaptureOp : uint32_t {
+  Device = 1,
+  Frame,
+  AllocateMemory,
+  HostWrite,
+  CreateBuffer,
+  BindBufferMemory,
+  DestroyBuffer,
+  CreateImage,
+  BindImageMemory,
+  DestroyImage,
+  SwapchainImage,
+  CopyMemoryToImage,
+  TransitionImageLayout,
+  CreateImageView,
+  CreateSampler,
+  CreateShaderModule,
+  CreateDescriptorSetLayout,
+  CreatePipelineLayout,
+  CreateDescriptorPool,
+  AllocateDescriptorSets,
+  UpdateDescriptorSets,
+  CreateRenderPass,
+  CreateFramebuffer,
+  CreateComputePipeline,
+  CreateGraphicsPipeline,
+  AllocateCommandBuffers,
+  Submit,
+
+  BeginCommandBuffer = 100,
+  EndCommandBuffer,
+  CmdBeginRenderPass,
+  CmdEndRenderPass,
+  CmdNextSubpass,
+  CmdBeginRendering,
+  CmdEndRendering,
+  CmdClearColorImage,
+  CmdBindPipeline,
+  CmdSetViewport,
+  CmdSetScissor,
+  CmdPipelineBarrier,
+  CmdBindVertexBuffers,
+  CmdBindIndexBuffer,
+  CmdBindDescriptorSets,
+  CmdPushConstants,
+  CmdCopyBuffer,
+  CmdCopyBufferToImage,
+  CmdCopyImageToBuffer,
+  CmdBlitImage,
+  CmdDraw,
+  CmdDrawIndexed,
+  CmdDrawIndirect,
+  CmdDrawIndexedIndirect,
+  CmdDrawIndexedIndirectCount,
+  CmdDrawMulti,
+  CmdDrawMultiIndexed,
+  CmdDispatch,
+  CmdExecuteCommands,
+  CmdPipelineBarrier2,
+};
+
+struct DeviceCreateInfo;
+class Device;
+
+// Records everything a device creates, records and submits into a file that
+// the replay tool re-issues on another device. It works by swapping the
+// device's dispatch table for recording trampolines, so every wrapper is
+// covered without knowing about it, and restores the table when destroyed.
+//
+// Contents of mapped and imported host memory are diffed at every queue
+// submission and stored as HostWrite records. Semaphores, fences, queries
+// and the destruction of objects other than buffers and images are not
+// recorded. Only one capture can be active per process.
+class Capture {
+public:
+  Capture(Device &device, std::string const &path,
+          DeviceCreateInfo const &deviceCreateInfo);
+
+  Capture(Capture const &) = delete;
+  Capture &operator=(Capture const &) = delete;
+
+  ~Capture();
+
+  // Marks the end of a frame for applications that do not present; presents
+  // mark one on their own.
+  void frame();
+
+  struct State;
+
+private:
+  Device &device;
+  std::unique_ptr<State> state;
+};
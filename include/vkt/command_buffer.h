@@ -4,7 +4,15 @@
 #include <vkt/render_pass.h>
 #include <vkt/framebuffer.h>
 #include <vkt/graphics_pipeline.h>
+#include <vkt/image_view.h>
 #include <vkt/buffer.h>
+#include <array>
+#include <initializer_list>
+#include <span>
+
+// Push constant space every implementation provides; larger blocks are
+// rejected at compile time by pushConstants<T>().
+constexpr uint32_t minPushConstantsSize = 128;
 
 struct CommandBufferAllocateInfo {
   std::shared_ptr<CommandPool> commandPool;
@@ -20,48 +28,65 @@ public:
 
   void reset(VkCommandBufferResetFlags flags = {});
 
-#define CMD_BUF_DEFS(MACRO)                                                    \
-  MACRO(vkBeginCommandBuffer);                                                 \
-  MACRO(vkEndCommandBuffer);                                                   \
-  MACRO(vkCmdBeginRenderPass);                                                 \
-  MACRO(vkCmdEndRenderPass);                                                   \
-  MACRO(vkCmdClearColorImage);                                                 \
-  MACRO(vkCmdBindPipeline);                                                    \
-  MACRO(vkCmdSetViewport);                                                     \
-  MACRO(vkCmdSetScissor);                                                      \
-  MACRO(vkCmdDraw);                                                            \
-  MACRO(vkResetCommandBuffer);                                                 \
-  MACRO(vkCmdPipelineBarrier);                                                 \
-  MACRO(vkCmdBindVertexBuffers);                                               \
-  MACRO(vkCmdCopyBuffer);                                                      \
-  MACRO(vkCmdDrawIndexed);                                                     \
-  MACRO(vkCmdBindIndexBuffer);                                                 \
-  MACRO(vkCmdBindDescriptorSets);                                              \
-  MACRO(vkCmdCopyBufferToImage);                                               \
-  MACRO(vkCmdNextSubpass)
-
-#define MEMBER(name) PFN_##name name
-  CMD_BUF_DEFS(MEMBER);
-#undef MEMBER
+  Device &getDevice() const;
+
+  // Keeps `object` alive until the command buffer is next begun or reset,
+  // by which time the submission that used it must have completed. Repeated
+  // retains of the most recent object are free.
+  void retain(std::shared_ptr<void> const &object);
+  // Drops what was retained; for buffers reset through their pool.
+  void releaseRetained();
+
+  // Borrowed from the device; command buffers load no functions themselves.
+  DeviceDispatch const &dispatch;
 
 private:
   std::shared_ptr<Device> device;
   Handle<VkCommandBuffer, Device, CommandPool> commandBuffer = {};
+  // Cleared but not shrunk between recordings.
+  std::vector<std::shared_ptr<void>> retained;
+
+  // Barriers batched by CommandBufferRecording and not yet issued; also
+  // cleared but not shrunk. The legacy arrays are only used to issue them
+  // through vkCmdPipelineBarrier without synchronization2.
+  struct PendingBarriers {
+    VkDependencyFlags dependencyFlags = {};
+    std::optional<VkMemoryBarrier2> memory = {};
+    std::vector<VkBufferMemoryBarrier2> buffers;
+    std::vector<VkImageMemoryBarrier2> images;
+    std::vector<VkBufferMemoryBarrier> legacyBuffers;
+    std::vector<VkImageMemoryBarrier> legacyImages;
+  } pendingBarriers;
+
+  friend class CommandBufferRecording;
+};
 
-  void loadFunctions();
+struct CommandBufferInheritanceInfo {
+  // Null when continuing dynamic rendering.
+  std::shared_ptr<RenderPass> renderPass;
+  uint32_t subpass = 0;
+  // Optional; naming it may let the driver optimise the secondary buffer.
+  std::shared_ptr<Framebuffer> framebuffer = {};
+  // Attachment formats of the dynamic rendering being continued.
+  std::optional<PipelineRenderingCreateInfo> renderingInfo = {};
+  VkSampleCountFlagBits rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 };
 
 struct CommandBufferBeginInfo {
   VkCommandBufferUsageFlags flags;
+  // Required for secondary command buffers.
+  std::optional<CommandBufferInheritanceInfo> inheritanceInfo = {};
 };
 
+// Barriers may leave sType and pNext unset. Without any barriers this is an
+// execution dependency.
 struct DependencyInfo {
   VkPipelineStageFlags srcStageMask;
   VkPipelineStageFlags dstStageMask;
   VkDependencyFlags dependencyFlags;
-  mutable std::vector<VkMemoryBarrier> memoryBarriers;
-  mutable std::vector<VkBufferMemoryBarrier> bufferMemoryBarriers;
-  mutable std::vector<VkImageMemoryBarrier> imageMemoryBarriers;
+  std::vector<VkMemoryBarrier> memoryBarriers;
+  std::vector<VkBufferMemoryBarrier> bufferMemoryBarriers;
+  std::vector<VkImageMemoryBarrier> imageMemoryBarriers;
 };
 
 struct CopyBufferToImageInfo {
@@ -71,6 +96,48 @@ struct CopyBufferToImageInfo {
   std::vector<VkBufferImageCopy> regions;
 };
 
+struct CopyImageToBufferInfo {
+  VkImage srcImage;
+  VkImageLayout srcImageLayout;
+  VkBuffer dstBuffer;
+  std::vector<VkBufferImageCopy> regions;
+};
+
+struct BlitImageInfo {
+  VkImage srcImage;
+  VkImageLayout srcImageLayout;
+  VkImage dstImage;
+  VkImageLayout dstImageLayout;
+  std::vector<VkImageBlit> regions;
+  VkFilter filter;
+};
+
+// What CommandBufferRecording did with the barriers given to it.
+struct BarrierCounts {
+  // Pipeline barrier commands issued and the barriers they carried.
+  uint32_t batches = 0;
+  uint32_t barriers = 0;
+  // Barriers folded into another one of their batch.
+  uint32_t merged = 0;
+  // Barriers that ordered nothing: no layout or ownership change, and no
+  // source or no destination stages.
+  uint32_t dropped = 0;
+};
+
+// Barriers given to a recording are not recorded right away but collected
+// and issued as one vkCmdPipelineBarrier2 before the next command that
+// could depend on them: any other command of the recording, the begin of a
+// CommandBufferRenderPass on it, or the end of the recording. Global memory
+// barriers are merged into one, buffer barriers on the same buffer into one
+// covering both ranges, and consecutive image barriers on the same
+// subresources into one transition from the first's old layout to the
+// last's new one. Ownership transfers are only merged when identical. A
+// barrier whose source stages include the batch's destination stages starts
+// a new batch, since barriers of one command do not chain.
+//
+// Without the synchronization2 feature a batch is issued through
+// vkCmdPipelineBarrier with the union of its stage masks, and stage or
+// access bits beyond the first 32 are rejected.
 class CommandBufferRecording {
 public:
   CommandBufferRecording(std::shared_ptr<CommandBuffer> commandBuffer,
@@ -83,23 +150,94 @@ public:
 
   void clearColorImage(VkImage image, VkImageLayout imageLayout,
                        VkClearColorValue const &color,
-                       std::vector<VkImageSubresourceRange> const &ranges);
+                       std::span<VkImageSubresourceRange const> ranges);
+  void
+  clearColorImage(VkImage image, VkImageLayout imageLayout,
+                  VkClearColorValue const &color,
+                  std::initializer_list<VkImageSubresourceRange> ranges);
 
   void copyBuffer(VkBuffer source, VkBuffer dest,
-                  std::vector<VkBufferCopy> const &regions);
+                  std::span<VkBufferCopy const> regions);
+  void copyBuffer(VkBuffer source, VkBuffer dest,
+                  std::initializer_list<VkBufferCopy> regions);
 
   void bindDescriptorSets(VkPipelineBindPoint pipelineBindPoint,
                           VkPipelineLayout layout, uint32_t firstSet,
-                          std::vector<VkDescriptorSet> const &descriptorSets,
-                          std::optional<std::vector<uint32_t>> const
-                              &dynamicOffsets = std::nullopt);
-
+                          std::span<VkDescriptorSet const> descriptorSets,
+                          std::span<uint32_t const> dynamicOffsets = {});
+  void bindDescriptorSets(VkPipelineBindPoint pipelineBindPoint,
+                          VkPipelineLayout layout, uint32_t firstSet,
+                          std::initializer_list<VkDescriptorSet> descriptorSets,
+                          std::initializer_list<uint32_t> dynamicOffsets = {});
+
+  void pushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags,
+                     uint32_t offset, uint32_t size, void const *values);
+
+  template <typename T>
+  void pushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags,
+                     uint32_t offset, T const &value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(sizeof(T) % 4 == 0, "push constants are 4-byte words");
+    static_assert(sizeof(T) <= minPushConstantsSize,
+                  "exceeds the guaranteed push constant budget");
+    pushConstants(layout, stageFlags, offset, sizeof(T), &value);
+  }
+
+  // sType and pNext are filled in.
+  void barrier(VkMemoryBarrier2 const &memoryBarrier,
+               VkDependencyFlags dependencyFlags = {});
+  void barrier(VkBufferMemoryBarrier2 const &bufferMemoryBarrier,
+               VkDependencyFlags dependencyFlags = {});
+  void barrier(VkImageMemoryBarrier2 const &imageMemoryBarrier,
+               VkDependencyFlags dependencyFlags = {});
+
+  // Issues the batched barriers now.
+  void flushBarriers();
+
+  // Batched as barrier() with the info's stage masks on every barrier.
   void pipelineBarrier(DependencyInfo const &depInfo);
 
+  // Issued right away, after the batched barriers. Barriers are passed
+  // through as they are, so their sType must be set.
+  void pipelineBarrier(
+      VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask,
+      VkDependencyFlags dependencyFlags,
+      std::span<VkMemoryBarrier const> memoryBarriers,
+      std::span<VkBufferMemoryBarrier const> bufferMemoryBarriers = {},
+      std::span<VkImageMemoryBarrier const> imageMemoryBarriers = {});
+
   void copyBufferToImage(CopyBufferToImageInfo const &copyInfo);
 
+  void copyImageToBuffer(CopyImageToBufferInfo const &copyInfo);
+
+  void blitImage(BlitImageInfo const &blitInfo);
+
+  void bindPipeline(VkPipelineBindPoint pipelineBindPoint, VkPipeline pipeline);
+
+  void dispatch(uint32_t groupCountX, uint32_t groupCountY,
+                uint32_t groupCountZ);
+
+  void executeCommands(
+      std::span<std::shared_ptr<CommandBuffer> const> commandBuffers);
+  void executeCommands(
+      std::initializer_list<std::shared_ptr<CommandBuffer>> commandBuffers);
+
+  BarrierCounts const &getBarrierCounts() const;
+
 public:
   std::shared_ptr<CommandBuffer> commandBuffer;
+  // Set when recording a secondary buffer that continues a render pass.
+  std::optional<CommandBufferInheritanceInfo> inheritanceInfo;
+
+private:
+  bool synchronization2 = false;
+  BarrierCounts barrierCounts = {};
+
+  // Flushes the batch unless a barrier with these flags and source stages
+  // can join it.
+  void batchWith(VkDependencyFlags dependencyFlags,
+                 VkPipelineStageFlags2 srcStageMask);
+  void flushLegacyBarriers();
 };
 
 struct RenderPassBeginInfo {
@@ -110,25 +248,113 @@ struct RenderPassBeginInfo {
   VkSubpassContents subpassContents;
 };
 
+struct RenderingAttachmentInfo {
+  std::shared_ptr<ImageView> imageView;
+  VkImageLayout imageLayout;
+  VkAttachmentLoadOp loadOp;
+  VkAttachmentStoreOp storeOp;
+  VkClearValue clearValue = {};
+  VkResolveModeFlagBits resolveMode = VK_RESOLVE_MODE_NONE;
+  std::shared_ptr<ImageView> resolveImageView = {};
+  VkImageLayout resolveImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+// Begins dynamic rendering straight on image views, with no RenderPass or
+// Framebuffer. Layout transitions are up to the caller.
+struct RenderingInfo {
+  // VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT to draw through
+  // executeCommands().
+  VkRenderingFlags flags = {};
+  VkRect2D renderArea;
+  uint32_t layerCount = 1;
+  uint32_t viewMask = 0;
+  std::vector<RenderingAttachmentInfo> colorAttachments;
+  std::optional<RenderingAttachmentInfo> depthAttachment = {};
+  std::optional<RenderingAttachmentInfo> stencilAttachment = {};
+};
+
+// Number of calls CommandBufferRenderPass skipped because they would have
+// rebound state that was already current.
+struct ElidedStateCounts {
+  uint32_t pipelines = 0;
+  uint32_t descriptorSets = 0;
+  uint32_t vertexBuffers = 0;
+  uint32_t indexBuffers = 0;
+  uint32_t viewports = 0;
+  uint32_t scissors = 0;
+};
+
+// Objects passed by shared_ptr are retained by the command buffer for the
+// rest of its submission; those passed as handles or references must be
+// kept alive by the caller.
+//
+// Bound state is tracked by handle, and binds that change nothing are not
+// recorded. Tracking restarts after nextSubpass() and executeCommands().
 class CommandBufferRenderPass {
 public:
   CommandBufferRenderPass(std::shared_ptr<CommandBufferRecording> recording,
                           RenderPassBeginInfo const &renderPassInfo);
+  // The recording must outlive the render pass.
+  CommandBufferRenderPass(CommandBufferRecording &recording,
+                          RenderPassBeginInfo const &renderPassInfo);
+
+  // Dynamic rendering; requires the dynamicRendering feature and pipelines
+  // created with renderingInfo. nextSubpass() may not be used.
+  CommandBufferRenderPass(std::shared_ptr<CommandBufferRecording> recording,
+                          RenderingInfo const &renderingInfo);
+  CommandBufferRenderPass(CommandBufferRecording &recording,
+                          RenderingInfo const &renderingInfo);
+
+  // Continues the render pass of a secondary recording begun with
+  // RENDER_PASS_CONTINUE and inheritance info; nothing is begun or ended.
+  CommandBufferRenderPass(std::shared_ptr<CommandBufferRecording> recording);
+  CommandBufferRenderPass(CommandBufferRecording &recording);
 
   CommandBufferRenderPass(CommandBufferRenderPass const &) = delete;
   CommandBufferRenderPass(CommandBufferRenderPass &&) = delete;
 
   ~CommandBufferRenderPass();
 
-  void bindPipeline(std::shared_ptr<GraphicsPipeline> pipeline);
+  // Binding a different pipeline forgets the viewport and scissor, unless
+  // the pipeline is known to declare them dynamic.
+  void bindPipeline(std::shared_ptr<GraphicsPipeline> const &pipeline);
+  void bindPipeline(VkPipeline pipeline);
 
+  // Sets are only skipped when no dynamic offsets are given, and are all
+  // forgotten when `layout` differs from the one last bound.
+  void bindDescriptorSets(VkPipelineLayout layout, uint32_t firstSet,
+                          std::span<VkDescriptorSet const> descriptorSets,
+                          std::span<uint32_t const> dynamicOffsets = {});
+  void bindDescriptorSets(VkPipelineLayout layout, uint32_t firstSet,
+                          std::initializer_list<VkDescriptorSet> descriptorSets,
+                          std::initializer_list<uint32_t> dynamicOffsets = {});
+
+  void bindVertexBuffers(
+      std::span<std::pair<std::shared_ptr<Buffer>, VkDeviceSize> const>
+          buffersAndOffsets);
   void bindVertexBuffers(
-      std::vector<std::pair<std::shared_ptr<Buffer>, VkDeviceSize>> const
-          &buffersAndOffsets);
+      std::initializer_list<std::pair<std::shared_ptr<Buffer>, VkDeviceSize>>
+          buffersAndOffsets);
+  void bindVertexBuffers(uint32_t firstBinding,
+                         std::span<VkBuffer const> buffers,
+                         std::span<VkDeviceSize const> offsets);
 
   void bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset,
                        VkIndexType indexType);
 
+  void pushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags,
+                     uint32_t offset, uint32_t size, void const *values);
+
+  template <typename T>
+  void pushConstants(VkPipelineLayout layout, VkShaderStageFlags stageFlags,
+                     uint32_t offset, T const &value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    static_assert(sizeof(T) % 4 == 0, "push constants are 4-byte words");
+    static_assert(sizeof(T) <= minPushConstantsSize,
+                  "exceeds the guaranteed push constant budget");
+    pushConstants(layout, stageFlags, offset, sizeof(T), &value);
+  }
+
   void setViewport(VkViewport const &viewport);
 
   void setScissor(VkRect2D const &scissor);
@@ -140,9 +366,65 @@ public:
                    uint32_t firstIndex, int32_t vertexOffset,
                    uint32_t firstInstance);
 
+  // More than one draw requires the multiDrawIndirect feature.
+  void drawIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount,
+                    uint32_t stride = sizeof(VkDrawIndirectCommand));
+  void
+  drawIndexedIndirect(VkBuffer buffer, VkDeviceSize offset, uint32_t drawCount,
+                      uint32_t stride = sizeof(VkDrawIndexedIndirectCommand));
+
+  // Requires the drawIndirectCount feature.
+  void drawIndexedIndirectCount(
+      VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer,
+      VkDeviceSize countOffset, uint32_t maxDrawCount,
+      uint32_t stride = sizeof(VkDrawIndexedIndirectCommand));
+
+  // Issued through VK_EXT_multi_draw when it is enabled, otherwise as one
+  // draw per entry, in which case gl_DrawID is always 0.
+  void drawMulti(std::span<VkMultiDrawInfoEXT const> draws,
+                 uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+  void drawMultiIndexed(std::span<VkMultiDrawIndexedInfoEXT const> draws,
+                        uint32_t instanceCount = 1,
+                        uint32_t firstInstance = 0);
+
   void nextSubpass(VkSubpassContents contents);
 
+  // The render pass must have been begun with SECONDARY_COMMAND_BUFFERS
+  // contents.
+  void executeCommands(
+      std::span<std::shared_ptr<CommandBuffer> const> commandBuffers);
+  void executeCommands(
+      std::initializer_list<std::shared_ptr<CommandBuffer>> commandBuffers);
+
+  ElidedStateCounts const &getElidedCounts() const;
+
 private:
-  std::shared_ptr<CommandBuffer> commandBuffer;
-  std::vector<std::shared_ptr<void>> boundRefs;
+  static constexpr uint32_t maxTrackedSets = 8;
+  static constexpr uint32_t maxTrackedBindings = 16;
+
+  // Null handles mean unknown, so the next bind is always recorded.
+  struct BoundState {
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    std::array<VkDescriptorSet, maxTrackedSets> descriptorSets = {};
+    std::array<VkBuffer, maxTrackedBindings> vertexBuffers = {};
+    std::array<VkDeviceSize, maxTrackedBindings> vertexOffsets = {};
+    VkBuffer indexBuffer = VK_NULL_HANDLE;
+    VkDeviceSize indexOffset = 0;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT16;
+    std::optional<VkViewport> viewport = {};
+    std::optional<VkRect2D> scissor = {};
+  };
+
+  CommandBuffer &commandBuffer;
+  // Only set when the render pass keeps its recording alive.
+  std::shared_ptr<CommandBufferRecording> ownedRecording = {};
+  bool continued = false;
+  bool dynamicRendering = false;
+
+  BoundState bound = {};
+  ElidedStateCounts elided = {};
+
+  void begin(RenderPassBeginInfo const &renderPassInfo);
+  void begin(RenderingInfo const &renderingInfo);
 };
\ No newline at end of file
@@ -14,6 +14,10 @@ public:
 
   operator VkCommandPool();
 
+  // Returns every command buffer allocated from the pool to the initial
+  // state; none of them may be pending execution.
+  void reset(VkCommandPoolResetFlags flags = {});
+
 private:
   std::shared_ptr<Device> device = {};
   Handle<VkCommandPool, Device> commandPool;
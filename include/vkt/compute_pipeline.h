@@ -0,0 +1,20 @@
+#pragma once
+#include <vkt/device.h>
+#include <vkt/pipeline.h>
+#include <vkt/pipeline_layout.h>
+#include <vkt/graphics_pipeline.h>
+
+struct ComputePipelineCreateInfo {
+  ShaderStageCreateInfo shaderStage;
+  std::shared_ptr<PipelineLayout> pipelineLayout;
+};
+
+class ComputePipeline : public Pipeline {
+public:
+  ComputePipeline() = default;
+  ComputePipeline(std::shared_ptr<Device> device,
+                  ComputePipelineCreateInfo const &createInfo);
+
+private:
+  std::shared_ptr<PipelineLayout> pipelineLayout = {};
+};
@@ -1,6 +1,11 @@
 #pragma once
 #include <vkt/instance.h>
+#include <vkt/device_dispatch.h>
 #include <variant>
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
 
 struct DeviceQueueCreateInfo {
   VkDeviceQueueCreateFlags flags = {};
@@ -8,12 +13,31 @@ struct DeviceQueueCreateInfo {
   std::vector<float> queuePriorities = {};
 };
 
+// Features outside VkPhysicalDeviceFeatures, chained into device creation.
+// Their extensions must be enabled as well.
+struct DeviceExtendedFeatures {
+  // VK_EXT_host_image_copy
+  bool hostImageCopy = false;
+  // VK_EXT_multi_draw
+  bool multiDraw = false;
+  // Vulkan 1.2
+  bool drawIndirectCount = false;
+  bool timelineSemaphore = false;
+  // Vulkan 1.3
+  bool dynamicRendering = false;
+  bool synchronization2 = false;
+};
+
 struct DeviceCreateInfo {
   VkDeviceCreateFlags flags = {};
   std::vector<DeviceQueueCreateInfo> queueCreateInfos = {};
   std::vector<std::string> enabledLayers = {};
   std::vector<std::string> enabledExtensions = {};
   VkPhysicalDeviceFeatures enabledFeatures = {};
+  DeviceExtendedFeatures enabledExtendedFeatures = {};
+  // Records everything the device does into this file for the replay tool;
+  // the VKT_CAPTURE environment variable does the same when this is empty.
+  std::string capturePath = {};
 };
 
 struct WriteDescriptorSet {
@@ -38,79 +62,110 @@ struct CopyDescriptorSet {
 
 using DescriptorOp = std::variant<WriteDescriptorSet, CopyDescriptorSet>;
 
-class Device {
+struct MemoryHeapBudget {
+  VkDeviceSize heapSize = 0;
+  // Reported by the driver for the whole process when VK_EXT_memory_budget is
+  // enabled; otherwise 80% of the heap and this device's own allocations.
+  VkDeviceSize budget = 0;
+  VkDeviceSize usage = 0;
+  // Bytes allocated through this device's DeviceMemory objects.
+  VkDeviceSize allocated = 0;
+
+  VkDeviceSize available() const;
+};
+
+class MemoryAllocator;
+class Capture;
+
+// The dispatch table is shared by every wrapper created from the device.
+class Device : public DeviceDispatch {
 public:
   Device() = default;
   Device(std::shared_ptr<Loader> loader, PhysicalDevice physicalDevice,
          DeviceCreateInfo const &deviceCreateInfo);
 
+  Device(Device const &) = delete;
+  Device &operator=(Device const &) = delete;
+
+  Device(Device &&) = delete;
+  Device &operator=(Device &&) = delete;
+
   operator VkDevice();
 
   void updateDescriptorSets(std::vector<DescriptorOp> operations);
 
-public:
-#define DEVICE_DEFS(MACRO)                                                     \
-  MACRO(vkGetDeviceQueue);                                                     \
-  MACRO(vkCreateSwapchainKHR);                                                 \
-  MACRO(vkDestroySwapchainKHR);                                                \
-  MACRO(vkGetSwapchainImagesKHR);                                              \
-  MACRO(vkCreateImageView);                                                    \
-  MACRO(vkDestroyImageView);                                                   \
-  MACRO(vkCreateShaderModule);                                                 \
-  MACRO(vkDestroyShaderModule);                                                \
-  MACRO(vkCreatePipelineLayout);                                               \
-  MACRO(vkDestroyPipelineLayout);                                              \
-  MACRO(vkCreateGraphicsPipelines);                                            \
-  MACRO(vkDestroyPipeline);                                                    \
-  MACRO(vkCreateRenderPass);                                                   \
-  MACRO(vkDestroyRenderPass);                                                  \
-  MACRO(vkCreateFramebuffer);                                                  \
-  MACRO(vkDestroyFramebuffer);                                                 \
-  MACRO(vkCreateCommandPool);                                                  \
-  MACRO(vkDestroyCommandPool);                                                 \
-  MACRO(vkAllocateCommandBuffers);                                             \
-  MACRO(vkFreeCommandBuffers);                                                 \
-  MACRO(vkCreateSemaphore);                                                    \
-  MACRO(vkDestroySemaphore);                                                   \
-  MACRO(vkCreateFence);                                                        \
-  MACRO(vkDestroyFence);                                                       \
-  MACRO(vkWaitForFences);                                                      \
-  MACRO(vkResetFences);                                                        \
-  MACRO(vkAcquireNextImageKHR);                                                \
-  MACRO(vkQueueSubmit);                                                        \
-  MACRO(vkQueuePresentKHR);                                                    \
-  MACRO(vkCreateBuffer);                                                       \
-  MACRO(vkDestroyBuffer);                                                      \
-  MACRO(vkDeviceWaitIdle);                                                     \
-  MACRO(vkAllocateMemory);                                                     \
-  MACRO(vkFreeMemory);                                                         \
-  MACRO(vkBindBufferMemory);                                                   \
-  MACRO(vkMapMemory);                                                          \
-  MACRO(vkUnmapMemory);                                                        \
-  MACRO(vkQueueWaitIdle);                                                      \
-  MACRO(vkCreateDescriptorSetLayout);                                          \
-  MACRO(vkDestroyDescriptorSetLayout);                                         \
-  MACRO(vkCreateDescriptorPool);                                               \
-  MACRO(vkDestroyDescriptorPool);                                              \
-  MACRO(vkAllocateDescriptorSets);                                             \
-  MACRO(vkUpdateDescriptorSets);                                               \
-  MACRO(vkCreateImage);                                                        \
-  MACRO(vkDestroyImage);                                                       \
-  MACRO(vkGetImageMemoryRequirements);                                         \
-  MACRO(vkBindImageMemory);                                                    \
-  MACRO(vkCreateSampler);                                                      \
-  MACRO(vkDestroySampler);                                                     \
-  MACRO(vkGetBufferMemoryRequirements)
-
-#define MEMBER(name) PFN_##name name
-  DEVICE_DEFS(MEMBER);
-#undef MEMBER
+  // Budgets and usage are cached and re-queried by refreshMemoryBudgets()
+  // or after enough allocations; allocations since then are added to the
+  // cached usage.
+  MemoryHeapBudget getMemoryBudget(uint32_t heapIndex);
+  std::vector<MemoryHeapBudget> getMemoryBudgets();
+  // Call once per frame.
+  void refreshMemoryBudgets();
+
+  // Called by DeviceMemory to keep the per-heap totals current.
+  void recordAllocation(uint32_t heapIndex, VkDeviceSize size);
+  void recordFree(uint32_t heapIndex, VkDeviceSize size);
+
+  // Invoked when an allocation would exceed the heap budget; should release
+  // resources and return the number of bytes freed.
+  typedef VkDeviceSize (*OnEvict)(uint32_t heapIndex,
+                                  VkDeviceSize requiredBytes);
+  Callback<OnEvict> onEvict;
+
+  VkPhysicalDeviceFeatures const &getEnabledFeatures() const;
+  DeviceExtendedFeatures const &getExtendedFeatures() const;
 
+  // Largest draw count of one vkCmdDrawMulti*EXT call; 0 without multiDraw.
+  uint32_t getMaxMultiDrawCount() const;
+
+  // Whether host image copies may write images in `layout`; false without
+  // hostImageCopy.
+  bool isHostCopyDstLayout(VkImageLayout layout) const;
+
+  // Required alignment of imported host pointers and sizes; 0 when
+  // VK_EXT_external_memory_host is not enabled.
+  VkDeviceSize getHostPointerAlignment() const;
+  // Memory types that can import `hostPointer`, 0 if none can.
+  uint32_t getHostPointerMemoryTypeBits(void const *hostPointer);
+
+  // nullptr unless the device is being captured.
+  Capture *getCapture() const;
+
+  // Guards a queue created with the device; Vulkan requires submits,
+  // presents and waits on a queue to be externally synchronized.
+  std::mutex &getQueueMutex(uint32_t queueFamilyIndex, uint32_t queueIndex);
+
+public:
   PhysicalDevice physDev;
 
 private:
   std::shared_ptr<Loader> loader = {};
   Handle<VkDevice, Loader> device;
 
-  void loadFunctions();
+  VkPhysicalDeviceFeatures enabledFeatures = {};
+  DeviceExtendedFeatures extendedFeatures = {};
+  uint32_t maxMultiDrawCount = 0;
+  std::vector<VkImageLayout> hostCopyDstLayouts;
+  bool memoryBudgetEnabled = false;
+  VkDeviceSize hostPointerAlignment = 0;
+  std::array<std::atomic<VkDeviceSize>, VK_MAX_MEMORY_HEAPS> heapAllocated = {};
+  // As of the last refreshMemoryBudgets().
+  std::mutex budgetMutex;
+  std::array<std::atomic<VkDeviceSize>, VK_MAX_MEMORY_HEAPS> heapBudget = {};
+  std::array<std::atomic<VkDeviceSize>, VK_MAX_MEMORY_HEAPS> heapUsage = {};
+  std::array<std::atomic<VkDeviceSize>, VK_MAX_MEMORY_HEAPS>
+      heapAllocatedAtRefresh = {};
+  std::atomic<uint32_t> allocationsSinceRefresh = 0;
+  // Only filled in by the constructor, so lookups need no lock.
+  std::map<std::pair<uint32_t, uint32_t>, std::mutex> queueMutexes;
+
+public:
+  // Declared after the handle so that its blocks are freed before the
+  // VkDevice is destroyed.
+  std::shared_ptr<MemoryAllocator> allocator = {};
+
+private:
+  // Declared last so that the dispatch table is restored before anything
+  // else is released.
+  std::shared_ptr<Capture> capture = {};
 };
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#define DEVICE_DEFS(MACRO)                                                     \
+  MACRO(vkGetDeviceQueue);                                                     \
+  MACRO(vkCreateSwapchainKHR);                                                 \
+  MACRO(vkDestroySwapchainKHR);                                                \
+  MACRO(vkGetSwapchainImagesKHR);                                              \
+  MACRO(vkCreateImageView);                                                    \
+  MACRO(vkDestroyImageView);                                                   \
+  MACRO(vkCreateShaderModule);                                                 \
+  MACRO(vkDestroyShaderModule);                                                \
+  MACRO(vkCreatePipelineLayout);                                               \
+  MACRO(vkDestroyPipelineLayout);                                              \
+  MACRO(vkCreateGraphicsPipelines);                                            \
+  MACRO(vkCreateComputePipelines);                                             \
+  MACRO(vkDestroyPipeline);                                                    \
+  MACRO(vkCreateRenderPass);                                                   \
+  MACRO(vkDestroyRenderPass);                                                  \
+  MACRO(vkCreateFramebuffer);                                                  \
+  MACRO(vkDestroyFramebuffer);                                                 \
+  MACRO(vkCreateCommandPool);                                                  \
+  MACRO(vkDestroyCommandPool);                                                 \
+  MACRO(vkResetCommandPool);                                                   \
+  MACRO(vkAllocateCommandBuffers);                                             \
+  MACRO(vkFreeCommandBuffers);                                                 \
+  MACRO(vkCreateSemaphore);                                                    \
+  MACRO(vkDestroySemaphore);                                                   \
+  MACRO(vkCreateFence);                                                        \
+  MACRO(vkDestroyFence);                                                       \
+  MACRO(vkWaitForFences);                                                      \
+  MACRO(vkGetFenceStatus);                                                     \
+  MACRO(vkResetFences);                                                        \
+  MACRO(vkGetSemaphoreCounterValue);                                           \
+  MACRO(vkWaitSemaphores);                                                     \
+  MACRO(vkSignalSemaphore);                                                    \
+  MACRO(vkAcquireNextImageKHR);                                                \
+  MACRO(vkQueueSubmit);                                                        \
+  MACRO(vkQueueSubmit2);                                                       \
+  MACRO(vkQueuePresentKHR);                                                    \
+  MACRO(vkCreateBuffer);                                                       \
+  MACRO(vkDestroyBuffer);                                                      \
+  MACRO(vkDeviceWaitIdle);                                                     \
+  MACRO(vkAllocateMemory);                                                     \
+  MACRO(vkFreeMemory);                                                         \
+  MACRO(vkBindBufferMemory);                                                   \
+  MACRO(vkMapMemory);                                                          \
+  MACRO(vkUnmapMemory);                                                        \
+  MACRO(vkFlushMappedMemoryRanges);                                            \
+  MACRO(vkInvalidateMappedMemoryRanges);                                       \
+  MACRO(vkGetMemoryHostPointerPropertiesEXT);                                  \
+  MACRO(vkQueueWaitIdle);                                                      \
+  MACRO(vkCreateDescriptorSetLayout);                                          \
+  MACRO(vkDestroyDescriptorSetLayout);                                         \
+  MACRO(vkCreateDescriptorPool);                                               \
+  MACRO(vkDestroyDescriptorPool);                                              \
+  MACRO(vkAllocateDescriptorSets);                                             \
+  MACRO(vkUpdateDescriptorSets);                                               \
+  MACRO(vkCreateImage);                                                        \
+  MACRO(vkDestroyImage);                                                       \
+  MACRO(vkGetImageMemoryRequirements);                                         \
+  MACRO(vkCopyMemoryToImageEXT);                                               \
+  MACRO(vkTransitionImageLayoutEXT);                                           \
+  MACRO(vkBindImageMemory);                                                    \
+  MACRO(vkCreateSampler);                                                      \
+  MACRO(vkDestroySampler);                                                     \
+  MACRO(vkGetBufferMemoryRequirements)
+
+#define CMD_BUF_DEFS(MACRO)                                                    \
+  MACRO(vkBeginCommandBuffer);                                                 \
+  MACRO(vkEndCommandBuffer);                                                   \
+  MACRO(vkCmdBeginRenderPass);                                                 \
+  MACRO(vkCmdEndRenderPass);                                                   \
+  MACRO(vkCmdBeginRendering);                                                  \
+  MACRO(vkCmdEndRendering);                                                    \
+  MACRO(vkCmdClearColorImage);                                                 \
+  MACRO(vkCmdBindPipeline);                                                    \
+  MACRO(vkCmdSetViewport);                                                     \
+  MACRO(vkCmdSetScissor);                                                      \
+  MACRO(vkCmdDraw);                                                            \
+  MACRO(vkResetCommandBuffer);                                                 \
+  MACRO(vkCmdPipelineBarrier);                                                 \
+  MACRO(vkCmdPipelineBarrier2);                                                \
+  MACRO(vkCmdBindVertexBuffers);                                               \
+  MACRO(vkCmdCopyBuffer);                                                      \
+  MACRO(vkCmdDrawIndexed);                                                     \
+  MACRO(vkCmdDrawIndirect);                                                    \
+  MACRO(vkCmdDrawIndexedIndirect);                                             \
+  MACRO(vkCmdDrawIndexedIndirectCount);                                        \
+  MACRO(vkCmdDrawMultiEXT);                                                    \
+  MACRO(vkCmdDrawMultiIndexedEXT);                                             \
+  MACRO(vkCmdBindIndexBuffer);                                                 \
+  MACRO(vkCmdBindDescriptorSets);                                              \
+  MACRO(vkCmdPushConstants);                                                   \
+  MACRO(vkCmdCopyBufferToImage);                                               \
+  MACRO(vkCmdCopyImageToBuffer);                                               \
+  MACRO(vkCmdBlitImage);                                                       \
+  MACRO(vkCmdDispatch);                                                        \
+  MACRO(vkCmdExecuteCommands);                                                 \
+  MACRO(vkCmdNextSubpass)
+
+// Device-level entry points, resolved once per VkDevice through
+// vkGetDeviceProcAddr so that calls go straight to the driver rather than
+// through the loader's trampolines. Commands of extensions that were not
+// enabled are left null.
+struct DeviceDispatch {
+#define MEMBER(name) PFN_##name name = {}
+  DEVICE_DEFS(MEMBER);
+  CMD_BUF_DEFS(MEMBER);
+#undef MEMBER
+
+  void load(VkDevice device, PFN_vkGetDeviceProcAddr getDeviceProcAddr);
+};
\ No newline at end of file
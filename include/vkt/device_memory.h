@@ -2,13 +2,18 @@
 #include <vkt/device.h>
 #include <memory>
 #include <limits>
+#include <mutex>
+#include <span>
 
 struct MemoryAllocateInfo {
   VkDeviceSize size;
   uint32_t memoryTypeIndex;
+  // Imports this host allocation (VK_EXT_external_memory_host) instead of
+  // allocating; it must outlive the DeviceMemory.
+  void *importHostPointer = nullptr;
 };
 
-class DeviceMemoryMap;
+class MappedRangeBatch;
 
 class DeviceMemory {
 public:
@@ -18,16 +23,55 @@ public:
 
   operator VkDeviceMemory();
 
-  std::shared_ptr<void>
-  map(VkDeviceSize offset = 0,
-      VkDeviceSize size = std::numeric_limits<VkDeviceSize>::max());
+  VkDeviceSize getSize() const;
+  uint32_t getMemoryTypeIndex() const;
+  VkMemoryPropertyFlags getPropertyFlags() const;
+  bool isHostCoherent() const;
+
+  // The whole allocation is mapped on first use and stays mapped until the
+  // memory is freed, so sub-ranges can be handed out without remapping.
+  void *map();
+
+  template <typename T>
+  std::span<T> view(VkDeviceSize offset, size_t count) {
+    return std::span<T>(reinterpret_cast<T *>((char *)map() + offset), count);
+  }
+
+  // No-ops for HOST_COHERENT memory; otherwise the range is widened to
+  // nonCoherentAtomSize boundaries.
+  void flush(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+  void invalidate(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
 
 private:
-  friend class DeviceMemoryMap;
+  friend class MappedRangeBatch;
 
   std::shared_ptr<Device> device = {};
   Handle<VkDeviceMemory, Device> deviceMemory = {};
   VkDeviceSize allocationSize = 0;
+  uint32_t memoryTypeIndex = 0;
+
+  std::mutex mapMutex;
+  void *mappedData = nullptr;
 
-  std::weak_ptr<void> memoryMap;
+  VkMappedMemoryRange alignedRange(VkDeviceSize offset, VkDeviceSize size);
+};
+
+// Collects non-coherent ranges, possibly from different allocations, so that
+// they are flushed or invalidated with a single call.
+class MappedRangeBatch {
+public:
+  MappedRangeBatch() = default;
+  MappedRangeBatch(std::shared_ptr<Device> device);
+
+  void add(DeviceMemory &memory, VkDeviceSize offset = 0,
+           VkDeviceSize size = VK_WHOLE_SIZE);
+
+  bool empty() const;
+
+  void flush();
+  void invalidate();
+
+private:
+  std::shared_ptr<Device> device = {};
+  std::vector<VkMappedMemoryRange> ranges;
 };
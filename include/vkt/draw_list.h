@@ -0,0 +1,75 @@
+#pragma once
+#include <vkt/buffer.h>
+#include <vkt/command_buffer.h>
+
+struct DrawListCreateInfo {
+  uint32_t maxDraws;
+  std::set<uint32_t> queueFamilyIndices;
+};
+
+struct DrawListEntry {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  int32_t vertexOffset = 0;
+  // Stored at the draw's index in the material buffer.
+  uint32_t material = 0;
+  uint32_t instanceCount = 1;
+  uint32_t firstInstance = 0;
+};
+
+// Where DrawList::draw() pushes, as a uint32_t, the index of the first draw
+// of each call it records. gl_DrawID restarts at 0 with every call, so
+// shaders find the draw's index at base + gl_DrawID.
+struct DrawIndexPushConstant {
+  VkPipelineLayout layout;
+  VkShaderStageFlags stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  uint32_t offset = 0;
+};
+
+// Packs indexed draws, such as the submeshes of a model, into a persistently
+// mapped VkDrawIndexedIndirectCommand buffer and a parallel uint32_t
+// material buffer, which shaders index by draw. The buffers are
+// written in place, so a list must not be rebuilt while the GPU may still
+// read it: build static geometry once, or keep one list per frame in flight.
+// The list must outlive the submissions that draw it.
+class DrawList {
+public:
+  DrawList(std::shared_ptr<Device> device,
+           DrawListCreateInfo const &createInfo);
+
+  DrawList(DrawList const &) = delete;
+  DrawList &operator=(DrawList const &) = delete;
+
+  void clear();
+
+  // Returns the draw's index into the material buffer.
+  uint32_t add(DrawListEntry const &entry);
+
+  uint32_t size() const;
+
+  // Issues the draws in indirect calls of up to maxDrawIndirectCount when the
+  // multiDrawIndirect feature is enabled, otherwise through VK_EXT_multi_draw
+  // in calls of up to maxMultiDrawCount when all draws share their
+  // instances. Failing both, draws are issued one at a time. gl_DrawID
+  // restarts with each call, so it only tells all draws apart with
+  // `drawIndex` given.
+  void draw(CommandBufferRenderPass &renderPass,
+            std::optional<DrawIndexPushConstant> const &drawIndex = {});
+
+  std::shared_ptr<Buffer> const &getCommandBuffer() const;
+  // Bind as a storage buffer of uint32_t.
+  std::shared_ptr<Buffer> const &getMaterialBuffer() const;
+
+private:
+  std::shared_ptr<Device> device = {};
+  DrawListCreateInfo createInfo;
+
+  std::shared_ptr<Buffer> commandBuffer = {}, materialBuffer = {};
+  std::span<VkDrawIndexedIndirectCommand> commands;
+  std::span<uint32_t> materials;
+
+  // Host copy of the draws for VK_EXT_multi_draw, which takes them inline.
+  std::vector<VkMultiDrawIndexedInfoEXT> multiDraws;
+  bool sharedInstances = true;
+  uint32_t count = 0;
+};
@@ -10,6 +10,7 @@ public:
 
   void wait();
   void reset();
+  bool isSignalled();
 
 private:
   std::shared_ptr<Device> device = {};
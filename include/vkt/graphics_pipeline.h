@@ -76,6 +76,16 @@ struct ColorBlendStateCreateInfo {
   std::array<float, 4> blendConstants;
 };
 
+// Attachment formats of a pipeline used with dynamic rendering.
+struct PipelineRenderingCreateInfo {
+  uint32_t viewMask = 0;
+  std::vector<VkFormat> colorAttachmentFormats;
+  VkFormat depthAttachmentFormat = VK_FORMAT_UNDEFINED;
+  VkFormat stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+  bool operator==(PipelineRenderingCreateInfo const &) const = default;
+};
+
 struct GraphicsPipelineCreateInfo {
   std::vector<ShaderStageCreateInfo> shaderStages;
   VertexInputStateCreateInfo vertexInputState;
@@ -87,8 +97,11 @@ struct GraphicsPipelineCreateInfo {
   ColorBlendStateCreateInfo colorBlendState;
   std::vector<VkDynamicState> dynamicStates;
   std::shared_ptr<PipelineLayout> pipelineLayout;
+  // Null when the pipeline is used with dynamic rendering.
   std::shared_ptr<RenderPass> renderPass;
   uint32_t subpass;
+  // Required when renderPass is null; needs the dynamicRendering feature.
+  std::optional<PipelineRenderingCreateInfo> renderingInfo = {};
 };
 
 class GraphicsPipeline : public Pipeline {
@@ -97,7 +110,10 @@ public:
   GraphicsPipeline(std::shared_ptr<Device> device,
                    GraphicsPipelineCreateInfo const &createInfo);
 
+  bool hasDynamicState(VkDynamicState dynamicState) const;
+
 private:
   std::shared_ptr<PipelineLayout> pipelineLayout = {};
   std::shared_ptr<RenderPass> renderPass = {};
+  std::vector<VkDynamicState> dynamicStates;
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <vkt/device.h>
 #include <vkt/device_memory.h>
+#include <vkt/memory_allocator.h>
 #include <set>
 #include <vkt/queue.h>
 
@@ -25,14 +26,38 @@ public:
 
   Image(std::shared_ptr<Device> device, ImageCreateInfo const &createInfo);
 
+  // Number of levels down to 1x1(x1).
+  static uint32_t mipChainLength(VkExtent3D extent);
+
   operator VkImage();
 
   VkMemoryRequirements getMemoryRequirements();
+  VkSharingMode getSharingMode() const;
 
-  DeviceMemory &allocMemory(VkMemoryPropertyFlags properties);
+  MemoryAllocation &allocMemory(VkMemoryPropertyFlags properties,
+                                VkMemoryPropertyFlags preferred = 0,
+                                VkMemoryPropertyFlags avoided = 0);
+  void bindMemory(std::shared_ptr<MemoryAllocation> allocation);
   void bindMemory(std::shared_ptr<DeviceMemory> deviceMemory,
                   VkDeviceSize offset = 0);
 
+  // Whether images like `createInfo`, with HOST_TRANSFER usage added, can be
+  // written by the host (VK_EXT_host_image_copy) into `dstLayout`.
+  static bool supportsHostCopy(Device &device,
+                               ImageCreateInfo const &createInfo,
+                               VkImageLayout dstLayout);
+  // Created with HOST_TRANSFER usage on a device with hostImageCopy, and
+  // `dstLayout` is one of its host copy destination layouts.
+  bool canHostCopy(VkImageLayout dstLayout) const;
+
+  // Writes level 0, layer 0 from tightly packed texels on the calling
+  // thread, without a staging buffer or a submission, and moves every level
+  // to `dstLayout`. Requires canHostCopy(dstLayout). The image must not be
+  // in use by the GPU or other threads.
+  void hostCopy(void const *data, VkImageLayout dstLayout);
+
+  // Blocking one-off upload; batch through UploadContext instead. Writes
+  // from the host directly when canHostCopy(dstLayout).
   void stage(void *data, VkDeviceSize size, Queue &transferQueue,
              VkPipelineStageFlags dstStageMask, VkAccessFlags dstAccessMask,
              VkImageLayout dstLayout);
@@ -41,7 +66,7 @@ public:
 
 private:
   std::shared_ptr<Device> device = {};
+  std::shared_ptr<MemoryAllocation> imageMemory;
   Handle<VkImage, Device> image;
-  std::shared_ptr<DeviceMemory> imageMemory;
-  VkImageFormatProperties formatProps;
+  VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 };
\ No newline at end of file
@@ -11,6 +11,7 @@ public:
   MEMBER(vkCreateInstance);
   MEMBER(vkDestroyInstance);
   MEMBER(vkGetPhysicalDeviceProperties);
+  MEMBER(vkGetPhysicalDeviceProperties2);
   MEMBER(vkGetPhysicalDeviceFeatures);
   MEMBER(vkGetPhysicalDeviceQueueFamilyProperties);
   MEMBER(vkCreateDevice);
@@ -19,7 +20,9 @@ public:
   MEMBER(vkGetPhysicalDeviceSurfaceFormatsKHR);
   MEMBER(vkGetPhysicalDeviceSurfacePresentModesKHR);
   MEMBER(vkGetPhysicalDeviceMemoryProperties);
+  MEMBER(vkGetPhysicalDeviceMemoryProperties2);
   MEMBER(vkGetPhysicalDeviceSurfaceSupportKHR);
   MEMBER(vkGetPhysicalDeviceFormatProperties);
+  MEMBER(vkGetPhysicalDeviceImageFormatProperties);
 #undef MEMBER
 };
\ No newline at end of file
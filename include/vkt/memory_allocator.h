@@ -0,0 +1,122 @@
+#pragma once
+#include <vkt/device_memory.h>
+#include <map>
+#include <mutex>
+#include <array>
+#include <optional>
+
+struct MemoryAllocatorCreateInfo {
+  VkDeviceSize largeHeapBlockSize = (VkDeviceSize)256 << 20;
+  VkDeviceSize smallHeapMaxSize = (VkDeviceSize)1 << 30;
+};
+
+struct MemoryAllocationCreateInfo {
+  VkMemoryRequirements requirements;
+  VkMemoryPropertyFlags properties;
+  VkMemoryPropertyFlags preferredProperties = 0;
+  VkMemoryPropertyFlags avoidedProperties = 0;
+  // Tried when every type matching `properties` is over its heap budget,
+  // e.g. host-visible memory for a buffer that prefers device-local.
+  std::optional<VkMemoryPropertyFlags> fallbackProperties = {};
+  // Buffers and linear images; kept apart from optimal images so that
+  // neighbouring sub-ranges never violate bufferImageGranularity.
+  bool linear = true;
+  bool dedicated = false;
+};
+
+struct MemoryStats {
+  uint32_t blockCount = 0;
+  uint32_t allocationCount = 0;
+  uint32_t dedicatedAllocationCount = 0;
+  uint32_t freeRangeCount = 0;
+  VkDeviceSize reservedBytes = 0;
+  VkDeviceSize usedBytes = 0;
+  VkDeviceSize largestFreeRange = 0;
+
+  VkDeviceSize freeBytes() const;
+  // 0 when all free space is contiguous, approaching 1 as it gets scattered.
+  float fragmentation() const;
+
+  MemoryStats &operator+=(MemoryStats const &other);
+};
+
+class MemoryAllocator;
+class MemoryBlock;
+struct MemoryRange;
+
+class MemoryAllocation {
+public:
+  MemoryAllocation(std::shared_ptr<DeviceMemory> memory, VkDeviceSize offset,
+                   VkDeviceSize size);
+
+  MemoryAllocation(MemoryAllocation const &) = delete;
+  MemoryAllocation &operator=(MemoryAllocation const &) = delete;
+
+  ~MemoryAllocation();
+
+  operator VkDeviceMemory();
+
+  std::shared_ptr<DeviceMemory> getMemory() const;
+  VkDeviceSize getOffset() const;
+  VkDeviceSize getSize() const;
+
+  // Pointers and views are relative to the start of this allocation.
+  void *map();
+
+  template <typename T> std::span<T> view() {
+    return memory->view<T>(offset, (size_t)(size / sizeof(T)));
+  }
+
+  template <typename T> std::span<T> view(VkDeviceSize offset, size_t count) {
+    return memory->view<T>(this->offset + offset, count);
+  }
+
+  void flush(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+  void invalidate(VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+  void addTo(MappedRangeBatch &batch, VkDeviceSize offset = 0,
+             VkDeviceSize size = VK_WHOLE_SIZE);
+
+private:
+  friend class MemoryAllocator;
+
+  std::shared_ptr<DeviceMemory> memory = {};
+  VkDeviceSize offset = 0, size = 0;
+
+  MemoryAllocator *allocator = nullptr;
+  MemoryBlock *block = nullptr;
+  MemoryRange *range = nullptr;
+};
+
+class MemoryAllocator {
+public:
+  MemoryAllocator(Device &device,
+                  MemoryAllocatorCreateInfo const &createInfo = {});
+
+  MemoryAllocator(MemoryAllocator const &) = delete;
+  MemoryAllocator &operator=(MemoryAllocator const &) = delete;
+
+  ~MemoryAllocator();
+
+  std::shared_ptr<MemoryAllocation>
+  allocate(MemoryAllocationCreateInfo const &allocInfo);
+
+  MemoryStats getStats();
+  MemoryStats getStats(uint32_t memoryTypeIndex);
+
+private:
+  friend class MemoryAllocation;
+
+  Device &device;
+  MemoryAllocatorCreateInfo createInfo;
+
+  std::mutex mutex;
+  std::map<uint32_t, std::vector<std::unique_ptr<MemoryBlock>>> pools;
+  std::array<MemoryStats, VK_MAX_MEMORY_TYPES> dedicatedStats = {};
+
+  std::shared_ptr<MemoryAllocation>
+  tryAllocate(uint32_t memoryTypeIndex,
+              MemoryAllocationCreateInfo const &allocInfo, bool withinBudget);
+
+  VkDeviceSize preferredBlockSize(uint32_t memoryTypeIndex) const;
+  void free(MemoryAllocation &allocation);
+};
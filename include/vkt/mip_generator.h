@@ -0,0 +1,61 @@
+#pragma once
+#include <vkt/device.h>
+#include <vkt/image.h>
+#include <vkt/image_view.h>
+#include <vkt/sampler.h>
+#include <vkt/shader_module.h>
+#include <vkt/descriptor_set_layout.h>
+#include <vkt/pipeline_layout.h>
+#include <vkt/compute_pipeline.h>
+#include <vkt/command_buffer.h>
+
+struct MipGeneratorCreateInfo {
+  // Compiled shaders/downsample.comp. Only needed for formats that cannot be
+  // blitted with linear filtering, and only used with the
+  // shaderStorageImageWriteWithoutFormat feature enabled.
+  std::shared_ptr<ShaderModule> downsampleShader = {};
+};
+
+struct MipGenerateInfo {
+  VkPipelineStageFlags dstStageMask;
+  VkAccessFlags dstAccessMask;
+  VkImageLayout dstLayout;
+};
+
+enum class MipMethod { Blit, Compute };
+
+class MipGenerator {
+public:
+  MipGenerator(std::shared_ptr<Device> device,
+               MipGeneratorCreateInfo const &createInfo = {});
+
+  // std::nullopt if neither path supports the image's format and usage.
+  std::optional<MipMethod> method(Image const &image);
+
+  // Queue capability the recording command buffer needs for `image`.
+  VkQueueFlags requiredQueueFlags(Image const &image);
+
+  // Level 0 must be in TRANSFER_DST_OPTIMAL, last written by a transfer; the
+  // contents of the other levels are discarded. Every level ends in
+  // dstLayout. Objects the commands use are appended to `keepAlive`, which
+  // must outlive their execution.
+  void generate(CommandBufferRecording &recording, Image &image,
+                MipGenerateInfo const &generateInfo,
+                std::vector<std::shared_ptr<void>> &keepAlive);
+
+private:
+  std::shared_ptr<Device> device = {};
+  std::shared_ptr<ShaderModule> downsampleShader = {};
+
+  std::shared_ptr<DescriptorSetLayout> setLayout = {};
+  std::shared_ptr<PipelineLayout> pipelineLayout = {};
+  std::shared_ptr<ComputePipeline> pipeline = {};
+  std::shared_ptr<Sampler> sampler = {};
+
+  void generateBlit(CommandBufferRecording &recording, Image &image,
+                    MipGenerateInfo const &generateInfo);
+  void generateCompute(CommandBufferRecording &recording, Image &image,
+                       MipGenerateInfo const &generateInfo,
+                       std::vector<std::shared_ptr<void>> &keepAlive);
+  void createComputePipeline();
+};
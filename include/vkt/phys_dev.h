@@ -3,6 +3,20 @@
 #include <vector>
 #include <optional>
 #include <memory>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <shared_mutex>
+
+struct ImageFormatQuery {
+  VkFormat format;
+  VkImageType type;
+  VkImageTiling tiling;
+  VkImageUsageFlags usage;
+  VkImageCreateFlags flags;
+
+  auto operator<=>(ImageFormatQuery const &) const = default;
+};
 
 class PhysicalDevice {
 public:
@@ -17,16 +31,47 @@ public:
   std::vector<VkQueueFamilyProperties> queueFamilies;
   VkPhysicalDeviceMemoryProperties memoryProps;
 
+  // Picks the allowed type that has all required flags and scores best on
+  // the preferred and avoided ones; ties go to the lower (driver-preferred)
+  // index.
   std::optional<uint32_t>
   findMemoryTypeIndex(uint32_t memoryTypeBits,
-                      VkMemoryPropertyFlags requiredProperties);
+                      VkMemoryPropertyFlags requiredProperties,
+                      VkMemoryPropertyFlags preferredProperties = 0,
+                      VkMemoryPropertyFlags avoidedProperties = 0) const;
 
   std::optional<VkFormat>
   findSuitableFormat(std::vector<VkFormat> const &candidates,
                      VkFormatFeatureFlags requiredFeatures,
                      bool optimal = true);
 
+  // Prefers formats without a stencil aspect unless one is asked for.
+  std::optional<VkFormat> findDepthFormat(bool stencil = false);
+
+  VkFormatProperties getFormatProperties(VkFormat format);
+
+  // std::nullopt if the combination is unsupported. Each distinct query
+  // calls the driver once; later ones only take a shared lock.
+  std::optional<VkImageFormatProperties>
+  getImageFormatProperties(ImageFormatQuery const &query) const;
+
 private:
   std::shared_ptr<Loader> loader = {};
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-};
\ No newline at end of file
+
+  // Shared between copies so that every Device sees one set of results.
+  struct CapabilityCache {
+    std::vector<VkFormatProperties> coreFormats;
+
+    std::mutex mutex;
+    std::map<VkFormat, VkFormatProperties> extensionFormats;
+
+    std::shared_mutex imageFormatsMutex;
+    std::map<ImageFormatQuery, std::optional<VkImageFormatProperties>>
+        imageFormats;
+  };
+  std::shared_ptr<CapabilityCache> caps = {};
+
+  std::optional<VkImageFormatProperties>
+  queryImageFormatProperties(ImageFormatQuery const &query) const;
+};
@@ -1,19 +1,34 @@
 #pragma once
 #include <vkt/device.h>
+#include <span>
 
 struct QueueSubmitInfo {
   std::vector<std::pair<VkSemaphore, VkPipelineStageFlags>>
       waitSemaphoresAndStages;
   std::vector<VkCommandBuffer> commandBuffers;
   std::vector<VkSemaphore> signalSemaphores;
+  // One value per wait and signal semaphore when any of them is a timeline
+  // semaphore; the values of binary semaphores are ignored.
+  std::vector<uint64_t> waitValues = {};
+  std::vector<uint64_t> signalValues = {};
   VkFence fence;
 };
 
+// One batch of a multi-batch submit. The arrays are only read during the
+// call and passed through as they are, so their sType must be set.
+struct QueueSubmitBatch {
+  std::span<VkSemaphoreSubmitInfo const> waitSemaphores = {};
+  std::span<VkCommandBufferSubmitInfo const> commandBuffers = {};
+  std::span<VkSemaphoreSubmitInfo const> signalSemaphores = {};
+};
+
 struct QueuePresentInfo {
   std::vector<VkSemaphore> waitSemaphores;
   std::vector<std::pair<VkSwapchainKHR, uint32_t>> swapchainsAndImageIndices;
 };
 
+// Submits, presents and waits hold the device's lock for the VkQueue, so
+// threads can share a queue, also through separate Queue objects.
 class Queue {
 public:
   Queue() = default;
@@ -30,6 +45,13 @@ public:
 
   void submit(QueueSubmitInfo const &submitInfo);
 
+  // All batches go to one vkQueueSubmit2, or vkQueueSubmit without the
+  // synchronization2 feature; the fence signals after the last. Nothing is
+  // allocated unless the batches need more than a few dozen semaphores and
+  // command buffers in total.
+  void submit(std::span<QueueSubmitBatch const> batches,
+              VkFence fence = VK_NULL_HANDLE);
+
   VkResult present(QueuePresentInfo const &presentInfo);
 
   void wait();
@@ -41,4 +63,7 @@ private:
   std::shared_ptr<Device> device = {};
   VkQueue queue = VK_NULL_HANDLE;
   uint32_t queueFamilyIndex = 0, queueIndex = 0;
+  std::mutex *mutex = nullptr;
+
+  void submitLegacy(std::span<QueueSubmitBatch const> batches, VkFence fence);
 };
\ No newline at end of file
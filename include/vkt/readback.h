@@ -0,0 +1,125 @@
+#pragma once
+#include <vkt/device.h>
+#include <vkt/buffer.h>
+#include <vkt/image.h>
+#include <vkt/queue.h>
+#include <vkt/fence.h>
+#include <vkt/command_pool.h>
+#include <vkt/command_buffer.h>
+#include <deque>
+#include <optional>
+#include <span>
+
+struct ReadbackRingCreateInfo {
+  uint32_t slotCount = 3;
+  // Slots grow to the largest readback they receive.
+  VkDeviceSize initialSlotSize = 0;
+  // When every slot is in flight, drop new readbacks instead of waiting for
+  // the oldest one.
+  bool dropWhenFull = true;
+};
+
+struct ReadbackImageInfo {
+  // Layout the image is in; it is returned to it after the copy.
+  VkImageLayout layout;
+  VkPipelineStageFlags srcStageMask;
+  VkAccessFlags srcAccessMask;
+  VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  VkAccessFlags dstAccessMask =
+      VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+  VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  uint32_t mipLevel = 0;
+  uint32_t arrayLayer = 0;
+};
+
+struct ReadbackBufferInfo {
+  VkDeviceSize offset = 0;
+  VkDeviceSize size;
+  VkPipelineStageFlags srcStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  VkAccessFlags srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+};
+
+// Tightly packed texels of one image subresource, or a buffer range with
+// an undefined format. `data` is only valid during the callback.
+struct ReadbackView {
+  uint64_t id;
+  VkFormat format;
+  VkExtent3D extent;
+  std::span<std::byte const> data;
+};
+
+struct ReadbackFrame {
+  uint64_t id;
+  VkFormat format;
+  VkExtent3D extent;
+  std::vector<std::byte> data;
+};
+
+typedef void (*OnReadback)(ReadbackView const &view);
+
+// Copies images and buffers into a ring of host-cached buffers, each with
+// its own command buffer and fence, so that the caller never waits on the
+// GPU. Copies are submitted to `queue` and ordered after work previously
+// submitted there by their barriers.
+class ReadbackRing {
+public:
+  ReadbackRing(std::shared_ptr<Device> device, Queue const &queue,
+               ReadbackRingCreateInfo const &createInfo = {});
+
+  ReadbackRing(ReadbackRing const &) = delete;
+  ReadbackRing &operator=(ReadbackRing const &) = delete;
+
+  ~ReadbackRing();
+
+  // Returns nothing when the ring is full and dropWhenFull is set. Making
+  // room otherwise delivers the oldest readback first.
+  std::optional<uint64_t>
+  readImage(Image &image, ReadbackImageInfo const &readInfo,
+            std::vector<std::pair<VkSemaphore, VkPipelineStageFlags>> const
+                &waitSemaphoresAndStages = {});
+
+  std::optional<uint64_t> readBuffer(Buffer &buffer,
+                                     ReadbackBufferInfo const &readInfo);
+
+  // Delivers completed readbacks in submission order: to onReadback if it
+  // is set, otherwise to the queue drained by pop(). Returns their number.
+  uint32_t poll();
+
+  std::optional<ReadbackFrame> pop();
+
+  void waitIdle();
+
+  uint64_t getDroppedCount() const;
+
+  Callback<OnReadback> onReadback;
+
+private:
+  struct Slot {
+    std::shared_ptr<Buffer> buffer = {};
+    MemoryAllocation *memory = nullptr;
+    VkDeviceSize capacity = 0;
+    std::shared_ptr<CommandBuffer> commandBuffer = {};
+    std::shared_ptr<Fence> fence = {};
+    uint64_t id = 0;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent3D extent = {};
+    VkDeviceSize size = 0;
+  };
+
+  std::shared_ptr<Device> device = {};
+  Queue queue;
+  ReadbackRingCreateInfo createInfo;
+
+  std::shared_ptr<CommandPool> commandPool = {};
+  std::vector<Slot> slots;
+  // Ids only ever grow; slot i holds readbacks with id % slotCount == i.
+  uint64_t nextId = 0, oldestInFlight = 0;
+  uint64_t droppedCount = 0;
+  std::deque<ReadbackFrame> completed;
+
+  Slot *acquireSlot(VkDeviceSize size);
+  void submit(Slot &slot,
+              std::vector<std::pair<VkSemaphore, VkPipelineStageFlags>> const
+                  &waitSemaphoresAndStages);
+  void deliverOldest();
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include <vkt/device.h>
+#include <set>
 
 struct SubpassDescription {
   VkSubpassDescriptionFlags flags;
@@ -13,6 +14,9 @@ struct RenderPassCreateInfo {
   std::vector<VkAttachmentDescription> attachments;
   std::vector<SubpassDescription> subpasses;
   std::vector<VkSubpassDependency> dependencies;
+  // Attachments whose contents do not outlive the pass (depth, intermediate
+  // targets); their stores become DONT_CARE.
+  std::set<uint32_t> transientAttachments = {};
 };
 
 class RenderPass {
@@ -0,0 +1,58 @@
+#pragma once
+#include <vkt/buffer.h>
+#include <vkt/fence.h>
+#include <cstring>
+
+struct RingBufferCreateInfo {
+  VkDeviceSize frameSize;
+  uint32_t framesInFlight;
+  VkBufferUsageFlags usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  std::set<uint32_t> queueFamilyIndices;
+};
+
+struct RingAllocation {
+  VkBuffer buffer;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  void *data;
+
+  // Value for the pDynamicOffsets entry of a *_DYNAMIC descriptor which
+  // points at the start of the ring buffer.
+  uint32_t dynamicOffset() const;
+};
+
+// Persistently mapped buffer split into one region per frame in flight.
+// Allocations within the current frame are a pointer bump; the region is
+// recycled once the fence of the frame which last used it has signalled.
+class RingBuffer {
+public:
+  RingBuffer() = default;
+  RingBuffer(std::shared_ptr<Device> device,
+             RingBufferCreateInfo const &createInfo);
+
+  operator VkBuffer();
+
+  // `frameIndex` must be less than framesInFlight.
+  void beginFrame(uint32_t frameIndex, Fence &frameFence);
+
+  RingAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+
+  template <typename T>
+  RingAllocation push(T const &value) {
+    auto allocation = allocate(sizeof(T));
+    std::memcpy(allocation.data, &value, sizeof(T));
+    return allocation;
+  }
+
+  VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) const;
+
+private:
+  std::shared_ptr<Device> device = {};
+  std::shared_ptr<Buffer> buffer = {};
+  void *memoryMap = nullptr;
+
+  VkDeviceSize frameSize = 0, alignment = 1;
+  uint32_t framesInFlight = 0;
+  VkDeviceSize frameBegin = 0, head = 0;
+};
@@ -6,6 +6,9 @@ public:
   Sampler() = default;
   Sampler(std::shared_ptr<Device> device, VkSamplerCreateInfo createInfo);
 
+  // Trilinear, repeating, with maxLod covering `mipLevels`.
+  static VkSamplerCreateInfo defaultCreateInfo(uint32_t mipLevels = 1);
+
   operator VkSampler();
 
 private:
@@ -8,6 +8,27 @@ public:
 
   operator VkSemaphore();
 
+private:
+  std::shared_ptr<Device> device = {};
+  Handle<VkSemaphore, Device> semaphore;
+};
+
+// A semaphore whose payload only grows; the device and the host wait for
+// and signal particular values. Needs the timelineSemaphore feature.
+class TimelineSemaphore {
+public:
+  TimelineSemaphore() = default;
+  TimelineSemaphore(std::shared_ptr<Device> device, uint64_t initialValue = 0);
+
+  operator VkSemaphore();
+
+  uint64_t getValue();
+
+  void signal(uint64_t value);
+
+  // Returns false if `timeout` nanoseconds pass first.
+  bool wait(uint64_t value, uint64_t timeout = UINT64_MAX);
+
 private:
   std::shared_ptr<Device> device = {};
   Handle<VkSemaphore, Device> semaphore;
@@ -0,0 +1,65 @@
+#pragma once
+#include <vkt/command_pool.h>
+#include <vkt/command_buffer.h>
+
+struct StaticCommandCacheCreateInfo {
+  uint32_t queueFamilyIndex;
+  // Secondaries are executed inside a render pass begun every frame.
+  VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+  // A cached buffer is usually still pending when it is submitted or
+  // executed again.
+  VkCommandBufferUsageFlags usage =
+      VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+};
+
+typedef void (*RecordStaticCommands)(CommandBufferRecording &recording,
+                                     uint32_t slot);
+
+// Records content that does not change between frames, such as the draws of
+// a static scene, once per slot (e.g. per swapchain image) and hands back
+// the same command buffer every frame until it is invalidated.
+//
+// Cached buffers are never re-recorded in place: invalidation allocates new
+// ones, while the old ones stay alive for as long as the caller, or a
+// primary that executed them, holds a reference. Hold on to a returned
+// primary until its submission has completed.
+class StaticCommandCache {
+public:
+  StaticCommandCache(std::shared_ptr<Device> device,
+                     StaticCommandCacheCreateInfo const &createInfo);
+
+  StaticCommandCache(StaticCommandCache const &) = delete;
+  StaticCommandCache &operator=(StaticCommandCache const &) = delete;
+
+  // Records the slot first if it is invalid or, for secondaries, if it was
+  // recorded against a different render pass, framebuffer or set of
+  // attachment formats, as after swapchain recreation.
+  std::shared_ptr<CommandBuffer> const &
+  get(uint32_t slot,
+      std::optional<CommandBufferInheritanceInfo> const &inheritanceInfo = {});
+
+  // Call after scene edits; every slot is recorded again on next use.
+  void invalidate();
+  void invalidate(uint32_t slot);
+
+  // Number of times a slot has been recorded.
+  uint64_t getRecordCount() const;
+
+  Callback<RecordStaticCommands> onRecord;
+
+private:
+  struct Slot {
+    std::shared_ptr<CommandBuffer> commandBuffer = {};
+    std::optional<CommandBufferInheritanceInfo> inheritanceInfo = {};
+    bool valid = false;
+  };
+
+  std::shared_ptr<Device> device = {};
+  StaticCommandCacheCreateInfo createInfo;
+  std::shared_ptr<CommandPool> commandPool = {};
+
+  std::vector<Slot> slots;
+  uint64_t recordCount = 0;
+
+  void record(uint32_t slot);
+};
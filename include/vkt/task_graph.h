@@ -0,0 +1,108 @@
+#pragma once
+#include <vkt/queue.h>
+#include <vkt/semaphore.h>
+
+struct TaskGraphCreateInfo {
+  // Tasks name their queue by index into this list, e.g. {graphics, compute,
+  // transfer}. Entries may be the same VkQueue, as on devices that expose
+  // only one.
+  std::vector<Queue> queues;
+};
+
+// Handle to a submitted or pending task; completes when its queue's timeline
+// reaches `value`.
+struct GpuTask {
+  uint32_t queue = 0;
+  uint64_t value = 0;
+};
+
+struct GpuTaskDependency {
+  GpuTask task;
+  // Stages of the dependent task that wait for `task` to complete.
+  VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+};
+
+struct GpuTaskInfo {
+  uint32_t queue = 0;
+  // Must stay valid until the task completes.
+  std::vector<VkCommandBuffer> commandBuffers = {};
+  std::vector<GpuTaskDependency> dependencies = {};
+  // Binary semaphores, such as those of swapchain acquire and present.
+  std::vector<std::pair<VkSemaphore, VkPipelineStageFlags>> waitSemaphores =
+      {};
+  std::vector<VkSemaphore> signalSemaphores = {};
+};
+
+struct TaskGraphStats {
+  uint64_t tasks = 0;
+  uint64_t submits = 0;
+  // Semaphore waits issued, and dependencies that needed none because they
+  // had completed, were implied by another wait or shared a queue with one.
+  uint64_t waits = 0;
+  uint64_t elidedWaits = 0;
+};
+
+// Submits GPU work spread over several queues in dependency order. Every
+// queue has a timeline semaphore that each of its tasks signals, so a task
+// waits for at most one value per queue and not at all for work that has
+// finished or that another of its waits already implies. Queues thereby
+// overlap wherever dependencies allow instead of idling between steps.
+//
+// Resources shared between queue families need CONCURRENT sharing or
+// ownership transfer barriers in the tasks' command buffers. Needs the
+// timelineSemaphore feature; not thread-safe.
+class TaskGraph {
+public:
+  TaskGraph(std::shared_ptr<Device> device,
+            TaskGraphCreateInfo const &createInfo);
+
+  TaskGraph(TaskGraph const &) = delete;
+  TaskGraph &operator=(TaskGraph const &) = delete;
+
+  // Dependencies must have been added before, so the graph stays acyclic.
+  GpuTask add(GpuTaskInfo const &taskInfo);
+
+  // Submits the tasks added since the last call, batching consecutive tasks
+  // of a queue into one Queue::submit. No wait is submitted before the
+  // signal it waits for.
+  void submit();
+
+  bool isComplete(GpuTask task);
+  // Submits first if the task is still pending.
+  void wait(GpuTask task);
+  void waitIdle();
+
+  TaskGraphStats const &getStats() const;
+
+private:
+  // Highest value of every queue's timeline known to be reached once a task
+  // completes.
+  using Clock = std::vector<uint64_t>;
+
+  struct Wait {
+    uint32_t queue;
+    uint64_t value;
+    VkPipelineStageFlags dstStageMask;
+  };
+
+  struct PendingTask {
+    GpuTask task;
+    GpuTaskInfo info;
+    std::vector<Wait> waits;
+    Clock clock;
+  };
+
+  struct QueueTimeline {
+    Queue queue;
+    TimelineSemaphore timeline;
+    uint64_t lastValue = 0;
+    Clock clock;
+  };
+
+  std::shared_ptr<Device> device = {};
+  std::vector<QueueTimeline> queues;
+  std::vector<PendingTask> pending;
+  TaskGraphStats stats;
+
+  Clock const *findClock(GpuTask task) const;
+};
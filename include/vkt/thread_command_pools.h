@@ -0,0 +1,52 @@
+#pragma once
+#include <vkt/command_pool.h>
+#include <vkt/command_buffer.h>
+
+struct ThreadCommandPoolsCreateInfo {
+  uint32_t queueFamilyIndex;
+  uint32_t threadCount;
+  uint32_t framesInFlight = 2;
+};
+
+// One transient command pool per (frame in flight, recording thread), so
+// that workers allocate and record without locking and a frame's buffers
+// are recycled with one pool reset. A thread index must only be used by
+// one thread at a time.
+//
+// Workers record secondaries with RENDER_PASS_CONTINUE and inheritance
+// info, draw inside CommandBufferRenderPass(recording), and the primary
+// executes them from a render pass begun with
+// VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+class ThreadCommandPools {
+public:
+  ThreadCommandPools(std::shared_ptr<Device> device,
+                     ThreadCommandPoolsCreateInfo const &createInfo);
+
+  ThreadCommandPools(ThreadCommandPools const &) = delete;
+  ThreadCommandPools &operator=(ThreadCommandPools const &) = delete;
+
+  // Resets the frame's pools; its previous submissions must have completed.
+  void beginFrame(uint32_t frameIndex);
+
+  // Command buffers are reused across frames and are valid until the next
+  // beginFrame() of the same frame index.
+  std::shared_ptr<CommandBuffer>
+  allocate(uint32_t threadIndex,
+           VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+  uint32_t getThreadCount() const;
+
+private:
+  struct ThreadPool {
+    std::shared_ptr<CommandPool> commandPool = {};
+    std::vector<std::shared_ptr<CommandBuffer>> primaries, secondaries;
+    size_t primariesUsed = 0, secondariesUsed = 0;
+  };
+
+  std::shared_ptr<Device> device = {};
+  ThreadCommandPoolsCreateInfo createInfo;
+
+  // Indexed by frameIndex * threadCount + threadIndex.
+  std::vector<ThreadPool> pools;
+  uint32_t frameIndex = 0;
+};
@@ -0,0 +1,179 @@
+#pragma once
+#include <vkt/device.h>
+#include <vkt/buffer.h>
+#include <vkt/image.h>
+#include <vkt/queue.h>
+#include <vkt/fence.h>
+#include <vkt/semaphore.h>
+#include <vkt/command_pool.h>
+#include <vkt/command_buffer.h>
+#include <vkt/mip_generator.h>
+#include <mutex>
+
+struct UploadContextCreateInfo {
+  VkDeviceSize stagingSize = (VkDeviceSize)64 << 20;
+  // Larger uploads are split so that the ring keeps several in flight.
+  VkDeviceSize chunkSize = (VkDeviceSize)16 << 20;
+  uint32_t maxBatchesInFlight = 4;
+  // Family that consumes the uploads. EXCLUSIVE resources are released to
+  // it after their copies and must be acquired with acquireOwnership().
+  uint32_t dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  std::shared_ptr<MipGenerator> mipGenerator = {};
+};
+
+struct BufferUploadInfo {
+  VkDeviceSize dstOffset = 0;
+  VkPipelineStageFlags dstStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  VkAccessFlags dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+};
+
+struct ImageUploadInfo {
+  VkPipelineStageFlags dstStageMask;
+  VkAccessFlags dstAccessMask;
+  VkImageLayout dstLayout;
+  // Fills the remaining levels from level 0. If the upload queue can
+  // neither blit nor dispatch, this happens in acquireOwnership().
+  bool generateMips = false;
+};
+
+// Identifies the batch an upload was recorded into; complete once that
+// batch's copies have executed.
+struct UploadToken {
+  uint64_t batch = 0;
+};
+
+struct OwnershipAcquire {
+  // Every upload up to and including this one has been acquired.
+  UploadToken token;
+  std::vector<std::pair<VkSemaphore, VkPipelineStageFlags>>
+      waitSemaphoresAndStages;
+  // Must outlive the submission that waits on the semaphores.
+  std::vector<std::shared_ptr<void>> keepAlive;
+};
+
+// Records copies from a persistently mapped staging ring into one command
+// buffer per batch, submitted to the transfer queue on flush() or when the
+// ring needs the space back.
+class UploadContext {
+public:
+  UploadContext(std::shared_ptr<Device> device, Queue const &transferQueue,
+                UploadContextCreateInfo const &createInfo = {});
+
+  UploadContext(UploadContext const &) = delete;
+  UploadContext &operator=(UploadContext const &) = delete;
+
+  ~UploadContext();
+
+  // Destinations that are released to dstQueueFamilyIndex are kept alive
+  // through OwnershipAcquire::keepAlive, so they must be passed by
+  // shared_ptr; the reference overloads throw for them.
+  UploadToken upload(std::shared_ptr<Buffer> const &dst, void const *data,
+                     VkDeviceSize size,
+                     BufferUploadInfo const &uploadInfo = {});
+  UploadToken upload(Buffer &dst, void const *data, VkDeviceSize size,
+                     BufferUploadInfo const &uploadInfo = {});
+
+  // Copies directly from `data` when it can be imported as device memory
+  // (see Buffer::importHostMemory); it must then stay valid and unmodified
+  // until the token completes. Falls back to upload() otherwise.
+  UploadToken uploadFromHost(std::shared_ptr<Buffer> const &dst,
+                             void const *data, VkDeviceSize size,
+                             BufferUploadInfo const &uploadInfo = {});
+  UploadToken uploadFromHost(Buffer &dst, void const *data, VkDeviceSize size,
+                             BufferUploadInfo const &uploadInfo = {});
+
+  // Uploads mip level 0, layer 0; `data` is tightly packed texels.
+  // Generating mips needs TRANSFER_SRC usage for blits, or SAMPLED and
+  // STORAGE usage for the compute fallback.
+  UploadToken upload(std::shared_ptr<Image> const &dst, void const *data,
+                     VkDeviceSize size, ImageUploadInfo const &uploadInfo);
+  UploadToken upload(Image &dst, void const *data, VkDeviceSize size,
+                     ImageUploadInfo const &uploadInfo);
+
+  // Submits the batch being recorded. `signalSemaphores` let graphics work
+  // wait on it on the GPU instead of on the token.
+  UploadToken flush(std::vector<VkSemaphore> const &signalSemaphores = {});
+
+  // Records the acquire half of every ownership transfer released so far
+  // into a command buffer of the destination family. The submission of that
+  // command buffer must wait on the returned semaphores.
+  OwnershipAcquire acquireOwnership(CommandBufferRecording &recording);
+
+  // Whether resources with this sharing mode are released to the consuming
+  // family and need acquireOwnership() before use.
+  bool needsTransfer(VkSharingMode sharingMode) const;
+  // Whether a MipGenerator was given, which ImageUploadInfo::generateMips
+  // requires.
+  bool canGenerateMips() const;
+
+  // Keeps `object` alive until every batch recorded so far, including the
+  // one being recorded, has completed.
+  void keepAlive(std::shared_ptr<void> object);
+
+  bool isComplete(UploadToken token);
+  void wait(UploadToken token);
+  void waitIdle();
+
+private:
+  struct Batch {
+    uint64_t id = 0;
+    std::shared_ptr<CommandBuffer> commandBuffer = {};
+    std::shared_ptr<Fence> fence = {};
+    uint64_t stagingEnd = 0;
+    std::vector<std::shared_ptr<void>> keepAlive;
+  };
+
+  struct OwnershipTransfer {
+    std::shared_ptr<Semaphore> semaphore = {};
+    VkPipelineStageFlags dstStageMask = 0;
+    std::vector<VkBufferMemoryBarrier> bufferBarriers;
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    // The buffers and images transferred; moved into the acquire.
+    std::vector<std::shared_ptr<void>> resources;
+    std::vector<std::pair<std::shared_ptr<Image>, MipGenerateInfo>>
+        deferredMips;
+  };
+
+  std::shared_ptr<Device> device = {};
+  Queue queue;
+  UploadContextCreateInfo createInfo;
+
+  std::mutex mutex;
+
+  std::shared_ptr<CommandPool> commandPool = {};
+  std::shared_ptr<Buffer> staging = {};
+  MemoryAllocation *stagingMemory = nullptr;
+  MappedRangeBatch stagingFlushes;
+  // Positions only ever grow; the ring offset is position % stagingSize.
+  uint64_t stagingHead = 0, stagingTail = 0;
+
+  std::vector<Batch> batches;
+  uint64_t recordingBatch = 1, oldestInFlight = 1;
+  std::unique_ptr<CommandBufferRecording> recording = {};
+
+  // Acquires for the batch being recorded, then for submitted batches.
+  OwnershipTransfer recordingTransfers;
+  std::vector<OwnershipTransfer> pendingTransfers;
+
+  // `owner` is null for the reference overloads.
+  UploadToken uploadBuffer(Buffer &dst, std::shared_ptr<Buffer> const &owner,
+                           void const *data, VkDeviceSize size,
+                           BufferUploadInfo const &uploadInfo);
+  UploadToken uploadBufferFromHost(Buffer &dst,
+                                   std::shared_ptr<Buffer> const &owner,
+                                   void const *data, VkDeviceSize size,
+                                   BufferUploadInfo const &uploadInfo);
+  UploadToken uploadImage(Image &dst, std::shared_ptr<Image> const &owner,
+                          void const *data, VkDeviceSize size,
+                          ImageUploadInfo const &uploadInfo);
+  void checkOwner(VkSharingMode sharingMode, void const *owner) const;
+  void release(Buffer &dst, std::shared_ptr<Buffer> const &owner,
+               VkDeviceSize size, BufferUploadInfo const &uploadInfo);
+
+  Batch &batch(uint64_t id);
+  CommandBufferRecording &record();
+  VkDeviceSize stage(void const *data, VkDeviceSize size,
+                     VkDeviceSize alignment);
+  void submit(std::vector<VkSemaphore> const &signalSemaphores);
+  void retireOldest();
+};
@@ -63,6 +63,8 @@ public:
     }
   }
 
+  explicit operator bool() const { return (bool)func; }
+
   _Res operator()(_ArgTypes... args) {
     if constexpr (std::is_void_v<_Res>)
       impl(std::forward<_ArgTypes>(args)...);
@@ -112,6 +114,11 @@ auto find_max(Iter begin, Iter end, Key key) {
 
 std::string readFile(std::istream &is);
 
+VkImageAspectFlags formatAspects(VkFormat format);
+
+// Bytes per texel of uncompressed single-aspect formats, 0 otherwise.
+uint32_t formatTexelSize(VkFormat format);
+
 template <typename T>
 std::shared_ptr<T> stack_ptr(T &value) {
   return std::shared_ptr<T>(&value, [](void *) -> void {});
@@ -1,11 +1,17 @@
 #pragma once
 
 #include "buffer.h"
+#include "draw_list.h"
 #include "command_buffer.h"
 #include "command_pool.h"
+#include "thread_command_pools.h"
+#include "static_command_cache.h"
 #include "debug.h"
 #include "device.h"
+#include "device_dispatch.h"
+#include "capture.h"
 #include "device_memory.h"
+#include "memory_allocator.h"
 #include "fence.h"
 #include "framebuffer.h"
 #include "glfw.h"
@@ -16,14 +22,21 @@
 #include "phys_dev.h"
 #include "pipeline_layout.h"
 #include "pipeline.h"
+#include "compute_pipeline.h"
 #include "queue.h"
 #include "render_pass.h"
 #include "semaphore.h"
+#include "task_graph.h"
 #include "shader_module.h"
 #include "surface.h"
 #include "swapchain.h"
 #include "utils.h"
 #include "descriptor_set_layout.h"
 #include "descriptor_pool.h"
+#include "ring_buffer.h"
+#include "upload_context.h"
+#include "mip_generator.h"
+#include "readback.h"
 #include "image.h"
+#include "attachment.h"
 #include "sampler.h"
\ No newline at end of file
@@ -9,8 +9,7 @@ struct TexStack {
 };
 
 #define RENDER_SET 0
-#define MODEL_SET 1
-#define MESH_SET 2
+#define MESH_SET 1
 
 layout(set = MESH_SET, binding = 0)
 uniform sampler2D textures[];
@@ -1,8 +1,7 @@
 #version 450
 
 #define RENDER_SET 0
-#define MODEL_SET 1
-#define MESH_SET 2
+#define MESH_SET 1
 
 layout(std140, set = RENDER_SET, binding = 0)
 uniform VP {
@@ -10,8 +9,8 @@ uniform VP {
   mat4 proj;
 };
 
-layout(std140, set = MODEL_SET, binding = 0)
-uniform Model {
+// Per-draw data; 112 bytes, within the 128 every device supports.
+layout(push_constant) uniform Model {
   mat4 model;
   mat3 normalMtx;
 };
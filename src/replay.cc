@@ -0,0 +1,1662 @@
+// Replays a file written by Capture and prints how long each frame took:
+//
+//   replay <capture file> [physical device index]
+//
+// Everything runs on one queue, which is waited for at every frame boundary,
+// so a frame's time covers all of its GPU work but no overlap with the next
+// frame or between queues. Swapchain images become ordinary images and
+// presents only end the frame.
+#include <vkt/capture.h>
+#include <vkt/device.h>
+#include <vkt/memory_allocator.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <set>
+#include <unordered_map>
+
+class Reader {
+public:
+  Reader(char const *data, size_t size) : data{data}, end{data + size} {}
+
+  template <typename T>
+  T get() {
+    T value;
+    read(&value, sizeof(T));
+    return value;
+  }
+
+  template <typename T>
+  std::vector<T> getArray() {
+    std::vector<T> values(get<uint32_t>());
+    read(values.data(), values.size() * sizeof(T));
+    return values;
+  }
+
+  template <typename T>
+  std::optional<T> getOptional() {
+    if (get<uint8_t>() == 0)
+      return std::nullopt;
+    return get<T>();
+  }
+
+  std::string getString() {
+    auto chars = getArray<char>();
+    return std::string(chars.begin(), chars.end());
+  }
+
+private:
+  void read(void *dst, size_t size) {
+    if ((size_t)(end - data) < size)
+      throw std::runtime_error("truncated capture record");
+    if (size > 0)
+      std::memcpy(dst, data, size);
+    data += size;
+  }
+
+  char const *data, *end;
+};
+
+// Swapchain layouts are not available without a swapchain.
+static VkImageLayout replayLayout(VkImageLayout layout) {
+  return layout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR ? VK_IMAGE_LAYOUT_GENERAL
+                                                   : layout;
+}
+
+struct ShaderStage {
+  VkPipelineShaderStageCreateInfo info;
+  std::string name;
+  std::optional<VkSpecializationInfo> spec;
+  std::vector<VkSpecializationMapEntry> mapEntries;
+  std::vector<char> data;
+};
+
+class Replayer {
+public:
+  Replayer(std::shared_ptr<Device> device, uint32_t queueFamilyIndex);
+  ~Replayer();
+
+  void replay(CaptureOp op, Reader &reader);
+
+  // Ends a trailing frame and prints the timings.
+  void finish();
+
+private:
+  struct Resource {
+    std::shared_ptr<MemoryAllocation> allocation = {};
+    uint64_t memory = 0;
+  };
+
+  struct HostRange {
+    VkDeviceSize offset, size;
+    char *data;
+    uint64_t resource;
+  };
+
+  std::shared_ptr<Device> device;
+  VkQueue queue = VK_NULL_HANDLE;
+  VkCommandPool commandPool = VK_NULL_HANDLE;
+
+  std::unordered_map<uint64_t, uint64_t> handles;
+  std::unordered_map<uint64_t, VkMemoryPropertyFlags> memoryFlags;
+  std::unordered_map<uint64_t, std::vector<HostRange>> hostRanges;
+  std::unordered_map<uint64_t, VkDeviceSize> bufferSizes;
+  std::unordered_map<uint64_t, VkImageTiling> imageTilings;
+  std::unordered_map<uint64_t, Resource> resources;
+  std::unordered_map<VkCommandBuffer, std::vector<VkCommandBuffer>> executed;
+  std::set<VkCommandBuffer> pending;
+  std::vector<std::function<void()>> garbage, destroyers;
+
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point frameStart = Clock::now();
+  bool frameStarted = false;
+  struct FrameTime {
+    double cpuMs, totalMs;
+  };
+  std::vector<FrameTime> frameTimes;
+  uint32_t stalls = 0;
+
+  template <typename H>
+  H lookup(H captured) {
+    if (captured == VK_NULL_HANDLE)
+      return VK_NULL_HANDLE;
+    auto it = handles.find((uint64_t)captured);
+    if (it == handles.end())
+      throw std::runtime_error("capture references an unknown object");
+    return (H)it->second;
+  }
+
+  template <typename H>
+  void bind(uint64_t captured, H replayed) {
+    handles[captured] = (uint64_t)replayed;
+  }
+
+  template <typename H>
+  std::vector<H> lookupAll(std::vector<H> captured) {
+    for (auto &handle : captured)
+      handle = lookup(handle);
+    return captured;
+  }
+
+  void wait();
+  // Waits for the queue first when a submission that may still be running
+  // uses `commandBuffer`, or any submission at all when it is null.
+  void waitIfPending(VkCommandBuffer commandBuffer = VK_NULL_HANDLE);
+  void endFrame();
+
+  template <typename F>
+  void immediate(F const &record);
+
+  std::shared_ptr<MemoryAllocation>
+  allocate(uint64_t memory, VkMemoryRequirements const &requirements,
+           bool linear);
+  void bindResource(uint64_t resource, uint64_t memory, VkDeviceSize offset,
+                    VkDeviceSize size,
+                    std::shared_ptr<MemoryAllocation> allocation);
+  void releaseResource(uint64_t resource);
+
+  ShaderStage getShaderStage(Reader &reader);
+  void createRenderPass(Reader &reader);
+  void createGraphicsPipeline(Reader &reader);
+  void updateDescriptorSets(Reader &reader);
+  void copyMemoryToImage(Reader &reader);
+  void beginCommandBuffer(Reader &reader);
+  void pipelineBarrier(Reader &reader);
+  void pipelineBarrier2(Reader &reader);
+  void beginRendering(Reader &reader);
+};
+
+Replayer::Replayer(std::shared_ptr<Device> device, uint32_t queueFamilyIndex)
+    : device{std::move(device)} {
+  this->device->vkGetDeviceQueue(*this->device, queueFamilyIndex, 0, &queue);
+
+  auto poolInfo = VkCommandPoolCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex = queueFamilyIndex};
+  VK_CHECK(this->device->vkCreateCommandPool(*this->device, &poolInfo,
+                                             nullptr, &commandPool));
+}
+
+Replayer::~Replayer() {
+  device->vkDeviceWaitIdle(*device);
+  for (auto &destroy : garbage)
+    destroy();
+  for (auto it = destroyers.rbegin(); it != destroyers.rend(); ++it)
+    (*it)();
+
+  // Buffers and images destroyed during the capture are gone from handles.
+  for (auto const &[id, _] : bufferSizes)
+    if (handles.contains(id))
+      device->vkDestroyBuffer(*device, (VkBuffer)handles[id], nullptr);
+  for (auto const &[id, _] : imageTilings)
+    if (handles.contains(id))
+      device->vkDestroyImage(*device, (VkImage)handles[id], nullptr);
+  device->vkDestroyCommandPool(*device, commandPool, nullptr);
+}
+
+void Replayer::wait() {
+  VK_CHECK(device->vkQueueWaitIdle(queue));
+  pending.clear();
+}
+
+void Replayer::waitIfPending(VkCommandBuffer commandBuffer) {
+  if (pending.empty())
+    return;
+  if (commandBuffer != VK_NULL_HANDLE && !pending.contains(commandBuffer))
+    return;
+  ++stalls;
+  wait();
+}
+
+void Replayer::endFrame() {
+  auto recorded = Clock::now();
+  wait();
+  auto done = Clock::now();
+
+  using Ms = std::chrono::duration<double, std::milli>;
+  frameTimes.push_back({.cpuMs = Ms(recorded - frameStart).count(),
+                        .totalMs = Ms(done - frameStart).count()});
+  std::printf("frame %6zu  cpu %9.3f ms  total %9.3f ms\n",
+              frameTimes.size() - 1, frameTimes.back().cpuMs,
+              frameTimes.back().totalMs);
+
+  for (auto &destroy : garbage)
+    destroy();
+  garbage.clear();
+
+  frameStart = Clock::now();
+  frameStarted = false;
+}
+
+void Replayer::finish() {
+  if (frameStarted || frameTimes.empty())
+    endFrame();
+
+  // The first frame also creates and uploads everything it uses.
+  if (frameTimes.size() < 2)
+    return;
+  std::vector<double> totals;
+  for (size_t index = 1; index < frameTimes.size(); ++index)
+    totals.push_back(frameTimes[index].totalMs);
+  std::sort(totals.begin(), totals.end());
+
+  double sum = 0;
+  for (auto total : totals)
+    sum += total;
+  std::printf("frames 1-%zu: mean %.3f ms, median %.3f ms, min %.3f ms, "
+              "max %.3f ms\n",
+              frameTimes.size() - 1, sum / totals.size(),
+              totals[totals.size() / 2], totals.front(), totals.back());
+  if (stalls > 0)
+    std::printf("%u waits for work reused within a frame\n", stalls);
+}
+
+template <typename F>
+void Replayer::immediate(F const &record) {
+  auto allocateInfo = VkCommandBufferAllocateInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .pNext = nullptr,
+      .commandPool = commandPool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1};
+  VkCommandBuffer commandBuffer;
+  VK_CHECK(device->vkAllocateCommandBuffers(*device, &allocateInfo,
+                                            &commandBuffer));
+
+  auto beginInfo = VkCommandBufferBeginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = nullptr,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+      .pInheritanceInfo = nullptr};
+  VK_CHECK(device->vkBeginCommandBuffer(commandBuffer, &beginInfo));
+  record(commandBuffer);
+  VK_CHECK(device->vkEndCommandBuffer(commandBuffer));
+
+  auto submitInfo = VkSubmitInfo{.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                                 .pNext = nullptr,
+                                 .waitSemaphoreCount = 0,
+                                 .pWaitSemaphores = nullptr,
+                                 .pWaitDstStageMask = nullptr,
+                                 .commandBufferCount = 1,
+                                 .pCommandBuffers = &commandBuffer,
+                                 .signalSemaphoreCount = 0,
+                                 .pSignalSemaphores = nullptr};
+  VK_CHECK(device->vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+  wait();
+  device->vkFreeCommandBuffers(*device, commandPool, 1, &commandBuffer);
+}
+
+std::shared_ptr<MemoryAllocation>
+Replayer::allocate(uint64_t memory, VkMemoryRequirements const &requirements,
+                   bool linear) {
+  auto flags = memoryFlags.at(memory);
+  auto hostVisible = (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+  return device->allocator->allocate(MemoryAllocationCreateInfo{
+      .requirements = requirements,
+      .properties = hostVisible ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+                                : (VkMemoryPropertyFlags)0,
+      .preferredProperties = flags,
+      .linear = linear});
+}
+
+// Resources get memory of their own, so captured offsets only matter for
+// routing host writes.
+void Replayer::bindResource(uint64_t resource, uint64_t memory,
+                            VkDeviceSize offset, VkDeviceSize size,
+                            std::shared_ptr<MemoryAllocation> allocation) {
+  if (memoryFlags[memory] & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    hostRanges[memory].push_back({.offset = offset,
+                                  .size = size,
+                                  .data = (char *)allocation->map(),
+                                  .resource = resource});
+  resources[resource] = {.allocation = std::move(allocation),
+                         .memory = memory};
+}
+
+void Replayer::releaseResource(uint64_t resource) {
+  auto it = resources.find(resource);
+  if (it == resources.end())
+    return;
+
+  auto &ranges = hostRanges[it->second.memory];
+  std::erase_if(ranges, [&](HostRange const &range) -> bool {
+    return range.resource == resource;
+  });
+  garbage.push_back([allocation = std::move(it->second.allocation)]() {});
+  resources.erase(it);
+}
+
+ShaderStage Replayer::getShaderStage(Reader &reader) {
+  ShaderStage stage;
+  stage.info = reader.get<VkPipelineShaderStageCreateInfo>();
+  stage.info.pNext = nullptr;
+  stage.info.module = lookup(stage.info.module);
+  stage.name = reader.getString();
+  stage.spec = reader.getOptional<VkSpecializationInfo>();
+  if (stage.spec) {
+    stage.mapEntries = reader.getArray<VkSpecializationMapEntry>();
+    stage.data = reader.getArray<char>();
+  }
+  return stage;
+}
+
+static void linkShaderStages(std::vector<ShaderStage> &stages) {
+  for (auto &stage : stages) {
+    stage.info.pName = stage.name.c_str();
+    stage.info.pSpecializationInfo = nullptr;
+    if (stage.spec) {
+      stage.spec->pMapEntries = stage.mapEntries.data();
+      stage.spec->pData = stage.data.data();
+      stage.info.pSpecializationInfo = &*stage.spec;
+    }
+  }
+}
+
+void Replayer::createRenderPass(Reader &reader) {
+  auto id = reader.get<uint64_t>();
+  auto flags = reader.get<VkRenderPassCreateFlags>();
+  auto attachments = reader.getArray<VkAttachmentDescription>();
+  for (auto &attachment : attachments) {
+    attachment.initialLayout = replayLayout(attachment.initialLayout);
+    attachment.finalLayout = replayLayout(attachment.finalLayout);
+  }
+
+  struct Subpass {
+    std::vector<VkAttachmentReference> inputs, colors, resolves;
+    std::optional<VkAttachmentReference> depthStencil;
+    std::vector<uint32_t> preserves;
+  };
+  std::vector<VkSubpassDescription> subpasses(reader.get<uint32_t>());
+  std::vector<Subpass> references(subpasses.size());
+  for (size_t index = 0; index < subpasses.size(); ++index) {
+    auto &subpass = subpasses[index];
+    auto &refs = references[index];
+    subpass = reader.get<VkSubpassDescription>();
+    refs.inputs = reader.getArray<VkAttachmentReference>();
+    refs.colors = reader.getArray<VkAttachmentReference>();
+    refs.resolves = reader.getArray<VkAttachmentReference>();
+    refs.depthStencil = reader.getOptional<VkAttachmentReference>();
+    refs.preserves = reader.getArray<uint32_t>();
+
+    subpass.pInputAttachments = refs.inputs.data();
+    subpass.pColorAttachments = refs.colors.data();
+    subpass.pResolveAttachments =
+        refs.resolves.empty() ? nullptr : refs.resolves.data();
+    subpass.pDepthStencilAttachment =
+        refs.depthStencil ? &*refs.depthStencil : nullptr;
+    subpass.pPreserveAttachments = refs.preserves.data();
+  }
+  auto dependencies = reader.getArray<VkSubpassDependency>();
+
+  auto createInfo = VkRenderPassCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = flags,
+      .attachmentCount = (uint32_t)attachments.size(),
+      .pAttachments = attachments.data(),
+      .subpassCount = (uint32_t)subpasses.size(),
+      .pSubpasses = subpasses.data(),
+      .dependencyCount = (uint32_t)dependencies.size(),
+      .pDependencies = dependencies.data()};
+  VkRenderPass renderPass;
+  VK_CHECK(device->vkCreateRenderPass(*device, &createInfo, nullptr,
+                                      &renderPass));
+  bind(id, renderPass);
+  destroyers.push_back([this, renderPass]() {
+    device->vkDestroyRenderPass(*device, renderPass, nullptr);
+  });
+}
+
+void Replayer::createGraphicsPipeline(Reader &reader) {
+  auto id = reader.get<uint64_t>();
+  auto flags = reader.get<VkPipelineCreateFlags>();
+
+  std::vector<ShaderStage> stages(reader.get<uint32_t>());
+  for (auto &stage : stages)
+    stage = getShaderStage(reader);
+  linkShaderStages(stages);
+  std::vector<VkPipelineShaderStageCreateInfo> stageInfos;
+  for (auto const &stage : stages)
+    stageInfos.push_back(stage.info);
+
+  auto vertexInput =
+      reader.getOptional<VkPipelineVertexInputStateCreateInfo>();
+  std::vector<VkVertexInputBindingDescription> bindings;
+  std::vector<VkVertexInputAttributeDescription> attributes;
+  if (vertexInput) {
+    bindings = reader.getArray<VkVertexInputBindingDescription>();
+    attributes = reader.getArray<VkVertexInputAttributeDescription>();
+    vertexInput->pNext = nullptr;
+    vertexInput->pVertexBindingDescriptions = bindings.data();
+    vertexInput->pVertexAttributeDescriptions = attributes.data();
+  }
+
+  auto inputAssembly =
+      reader.getOptional<VkPipelineInputAssemblyStateCreateInfo>();
+  if (inputAssembly)
+    inputAssembly->pNext = nullptr;
+  auto tessellation =
+      reader.getOptional<VkPipelineTessellationStateCreateInfo>();
+  if (tessellation)
+    tessellation->pNext = nullptr;
+
+  auto viewport = reader.getOptional<VkPipelineViewportStateCreateInfo>();
+  std::vector<VkViewport> viewports;
+  std::vector<VkRect2D> scissors;
+  if (viewport) {
+    viewports = reader.getArray<VkViewport>();
+    scissors = reader.getArray<VkRect2D>();
+    viewport->pNext = nullptr;
+    viewport->pViewports = viewports.empty() ? nullptr : viewports.data();
+    viewport->pScissors = scissors.empty() ? nullptr : scissors.data();
+  }
+
+  auto rasterization =
+      reader.getOptional<VkPipelineRasterizationStateCreateInfo>();
+  if (rasterization)
+    rasterization->pNext = nullptr;
+
+  auto multisample =
+      reader.getOptional<VkPipelineMultisampleStateCreateInfo>();
+  std::vector<VkSampleMask> sampleMask;
+  if (multisample) {
+    sampleMask = reader.getArray<VkSampleMask>();
+    multisample->pNext = nullptr;
+    multisample->pSampleMask = sampleMask.empty() ? nullptr : sampleMask.data();
+  }
+
+  auto depthStencil =
+      reader.getOptional<VkPipelineDepthStencilStateCreateInfo>();
+  if (depthStencil)
+    depthStencil->pNext = nullptr;
+
+  auto colorBlend = reader.getOptional<VkPipelineColorBlendStateCreateInfo>();
+  std::vector<VkPipelineColorBlendAttachmentState> blendAttachments;
+  if (colorBlend) {
+    blendAttachments = reader.getArray<VkPipelineColorBlendAttachmentState>();
+    colorBlend->pNext = nullptr;
+    colorBlend->pAttachments = blendAttachments.data();
+  }
+
+  auto dynamic = reader.getOptional<VkPipelineDynamicStateCreateInfo>();
+  std::vector<VkDynamicState> dynamicStates;
+  if (dynamic) {
+    dynamicStates = reader.getArray<VkDynamicState>();
+    dynamic->pNext = nullptr;
+    dynamic->pDynamicStates = dynamicStates.data();
+  }
+
+  auto rendering = reader.getOptional<VkPipelineRenderingCreateInfo>();
+  std::vector<VkFormat> colorFormats;
+  if (rendering) {
+    colorFormats = reader.getArray<VkFormat>();
+    rendering->pNext = nullptr;
+    rendering->pColorAttachmentFormats = colorFormats.data();
+  }
+
+  auto layout = lookup(reader.get<VkPipelineLayout>());
+  auto renderPass = lookup(reader.get<VkRenderPass>());
+  auto subpass = reader.get<uint32_t>();
+
+  auto optional = [](auto &value) -> auto {
+    return value ? &*value : nullptr;
+  };
+  auto createInfo = VkGraphicsPipelineCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+      .pNext = optional(rendering),
+      .flags = flags,
+      .stageCount = (uint32_t)stageInfos.size(),
+      .pStages = stageInfos.data(),
+      .pVertexInputState = optional(vertexInput),
+      .pInputAssemblyState = optional(inputAssembly),
+      .pTessellationState = optional(tessellation),
+      .pViewportState = optional(viewport),
+      .pRasterizationState = optional(rasterization),
+      .pMultisampleState = optional(multisample),
+      .pDepthStencilState = optional(depthStencil),
+      .pColorBlendState = optional(colorBlend),
+      .pDynamicState = optional(dynamic),
+      .layout = layout,
+      .renderPass = renderPass,
+      .subpass = subpass,
+      .basePipelineHandle = VK_NULL_HANDLE,
+      .basePipelineIndex = -1};
+  VkPipeline pipeline;
+  VK_CHECK(device->vkCreateGraphicsPipelines(*device, VK_NULL_HANDLE, 1,
+                                             &createInfo, nullptr, &pipeline));
+  bind(id, pipeline);
+  destroyers.push_back([this, pipeline]() {
+    device->vkDestroyPipeline(*device, pipeline, nullptr);
+  });
+}
+
+void Replayer::updateDescriptorSets(Reader &reader) {
+  struct Write {
+    VkWriteDescriptorSet write;
+    std::vector<VkDescriptorImageInfo> images;
+    std::vector<VkDescriptorBufferInfo> buffers;
+    std::vector<VkBufferView> texelBufferViews;
+  };
+
+  std::vector<Write> writes(reader.get<uint32_t>());
+  for (auto &write : writes) {
+    write.write = reader.get<VkWriteDescriptorSet>();
+    write.write.pNext = nullptr;
+    write.write.dstSet = lookup(write.write.dstSet);
+    write.write.pImageInfo = nullptr;
+    write.write.pBufferInfo = nullptr;
+    write.write.pTexelBufferView = nullptr;
+
+    switch (reader.get<uint8_t>()) {
+    case 1:
+      write.images = reader.getArray<VkDescriptorImageInfo>();
+      for (auto &image : write.images) {
+        image.sampler = lookup(image.sampler);
+        image.imageView = lookup(image.imageView);
+        image.imageLayout = replayLayout(image.imageLayout);
+      }
+      write.write.pImageInfo = write.images.data();
+      break;
+    case 2:
+      write.buffers = reader.getArray<VkDescriptorBufferInfo>();
+      for (auto &buffer : write.buffers)
+        buffer.buffer = lookup(buffer.buffer);
+      write.write.pBufferInfo = write.buffers.data();
+      break;
+    case 3:
+      write.texelBufferViews = lookupAll(reader.getArray<VkBufferView>());
+      write.write.pTexelBufferView = write.texelBufferViews.data();
+      break;
+    }
+  }
+
+  auto copies = reader.getArray<VkCopyDescriptorSet>();
+  for (auto &copy : copies) {
+    copy.pNext = nullptr;
+    copy.srcSet = lookup(copy.srcSet);
+    copy.dstSet = lookup(copy.dstSet);
+  }
+
+  std::vector<VkWriteDescriptorSet> writeInfos;
+  for (auto const &write : writes)
+    writeInfos.push_back(write.write);
+  device->vkUpdateDescriptorSets(*device, (uint32_t)writeInfos.size(),
+                                 writeInfos.data(), (uint32_t)copies.size(),
+                                 copies.data());
+}
+
+// Host image copies become a staged copy on the queue, so that they also
+// work on devices without VK_EXT_host_image_copy.
+void Replayer::copyMemoryToImage(Reader &reader) {
+  auto image = lookup(reader.get<VkImage>());
+  auto layout = replayLayout(reader.get<VkImageLayout>());
+  auto regionCount = reader.get<uint32_t>();
+
+  for (uint32_t index = 0; index < regionCount; ++index) {
+    auto region = reader.get<VkMemoryToImageCopyEXT>();
+    auto data = reader.getArray<char>();
+    if (data.empty())
+      continue;
+
+    auto bufferInfo = VkBufferCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = {},
+        .size = data.size(),
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices = nullptr};
+    VkBuffer staging;
+    VK_CHECK(device->vkCreateBuffer(*device, &bufferInfo, nullptr, &staging));
+
+    VkMemoryRequirements requirements;
+    device->vkGetBufferMemoryRequirements(*device, staging, &requirements);
+    auto allocation = device->allocator->allocate(MemoryAllocationCreateInfo{
+        .requirements = requirements,
+        .properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT});
+    VK_CHECK(device->vkBindBufferMemory(*device, staging, *allocation,
+                                        allocation->getOffset()));
+    std::memcpy(allocation->map(), data.data(), data.size());
+
+    auto subresource = region.imageSubresource;
+    immediate([&](VkCommandBuffer commandBuffer) {
+      auto barrier = VkImageMemoryBarrier{
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+          .pNext = nullptr,
+          .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+          .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+          .oldLayout = layout,
+          .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .image = image,
+          .subresourceRange = {.aspectMask = subresource.aspectMask,
+                               .baseMipLevel = subresource.mipLevel,
+                               .levelCount = 1,
+                               .baseArrayLayer = subresource.baseArrayLayer,
+                               .layerCount = subresource.layerCount}};
+      device->vkCmdPipelineBarrier(
+          commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+          VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+          &barrier);
+
+      auto copy = VkBufferImageCopy{.bufferOffset = 0,
+                                    .bufferRowLength = region.memoryRowLength,
+                                    .bufferImageHeight =
+                                        region.memoryImageHeight,
+                                    .imageSubresource = subresource,
+                                    .imageOffset = region.imageOffset,
+                                    .imageExtent = region.imageExtent};
+      device->vkCmdCopyBufferToImage(commandBuffer, staging, image,
+                                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
+                                     &copy);
+
+      std::swap(barrier.oldLayout, barrier.newLayout);
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask =
+          VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+      device->vkCmdPipelineBarrier(
+          commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1,
+          &barrier);
+    });
+
+    device->vkDestroyBuffer(*device, staging, nullptr);
+  }
+}
+
+void Replayer::beginCommandBuffer(Reader &reader) {
+  auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+  auto flags = reader.get<VkCommandBufferUsageFlags>();
+  auto inheritance = reader.getOptional<VkCommandBufferInheritanceInfo>();
+  auto rendering =
+      reader.getOptional<VkCommandBufferInheritanceRenderingInfo>();
+  std::vector<VkFormat> colorFormats;
+  if (rendering) {
+    colorFormats = reader.getArray<VkFormat>();
+    rendering->pNext = nullptr;
+    rendering->pColorAttachmentFormats = colorFormats.data();
+  }
+  if (inheritance) {
+    inheritance->pNext = rendering ? &*rendering : nullptr;
+    inheritance->renderPass = lookup(inheritance->renderPass);
+    inheritance->framebuffer = lookup(inheritance->framebuffer);
+  }
+
+  waitIfPending(commandBuffer);
+  executed.erase(commandBuffer);
+
+  auto beginInfo = VkCommandBufferBeginInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .pNext = nullptr,
+      .flags = flags,
+      .pInheritanceInfo = inheritance ? &*inheritance : nullptr};
+  VK_CHECK(device->vkBeginCommandBuffer(commandBuffer, &beginInfo));
+}
+
+void Replayer::pipelineBarrier(Reader &reader) {
+  auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+  auto srcStageMask = reader.get<VkPipelineStageFlags>();
+  auto dstStageMask = reader.get<VkPipelineStageFlags>();
+  auto dependencyFlags = reader.get<VkDependencyFlags>();
+
+  // Ownership transfers become plain barriers on the one queue.
+  auto memoryBarriers = reader.getArray<VkMemoryBarrier>();
+  for (auto &barrier : memoryBarriers)
+    barrier.pNext = nullptr;
+  auto bufferBarriers = reader.getArray<VkBufferMemoryBarrier>();
+  for (auto &barrier : bufferBarriers) {
+    barrier.pNext = nullptr;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = lookup(barrier.buffer);
+  }
+  auto imageBarriers = reader.getArray<VkImageMemoryBarrier>();
+  for (auto &barrier : imageBarriers) {
+    barrier.pNext = nullptr;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.oldLayout = replayLayout(barrier.oldLayout);
+    barrier.newLayout = replayLayout(barrier.newLayout);
+    barrier.image = lookup(barrier.image);
+  }
+
+  device->vkCmdPipelineBarrier(
+      commandBuffer, srcStageMask, dstStageMask, dependencyFlags,
+      (uint32_t)memoryBarriers.size(), memoryBarriers.data(),
+      (uint32_t)bufferBarriers.size(), bufferBarriers.data(),
+      (uint32_t)imageBarriers.size(), imageBarriers.data());
+}
+
+void Replayer::pipelineBarrier2(Reader &reader) {
+  auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+  auto dependencyFlags = reader.get<VkDependencyFlags>();
+
+  auto memoryBarriers = reader.getArray<VkMemoryBarrier2>();
+  for (auto &barrier : memoryBarriers)
+    barrier.pNext = nullptr;
+  auto bufferBarriers = reader.getArray<VkBufferMemoryBarrier2>();
+  for (auto &barrier : bufferBarriers) {
+    barrier.pNext = nullptr;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = lookup(barrier.buffer);
+  }
+  auto imageBarriers = reader.getArray<VkImageMemoryBarrier2>();
+  for (auto &barrier : imageBarriers) {
+    barrier.pNext = nullptr;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.oldLayout = replayLayout(barrier.oldLayout);
+    barrier.newLayout = replayLayout(barrier.newLayout);
+    barrier.image = lookup(barrier.image);
+  }
+
+  auto dependencyInfo = VkDependencyInfo{
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .pNext = nullptr,
+      .dependencyFlags = dependencyFlags,
+      .memoryBarrierCount = (uint32_t)memoryBarriers.size(),
+      .pMemoryBarriers = memoryBarriers.data(),
+      .bufferMemoryBarrierCount = (uint32_t)bufferBarriers.size(),
+      .pBufferMemoryBarriers = bufferBarriers.data(),
+      .imageMemoryBarrierCount = (uint32_t)imageBarriers.size(),
+      .pImageMemoryBarriers = imageBarriers.data()};
+  device->vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+}
+
+void Replayer::beginRendering(Reader &reader) {
+  auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+  auto flags = reader.get<VkRenderingFlags>();
+  auto renderArea = reader.get<VkRect2D>();
+  auto layerCount = reader.get<uint32_t>();
+  auto viewMask = reader.get<uint32_t>();
+  auto colorAttachments = reader.getArray<VkRenderingAttachmentInfo>();
+  auto depthAttachment = reader.getOptional<VkRenderingAttachmentInfo>();
+  auto stencilAttachment = reader.getOptional<VkRenderingAttachmentInfo>();
+
+  auto patch = [&](VkRenderingAttachmentInfo &attachment) {
+    attachment.pNext = nullptr;
+    attachment.imageView = lookup(attachment.imageView);
+    attachment.imageLayout = replayLayout(attachment.imageLayout);
+    attachment.resolveImageView = lookup(attachment.resolveImageView);
+    attachment.resolveImageLayout =
+        replayLayout(attachment.resolveImageLayout);
+  };
+  for (auto &attachment : colorAttachments)
+    patch(attachment);
+  if (depthAttachment)
+    patch(*depthAttachment);
+  if (stencilAttachment)
+    patch(*stencilAttachment);
+
+  auto renderingInfo = VkRenderingInfo{
+      .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+      .pNext = nullptr,
+      .flags = flags,
+      .renderArea = renderArea,
+      .layerCount = layerCount,
+      .viewMask = viewMask,
+      .colorAttachmentCount = (uint32_t)colorAttachments.size(),
+      .pColorAttachments = colorAttachments.data(),
+      .pDepthAttachment = depthAttachment ? &*depthAttachment : nullptr,
+      .pStencilAttachment = stencilAttachment ? &*stencilAttachment : nullptr};
+  device->vkCmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void Replayer::replay(CaptureOp op, Reader &reader) {
+  frameStarted = true;
+
+  switch (op) {
+  case CaptureOp::Device:
+    throw std::runtime_error("capture holds more than one device");
+
+  case CaptureOp::Frame:
+    endFrame();
+    break;
+
+  case CaptureOp::AllocateMemory: {
+    auto memory = reader.get<uint64_t>();
+    reader.get<VkDeviceSize>();
+    memoryFlags[memory] = reader.get<VkMemoryPropertyFlags>();
+    hostRanges.erase(memory);
+    break;
+  }
+
+  case CaptureOp::HostWrite: {
+    auto memory = reader.get<uint64_t>();
+    auto offset = reader.get<VkDeviceSize>();
+    auto data = reader.getArray<char>();
+    auto it = hostRanges.find(memory);
+    if (it == hostRanges.end())
+      break;
+
+    // The application waited for earlier work before writing; the replay
+    // does not know which, so it waits for everything.
+    waitIfPending();
+    for (auto const &range : it->second) {
+      auto begin = std::max(offset, range.offset);
+      auto end = std::min(offset + data.size(), range.offset + range.size);
+      if (begin < end)
+        std::memcpy(range.data + (begin - range.offset),
+                    data.data() + (begin - offset), end - begin);
+    }
+    break;
+  }
+
+  case CaptureOp::CreateBuffer: {
+    auto id = reader.get<uint64_t>();
+    auto createInfo = reader.get<VkBufferCreateInfo>();
+    createInfo.pNext = nullptr;
+    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    createInfo.queueFamilyIndexCount = 0;
+    createInfo.pQueueFamilyIndices = nullptr;
+
+    VkBuffer buffer;
+    VK_CHECK(device->vkCreateBuffer(*device, &createInfo, nullptr, &buffer));
+    bind(id, buffer);
+    bufferSizes[id] = createInfo.size;
+    break;
+  }
+
+  case CaptureOp::BindBufferMemory: {
+    auto id = reader.get<uint64_t>();
+    auto memory = reader.get<uint64_t>();
+    auto offset = reader.get<VkDeviceSize>();
+
+    auto buffer = lookup((VkBuffer)id);
+    VkMemoryRequirements requirements;
+    device->vkGetBufferMemoryRequirements(*device, buffer, &requirements);
+    auto allocation = allocate(memory, requirements, true);
+    VK_CHECK(device->vkBindBufferMemory(*device, buffer, *allocation,
+                                        allocation->getOffset()));
+    bindResource(id, memory, offset, bufferSizes[id], std::move(allocation));
+    break;
+  }
+
+  case CaptureOp::DestroyBuffer: {
+    auto id = reader.get<uint64_t>();
+    auto buffer = lookup((VkBuffer)id);
+    releaseResource(id);
+    handles.erase(id);
+    garbage.push_back([this, buffer]() {
+      device->vkDestroyBuffer(*device, buffer, nullptr);
+    });
+    break;
+  }
+
+  case CaptureOp::CreateImage:
+  case CaptureOp::SwapchainImage: {
+    auto id = reader.get<uint64_t>();
+    auto createInfo = reader.get<VkImageCreateInfo>();
+    createInfo.pNext = nullptr;
+    createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    createInfo.queueFamilyIndexCount = 0;
+    createInfo.pQueueFamilyIndices = nullptr;
+    if (createInfo.usage & VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT)
+      createInfo.usage = (createInfo.usage &
+                          ~VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT) |
+                         VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+    VkImage image;
+    VK_CHECK(device->vkCreateImage(*device, &createInfo, nullptr, &image));
+    bind(id, image);
+    imageTilings[id] = createInfo.tiling;
+
+    if (op == CaptureOp::SwapchainImage) {
+      VkMemoryRequirements requirements;
+      device->vkGetImageMemoryRequirements(*device, image, &requirements);
+      auto allocation =
+          device->allocator->allocate(MemoryAllocationCreateInfo{
+              .requirements = requirements,
+              .properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+              .linear = false});
+      VK_CHECK(device->vkBindImageMemory(*device, image, *allocation,
+                                         allocation->getOffset()));
+      resources[id] = {.allocation = std::move(allocation), .memory = 0};
+    }
+    break;
+  }
+
+  case CaptureOp::BindImageMemory: {
+    auto id = reader.get<uint64_t>();
+    auto memory = reader.get<uint64_t>();
+    auto offset = reader.get<VkDeviceSize>();
+    auto size = reader.get<VkDeviceSize>();
+
+    auto image = lookup((VkImage)id);
+    VkMemoryRequirements requirements;
+    device->vkGetImageMemoryRequirements(*device, image, &requirements);
+    auto allocation = allocate(memory, requirements,
+                               imageTilings[id] == VK_IMAGE_TILING_LINEAR);
+    VK_CHECK(device->vkBindImageMemory(*device, image, *allocation,
+                                       allocation->getOffset()));
+    bindResource(id, memory, offset, size, std::move(allocation));
+    break;
+  }
+
+  case CaptureOp::DestroyImage: {
+    auto id = reader.get<uint64_t>();
+    auto image = lookup((VkImage)id);
+    releaseResource(id);
+    handles.erase(id);
+    garbage.push_back([this, image]() {
+      device->vkDestroyImage(*device, image, nullptr);
+    });
+    break;
+  }
+
+  case CaptureOp::CopyMemoryToImage:
+    copyMemoryToImage(reader);
+    break;
+
+  case CaptureOp::TransitionImageLayout: {
+    auto transitions = reader.getArray<VkHostImageLayoutTransitionInfoEXT>();
+    std::vector<VkImageMemoryBarrier> barriers;
+    for (auto const &transition : transitions)
+      barriers.push_back(VkImageMemoryBarrier{
+          .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+          .pNext = nullptr,
+          .srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT,
+          .dstAccessMask =
+              VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT,
+          .oldLayout = replayLayout(transition.oldLayout),
+          .newLayout = replayLayout(transition.newLayout),
+          .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+          .image = lookup(transition.image),
+          .subresourceRange = transition.subresourceRange});
+    immediate([&](VkCommandBuffer commandBuffer) {
+      device->vkCmdPipelineBarrier(
+          commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr,
+          (uint32_t)barriers.size(), barriers.data());
+    });
+    break;
+  }
+
+  case CaptureOp::CreateImageView: {
+    auto id = reader.get<uint64_t>();
+    auto createInfo = reader.get<VkImageViewCreateInfo>();
+    createInfo.pNext = nullptr;
+    createInfo.image = lookup(createInfo.image);
+
+    VkImageView imageView;
+    VK_CHECK(
+        device->vkCreateImageView(*device, &createInfo, nullptr, &imageView));
+    bind(id, imageView);
+    destroyers.push_back([this, imageView]() {
+      device->vkDestroyImageView(*device, imageView, nullptr);
+    });
+    break;
+  }
+
+  case CaptureOp::CreateSampler: {
+    auto id = reader.get<uint64_t>();
+    auto createInfo = reader.get<VkSamplerCreateInfo>();
+    createInfo.pNext = nullptr;
+
+    VkSampler sampler;
+    VK_CHECK(device->vkCreateSampler(*device, &createInfo, nullptr, &sampler));
+    bind(id, sampler);
+    destroyers.push_back([this, sampler]() {
+      device->vkDestroySampler(*device, sampler, nullptr);
+    });
+    break;
+  }
+
+  case CaptureOp::CreateShaderModule: {
+    auto id = reader.get<uint64_t>();
+    auto flags = reader.get<VkShaderModuleCreateFlags>();
+    auto code = reader.getArray<char>();
+
+    auto createInfo = VkShaderModuleCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = flags,
+        .codeSize = code.size(),
+        .pCode = (uint32_t const *)code.data()};
+    VkShaderModule shaderModule;
+    VK_CHECK(device->vkCreateShaderModule(*device, &createInfo, nullptr,
+                                          &shaderModule));
+    bind(id, shaderModule);
+    destroyers.push_back([this, shaderModule]() {
+      device->vkDestroyShaderModule(*device, shaderModule, nullptr);
+    });
+    break;
+  }
+
+  case CaptureOp::CreateDescriptorSetLayout: {
+    auto id = reader.get<uint64_t>();
+    auto flags = reader.get<VkDescriptorSetLayoutCreateFlags>();
+    std::vector<VkDescriptorSetLayoutBinding> bindings(reader.get<uint32_t>());
+    std::vector<std::vector<VkSampler>> samplers(bindings.size());
+    for (size_t index = 0; index < bindings.size(); ++index) {
+      bindings[index] = reader.get<VkDescriptorSetLayoutBinding>();
+      samplers[index] = lookupAll(reader.getArray<VkSampler>());
+      bindings[index].pImmutableSamplers =
+          samplers[index].empty() ? nullptr : samplers[index].data();
+    }
+
+    auto createInfo = VkDescriptorSetLayoutCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = flags,
+        .bindingCount = (uint32_t)bindings.size(),
+        .pBindings = bindings.data()};
+    VkDescriptorSetLayout layout;
+    VK_CHECK(device->vkCreateDescriptorSetLayout(*device, &createInfo,
+                                                 nullptr, &layout));
+    bind(id, layout);
+    destroyers.push_back([this, layout]() {
+      device->vkDestroyDescriptorSetLayout(*device, layout, nullptr);
+    });
+    break;
+  }
+
+  case CaptureOp::CreatePipelineLayout: {
+    auto id = reader.get<uint64_t>();
+    auto flags = reader.get<VkPipelineLayoutCreateFlags>();
+    auto setLayouts = lookupAll(reader.getArray<VkDescriptorSetLayout>());
+    auto pushConstantRanges = reader.getArray<VkPushConstantRange>();
+
+    auto createInfo = VkPipelineLayoutCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = flags,
+        .setLayoutCount = (uint32_t)setLayouts.size(),
+        .pSetLayouts = setLayouts.data(),
+        .pushConstantRangeCount = (uint32_t)pushConstantRanges.size(),
+        .pPushConstantRanges = pushConstantRanges.data()};
+    VkPipelineLayout layout;
+    VK_CHECK(device->vkCreatePipelineLayout(*device, &createInfo, nullptr,
+                                            &layout));
+    bind(id, layout);
+    destroyers.push_back([this, layout]() {
+      device->vkDestroyPipelineLayout(*device, layout, nullptr);
+    });
+    break;
+  }
+
+  case CaptureOp::CreateDescriptorPool: {
+    auto id = reader.get<uint64_t>();
+    auto flags = reader.get<VkDescriptorPoolCreateFlags>();
+    auto maxSets = reader.get<uint32_t>();
+    auto poolSizes = reader.getArray<VkDescriptorPoolSize>();
+
+    auto createInfo = VkDescriptorPoolCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = flags,
+        .maxSets = maxSets,
+        .poolSizeCount = (uint32_t)poolSizes.size(),
+        .pPoolSizes = poolSizes.data()};
+    VkDescriptorPool pool;
+    VK_CHECK(
+        device->vkCreateDescriptorPool(*device, &createInfo, nullptr, &pool));
+    bind(id, pool);
+    destroyers.push_back([this, pool]() {
+      device->vkDestroyDescriptorPool(*device, pool, nullptr);
+    });
+    break;
+  }
+
+  case CaptureOp::AllocateDescriptorSets: {
+    auto pool = lookup(reader.get<VkDescriptorPool>());
+    auto setLayouts = lookupAll(reader.getArray<VkDescriptorSetLayout>());
+    auto ids = reader.getArray<uint64_t>();
+
+    auto allocateInfo = VkDescriptorSetAllocateInfo{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .descriptorPool = pool,
+        .descriptorSetCount = (uint32_t)setLayouts.size(),
+        .pSetLayouts = setLayouts.data()};
+    std::vector<VkDescriptorSet> sets(setLayouts.size());
+    VK_CHECK(
+        device->vkAllocateDescriptorSets(*device, &allocateInfo, sets.data()));
+    for (size_t index = 0; index < sets.size(); ++index)
+      bind(ids[index], sets[index]);
+    break;
+  }
+
+  case CaptureOp::UpdateDescriptorSets:
+    updateDescriptorSets(reader);
+    break;
+
+  case CaptureOp::CreateRenderPass:
+    createRenderPass(reader);
+    break;
+
+  case CaptureOp::CreateFramebuffer: {
+    auto id = reader.get<uint64_t>();
+    auto createInfo = reader.get<VkFramebufferCreateInfo>();
+    auto attachments = lookupAll(reader.getArray<VkImageView>());
+    createInfo.pNext = nullptr;
+    createInfo.renderPass = lookup(createInfo.renderPass);
+    createInfo.pAttachments = attachments.data();
+
+    VkFramebuffer framebuffer;
+    VK_CHECK(device->vkCreateFramebuffer(*device, &createInfo, nullptr,
+                                         &framebuffer));
+    bind(id, framebuffer);
+    destroyers.push_back([this, framebuffer]() {
+      device->vkDestroyFramebuffer(*device, framebuffer, nullptr);
+    });
+    break;
+  }
+
+  case CaptureOp::CreateComputePipeline: {
+    auto id = reader.get<uint64_t>();
+    auto flags = reader.get<VkPipelineCreateFlags>();
+    std::vector<ShaderStage> stages;
+    stages.push_back(getShaderStage(reader));
+    linkShaderStages(stages);
+    auto layout = lookup(reader.get<VkPipelineLayout>());
+
+    auto createInfo = VkComputePipelineCreateInfo{
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = flags,
+        .stage = stages[0].info,
+        .layout = layout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = -1};
+    VkPipeline pipeline;
+    VK_CHECK(device->vkCreateComputePipelines(
+        *device, VK_NULL_HANDLE, 1, &createInfo, nullptr, &pipeline));
+    bind(id, pipeline);
+    destroyers.push_back([this, pipeline]() {
+      device->vkDestroyPipeline(*device, pipeline, nullptr);
+    });
+    break;
+  }
+
+  case CaptureOp::CreateGraphicsPipeline:
+    createGraphicsPipeline(reader);
+    break;
+
+  case CaptureOp::AllocateCommandBuffers: {
+    auto level = reader.get<VkCommandBufferLevel>();
+    auto ids = reader.getArray<uint64_t>();
+
+    auto allocateInfo = VkCommandBufferAllocateInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext = nullptr,
+        .commandPool = commandPool,
+        .level = level,
+        .commandBufferCount = (uint32_t)ids.size()};
+    std::vector<VkCommandBuffer> commandBuffers(ids.size());
+    VK_CHECK(device->vkAllocateCommandBuffers(*device, &allocateInfo,
+                                              commandBuffers.data()));
+    for (size_t index = 0; index < ids.size(); ++index)
+      bind(ids[index], commandBuffers[index]);
+    break;
+  }
+
+  case CaptureOp::Submit: {
+    auto commandBuffers = lookupAll(reader.getArray<VkCommandBuffer>());
+    for (auto commandBuffer : commandBuffers) {
+      pending.insert(commandBuffer);
+      auto it = executed.find(commandBuffer);
+      if (it != executed.end())
+        pending.insert(it->second.begin(), it->second.end());
+    }
+
+    auto submitInfo =
+        VkSubmitInfo{.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                     .pNext = nullptr,
+                     .waitSemaphoreCount = 0,
+                     .pWaitSemaphores = nullptr,
+                     .pWaitDstStageMask = nullptr,
+                     .commandBufferCount = (uint32_t)commandBuffers.size(),
+                     .pCommandBuffers = commandBuffers.data(),
+                     .signalSemaphoreCount = 0,
+                     .pSignalSemaphores = nullptr};
+    VK_CHECK(device->vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+    break;
+  }
+
+  case CaptureOp::BeginCommandBuffer:
+    beginCommandBuffer(reader);
+    break;
+
+  case CaptureOp::EndCommandBuffer:
+    VK_CHECK(device->vkEndCommandBuffer(lookup(reader.get<VkCommandBuffer>())));
+    break;
+
+  case CaptureOp::CmdBeginRenderPass: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto renderPass = lookup(reader.get<VkRenderPass>());
+    auto framebuffer = lookup(reader.get<VkFramebuffer>());
+    auto renderArea = reader.get<VkRect2D>();
+    auto contents = reader.get<VkSubpassContents>();
+    auto clearValues = reader.getArray<VkClearValue>();
+
+    auto beginInfo = VkRenderPassBeginInfo{
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .pNext = nullptr,
+        .renderPass = renderPass,
+        .framebuffer = framebuffer,
+        .renderArea = renderArea,
+        .clearValueCount = (uint32_t)clearValues.size(),
+        .pClearValues = clearValues.data()};
+    device->vkCmdBeginRenderPass(commandBuffer, &beginInfo, contents);
+    break;
+  }
+
+  case CaptureOp::CmdEndRenderPass:
+    device->vkCmdEndRenderPass(lookup(reader.get<VkCommandBuffer>()));
+    break;
+
+  case CaptureOp::CmdNextSubpass: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    device->vkCmdNextSubpass(commandBuffer,
+                             reader.get<VkSubpassContents>());
+    break;
+  }
+
+  case CaptureOp::CmdBeginRendering:
+    beginRendering(reader);
+    break;
+
+  case CaptureOp::CmdEndRendering:
+    device->vkCmdEndRendering(lookup(reader.get<VkCommandBuffer>()));
+    break;
+
+  case CaptureOp::CmdClearColorImage: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto image = lookup(reader.get<VkImage>());
+    auto layout = replayLayout(reader.get<VkImageLayout>());
+    auto color = reader.get<VkClearColorValue>();
+    auto ranges = reader.getArray<VkImageSubresourceRange>();
+    device->vkCmdClearColorImage(commandBuffer, image, layout, &color,
+                                 (uint32_t)ranges.size(), ranges.data());
+    break;
+  }
+
+  case CaptureOp::CmdBindPipeline: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto bindPoint = reader.get<VkPipelineBindPoint>();
+    auto pipeline = lookup(reader.get<VkPipeline>());
+    device->vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
+    break;
+  }
+
+  case CaptureOp::CmdSetViewport: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto firstViewport = reader.get<uint32_t>();
+    auto viewports = reader.getArray<VkViewport>();
+    device->vkCmdSetViewport(commandBuffer, firstViewport,
+                             (uint32_t)viewports.size(), viewports.data());
+    break;
+  }
+
+  case CaptureOp::CmdSetScissor: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto firstScissor = reader.get<uint32_t>();
+    auto scissors = reader.getArray<VkRect2D>();
+    device->vkCmdSetScissor(commandBuffer, firstScissor,
+                            (uint32_t)scissors.size(), scissors.data());
+    break;
+  }
+
+  case CaptureOp::CmdPipelineBarrier:
+    pipelineBarrier(reader);
+    break;
+
+  case CaptureOp::CmdPipelineBarrier2:
+    pipelineBarrier2(reader);
+    break;
+
+  case CaptureOp::CmdBindVertexBuffers: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto firstBinding = reader.get<uint32_t>();
+    auto buffers = lookupAll(reader.getArray<VkBuffer>());
+    auto offsets = reader.getArray<VkDeviceSize>();
+    device->vkCmdBindVertexBuffers(commandBuffer, firstBinding,
+                                   (uint32_t)buffers.size(), buffers.data(),
+                                   offsets.data());
+    break;
+  }
+
+  case CaptureOp::CmdBindIndexBuffer: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto buffer = lookup(reader.get<VkBuffer>());
+    auto offset = reader.get<VkDeviceSize>();
+    auto indexType = reader.get<VkIndexType>();
+    device->vkCmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
+    break;
+  }
+
+  case CaptureOp::CmdBindDescriptorSets: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto bindPoint = reader.get<VkPipelineBindPoint>();
+    auto layout = lookup(reader.get<VkPipelineLayout>());
+    auto firstSet = reader.get<uint32_t>();
+    auto sets = lookupAll(reader.getArray<VkDescriptorSet>());
+    auto dynamicOffsets = reader.getArray<uint32_t>();
+    device->vkCmdBindDescriptorSets(
+        commandBuffer, bindPoint, layout, firstSet, (uint32_t)sets.size(),
+        sets.data(), (uint32_t)dynamicOffsets.size(), dynamicOffsets.data());
+    break;
+  }
+
+  case CaptureOp::CmdPushConstants: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto layout = lookup(reader.get<VkPipelineLayout>());
+    auto stageFlags = reader.get<VkShaderStageFlags>();
+    auto offset = reader.get<uint32_t>();
+    auto values = reader.getArray<char>();
+    device->vkCmdPushConstants(commandBuffer, layout, stageFlags, offset,
+                               (uint32_t)values.size(), values.data());
+    break;
+  }
+
+  case CaptureOp::CmdCopyBuffer: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto srcBuffer = lookup(reader.get<VkBuffer>());
+    auto dstBuffer = lookup(reader.get<VkBuffer>());
+    auto regions = reader.getArray<VkBufferCopy>();
+    device->vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer,
+                            (uint32_t)regions.size(), regions.data());
+    break;
+  }
+
+  case CaptureOp::CmdCopyBufferToImage: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto srcBuffer = lookup(reader.get<VkBuffer>());
+    auto dstImage = lookup(reader.get<VkImage>());
+    auto dstImageLayout = replayLayout(reader.get<VkImageLayout>());
+    auto regions = reader.getArray<VkBufferImageCopy>();
+    device->vkCmdCopyBufferToImage(commandBuffer, srcBuffer, dstImage,
+                                   dstImageLayout, (uint32_t)regions.size(),
+                                   regions.data());
+    break;
+  }
+
+  case CaptureOp::CmdCopyImageToBuffer: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto srcImage = lookup(reader.get<VkImage>());
+    auto srcImageLayout = replayLayout(reader.get<VkImageLayout>());
+    auto dstBuffer = lookup(reader.get<VkBuffer>());
+    auto regions = reader.getArray<VkBufferImageCopy>();
+    device->vkCmdCopyImageToBuffer(commandBuffer, srcImage, srcImageLayout,
+                                   dstBuffer, (uint32_t)regions.size(),
+                                   regions.data());
+    break;
+  }
+
+  case CaptureOp::CmdBlitImage: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto srcImage = lookup(reader.get<VkImage>());
+    auto srcImageLayout = replayLayout(reader.get<VkImageLayout>());
+    auto dstImage = lookup(reader.get<VkImage>());
+    auto dstImageLayout = replayLayout(reader.get<VkImageLayout>());
+    auto filter = reader.get<VkFilter>();
+    auto regions = reader.getArray<VkImageBlit>();
+    device->vkCmdBlitImage(commandBuffer, srcImage, srcImageLayout, dstImage,
+                           dstImageLayout, (uint32_t)regions.size(),
+                           regions.data(), filter);
+    break;
+  }
+
+  case CaptureOp::CmdDraw: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto vertexCount = reader.get<uint32_t>();
+    auto instanceCount = reader.get<uint32_t>();
+    auto firstVertex = reader.get<uint32_t>();
+    auto firstInstance = reader.get<uint32_t>();
+    device->vkCmdDraw(commandBuffer, vertexCount, instanceCount, firstVertex,
+                      firstInstance);
+    break;
+  }
+
+  case CaptureOp::CmdDrawIndexed: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto indexCount = reader.get<uint32_t>();
+    auto instanceCount = reader.get<uint32_t>();
+    auto firstIndex = reader.get<uint32_t>();
+    auto vertexOffset = reader.get<int32_t>();
+    auto firstInstance = reader.get<uint32_t>();
+    device->vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount,
+                             firstIndex, vertexOffset, firstInstance);
+    break;
+  }
+
+  case CaptureOp::CmdDrawIndirect:
+  case CaptureOp::CmdDrawIndexedIndirect: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto buffer = lookup(reader.get<VkBuffer>());
+    auto offset = reader.get<VkDeviceSize>();
+    auto drawCount = reader.get<uint32_t>();
+    auto stride = reader.get<uint32_t>();
+    if (op == CaptureOp::CmdDrawIndirect)
+      device->vkCmdDrawIndirect(commandBuffer, buffer, offset, drawCount,
+                                stride);
+    else
+      device->vkCmdDrawIndexedIndirect(commandBuffer, buffer, offset,
+                                       drawCount, stride);
+    break;
+  }
+
+  case CaptureOp::CmdDrawIndexedIndirectCount: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto buffer = lookup(reader.get<VkBuffer>());
+    auto offset = reader.get<VkDeviceSize>();
+    auto countBuffer = lookup(reader.get<VkBuffer>());
+    auto countBufferOffset = reader.get<VkDeviceSize>();
+    auto maxDrawCount = reader.get<uint32_t>();
+    auto stride = reader.get<uint32_t>();
+    device->vkCmdDrawIndexedIndirectCount(commandBuffer, buffer, offset,
+                                          countBuffer, countBufferOffset,
+                                          maxDrawCount, stride);
+    break;
+  }
+
+  // Without VK_EXT_multi_draw the draws are issued one by one.
+  case CaptureOp::CmdDrawMulti: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto instanceCount = reader.get<uint32_t>();
+    auto firstInstance = reader.get<uint32_t>();
+    auto draws = reader.getArray<VkMultiDrawInfoEXT>();
+    if (device->vkCmdDrawMultiEXT) {
+      device->vkCmdDrawMultiEXT(commandBuffer, (uint32_t)draws.size(),
+                                draws.data(), instanceCount, firstInstance,
+                                sizeof(VkMultiDrawInfoEXT));
+      break;
+    }
+    for (auto const &draw : draws)
+      device->vkCmdDraw(commandBuffer, draw.vertexCount, instanceCount,
+                        draw.firstVertex, firstInstance);
+    break;
+  }
+
+  case CaptureOp::CmdDrawMultiIndexed: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto instanceCount = reader.get<uint32_t>();
+    auto firstInstance = reader.get<uint32_t>();
+    auto vertexOffset = reader.getOptional<int32_t>();
+    auto draws = reader.getArray<VkMultiDrawIndexedInfoEXT>();
+    if (device->vkCmdDrawMultiIndexedEXT) {
+      device->vkCmdDrawMultiIndexedEXT(
+          commandBuffer, (uint32_t)draws.size(), draws.data(), instanceCount,
+          firstInstance, sizeof(VkMultiDrawIndexedInfoEXT),
+          vertexOffset ? &*vertexOffset : nullptr);
+      break;
+    }
+    for (auto const &draw : draws)
+      device->vkCmdDrawIndexed(commandBuffer, draw.indexCount, instanceCount,
+                               draw.firstIndex,
+                               vertexOffset ? *vertexOffset
+                                            : draw.vertexOffset,
+                               firstInstance);
+    break;
+  }
+
+  case CaptureOp::CmdDispatch: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto groupCountX = reader.get<uint32_t>();
+    auto groupCountY = reader.get<uint32_t>();
+    auto groupCountZ = reader.get<uint32_t>();
+    device->vkCmdDispatch(commandBuffer, groupCountX, groupCountY,
+                          groupCountZ);
+    break;
+  }
+
+  case CaptureOp::CmdExecuteCommands: {
+    auto commandBuffer = lookup(reader.get<VkCommandBuffer>());
+    auto secondaries = lookupAll(reader.getArray<VkCommandBuffer>());
+    device->vkCmdExecuteCommands(commandBuffer, (uint32_t)secondaries.size(),
+                                 secondaries.data());
+    auto &list = executed[commandBuffer];
+    list.insert(list.end(), secondaries.begin(), secondaries.end());
+    break;
+  }
+
+  default:
+    // Records from newer captures are skipped by size.
+    break;
+  }
+}
+
+static bool hasExtension(std::vector<VkExtensionProperties> const &extensions,
+                         char const *name) {
+  return std::any_of(extensions.begin(), extensions.end(),
+                     [&](VkExtensionProperties const &extension) -> bool {
+                       return std::strcmp(extension.extensionName, name) == 0;
+                     });
+}
+
+// Enables what the capture used, as far as the replay device supports it.
+static std::shared_ptr<Device>
+createDevice(std::shared_ptr<Loader> loader, Instance &instance,
+             PhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+             Reader &reader) {
+  auto features = reader.get<VkPhysicalDeviceFeatures>();
+  auto captured = reader.get<DeviceExtendedFeatures>();
+  auto enabled = (VkBool32 *)&features;
+  auto supported = (VkBool32 const *)&physicalDevice.features;
+  for (size_t index = 0;
+       index < sizeof(VkPhysicalDeviceFeatures) / sizeof(VkBool32); ++index)
+    enabled[index] = enabled[index] && supported[index];
+
+  auto enumerateExtensions =
+      (PFN_vkEnumerateDeviceExtensionProperties)loader->vkGetInstanceProcAddr(
+          instance, "vkEnumerateDeviceExtensionProperties");
+  uint32_t extensionCount = 0;
+  VK_CHECK(enumerateExtensions(physicalDevice, nullptr, &extensionCount,
+                               nullptr));
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  VK_CHECK(enumerateExtensions(physicalDevice, nullptr, &extensionCount,
+                               extensions.data()));
+
+  auto apiVersion = physicalDevice.properties.apiVersion;
+  if (captured.drawIndirectCount && apiVersion < VK_API_VERSION_1_2)
+    throw std::runtime_error("capture needs drawIndirectCount");
+  if (captured.dynamicRendering && apiVersion < VK_API_VERSION_1_3)
+    throw std::runtime_error("capture needs dynamicRendering");
+  if (captured.synchronization2 && apiVersion < VK_API_VERSION_1_3)
+    throw std::runtime_error("capture needs synchronization2");
+
+  DeviceCreateInfo createInfo = {
+      .queueCreateInfos = {{.queueFamilyIndex = queueFamilyIndex,
+                            .queuePriorities = {1.0f}}},
+      .enabledFeatures = features,
+      .enabledExtendedFeatures = {
+          .drawIndirectCount = captured.drawIndirectCount,
+          .dynamicRendering = captured.dynamicRendering,
+          .synchronization2 = captured.synchronization2}};
+  if (captured.multiDraw &&
+      hasExtension(extensions, VK_EXT_MULTI_DRAW_EXTENSION_NAME)) {
+    createInfo.enabledExtensions.push_back(VK_EXT_MULTI_DRAW_EXTENSION_NAME);
+    createInfo.enabledExtendedFeatures.multiDraw = true;
+  }
+
+  return std::make_shared<Device>(loader, physicalDevice, createInfo);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::fprintf(stderr, "usage: %s <capture file> [device index]\n",
+                 argv[0]);
+    return 1;
+  }
+
+  std::ifstream file(argv[1], std::ios::binary);
+  std::vector<char> bytes{std::istreambuf_iterator<char>(file),
+                          std::istreambuf_iterator<char>()};
+  Reader header(bytes.data(), bytes.size());
+  if (bytes.size() < 2 * sizeof(uint32_t) ||
+      header.get<uint32_t>() != captureMagic ||
+      header.get<uint32_t>() != captureVersion) {
+    std::fprintf(stderr, "%s is not a vkt capture\n", argv[1]);
+    return 1;
+  }
+
+  auto loader = std::make_shared<Loader>(vkGetInstanceProcAddr);
+  Instance instance(
+      loader,
+      ApplicationInfo{.apiVersion = {.major = 1, .minor = 3},
+                      .appName = "replay",
+                      .engineName = "vkt"},
+      InstanceCreateInfo{}, std::nullopt);
+
+  auto physicalDevices = instance.listPhysicalDevices();
+  auto deviceIndex = argc > 2 ? (size_t)std::stoul(argv[2]) : 0;
+  if (deviceIndex >= physicalDevices.size()) {
+    std::fprintf(stderr, "no physical device %zu\n", deviceIndex);
+    return 1;
+  }
+  auto physicalDevice = physicalDevices[deviceIndex];
+  std::printf("replaying on %s\n", physicalDevice.properties.deviceName);
+
+  uint32_t queueFamilyIndex = 0;
+  auto required = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+  while (queueFamilyIndex < physicalDevice.queueFamilies.size() &&
+         (physicalDevice.queueFamilies[queueFamilyIndex].queueFlags &
+          required) != required)
+    ++queueFamilyIndex;
+  if (queueFamilyIndex == physicalDevice.queueFamilies.size()) {
+    std::fprintf(stderr, "no graphics and compute queue\n");
+    return 1;
+  }
+
+  std::shared_ptr<Device> device;
+  std::optional<Replayer> replayer;
+  auto const *data = bytes.data() + 2 * sizeof(uint32_t);
+  auto const *end = bytes.data() + bytes.size();
+  while (data < end) {
+    Reader record(data, end - data);
+    auto op = record.get<CaptureOp>();
+    auto size = record.get<uint32_t>();
+    data += 2 * sizeof(uint32_t);
+    if ((size_t)(end - data) < size)
+      throw std::runtime_error("truncated capture");
+    Reader payload(data, size);
+    data += size;
+
+    if (op == CaptureOp::Device && !device) {
+      device = createDevice(loader, instance, physicalDevice,
+                            queueFamilyIndex, payload);
+      replayer.emplace(device, queueFamilyIndex);
+      continue;
+    }
+    if (!replayer)
+      throw std::runtime_error("capture does not start with a device");
+    replayer->replay(op, payload);
+  }
+
+  if (replayer)
+    replayer->finish();
+  return 0;
+}
@@ -0,0 +1,137 @@
+#include <vkext/image_writer.h>
+#include <stb_image_write.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+static float halfToFloat(uint16_t h) {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exponent = (h >> 10) & 0x1f;
+  uint32_t mantissa = h & 0x3ff;
+
+  uint32_t bits;
+  if (exponent == 0x1f) {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {
+    // Subnormal half; renormalise into a float.
+    exponent = 113;
+    while ((mantissa & 0x400) == 0) {
+      mantissa <<= 1;
+      --exponent;
+    }
+    bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+  }
+  return std::bit_cast<float>(bits);
+}
+
+static uint8_t quantize(float value) {
+  return (uint8_t)(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+template <typename T> static T load(std::byte const *src, size_t index) {
+  T value;
+  std::memcpy(&value, src + index * sizeof(T), sizeof(T));
+  return value;
+}
+
+namespace vkext {
+std::vector<uint8_t> toRgba8(VkFormat format, VkExtent3D extent,
+                             std::span<std::byte const> data) {
+  auto count = (size_t)extent.width * extent.height * extent.depth;
+  std::vector<uint8_t> rgba(count * 4);
+  auto *src = data.data();
+  auto *dst = rgba.data();
+
+  auto floats = [&](uint32_t channels, auto read) {
+    for (size_t i = 0; i < count; ++i) {
+      float texel[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+      for (uint32_t c = 0; c < channels; ++c)
+        texel[c] = read(i * channels + c);
+      if (channels == 1)
+        texel[1] = texel[2] = texel[0];
+      for (uint32_t c = 0; c < 4; ++c)
+        dst[i * 4 + c] = quantize(texel[c]);
+    }
+  };
+
+  switch (format) {
+  case VK_FORMAT_R8G8B8A8_UNORM:
+  case VK_FORMAT_R8G8B8A8_SRGB:
+    std::memcpy(dst, src, count * 4);
+    break;
+  case VK_FORMAT_B8G8R8A8_UNORM:
+  case VK_FORMAT_B8G8R8A8_SRGB:
+    for (size_t i = 0; i < count; ++i) {
+      dst[i * 4 + 0] = (uint8_t)src[i * 4 + 2];
+      dst[i * 4 + 1] = (uint8_t)src[i * 4 + 1];
+      dst[i * 4 + 2] = (uint8_t)src[i * 4 + 0];
+      dst[i * 4 + 3] = (uint8_t)src[i * 4 + 3];
+    }
+    break;
+  case VK_FORMAT_R8G8B8_UNORM:
+  case VK_FORMAT_R8G8B8_SRGB:
+    for (size_t i = 0; i < count; ++i) {
+      std::memcpy(dst + i * 4, src + i * 3, 3);
+      dst[i * 4 + 3] = 255;
+    }
+    break;
+  case VK_FORMAT_R8_UNORM:
+    for (size_t i = 0; i < count; ++i) {
+      dst[i * 4 + 0] = dst[i * 4 + 1] = dst[i * 4 + 2] = (uint8_t)src[i];
+      dst[i * 4 + 3] = 255;
+    }
+    break;
+  case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+    for (size_t i = 0; i < count; ++i) {
+      auto texel = load<uint32_t>(src, i);
+      dst[i * 4 + 0] = (uint8_t)((texel & 0x3ff) >> 2);
+      dst[i * 4 + 1] = (uint8_t)(((texel >> 10) & 0x3ff) >> 2);
+      dst[i * 4 + 2] = (uint8_t)(((texel >> 20) & 0x3ff) >> 2);
+      dst[i * 4 + 3] = (uint8_t)((texel >> 30) * 85);
+    }
+    break;
+  case VK_FORMAT_R16G16B16A16_UNORM:
+    for (size_t i = 0; i < count * 4; ++i)
+      dst[i] = (uint8_t)(load<uint16_t>(src, i) >> 8);
+    break;
+  case VK_FORMAT_R16G16B16A16_SFLOAT:
+    floats(4, [&](size_t i) { return halfToFloat(load<uint16_t>(src, i)); });
+    break;
+  case VK_FORMAT_R32_SFLOAT:
+  case VK_FORMAT_D32_SFLOAT:
+    floats(1, [&](size_t i) { return load<float>(src, i); });
+    break;
+  case VK_FORMAT_R32G32B32_SFLOAT:
+    floats(3, [&](size_t i) { return load<float>(src, i); });
+    break;
+  case VK_FORMAT_R32G32B32A32_SFLOAT:
+    floats(4, [&](size_t i) { return load<float>(src, i); });
+    break;
+  default:
+    throw std::runtime_error("unsupported format for RGBA8 conversion");
+  }
+
+  return rgba;
+}
+
+void writePng(std::filesystem::path const &path, uint32_t width,
+              uint32_t height, std::span<uint8_t const> rgba) {
+  if (!stbi_write_png(path.string().c_str(), (int)width, (int)height, 4,
+                      rgba.data(), (int)width * 4))
+    throw std::runtime_error("failed to write " + path.string());
+}
+
+void writeRaw(std::filesystem::path const &path,
+              std::span<std::byte const> data) {
+  std::ofstream os(path, std::ios::binary);
+  if (!os)
+    throw std::runtime_error("failed to open " + path.string());
+  os.write((char const *)data.data(), (std::streamsize)data.size());
+}
+}
\ No newline at end of file
@@ -0,0 +1,329 @@
+#include <vkext/texture_loader.h>
+#include <vkext/stb_image.h>
+#include <algorithm>
+
+static constexpr uint32_t texelSize = 4;
+
+// 2x2 box filter over RGBA8 texels; odd edges reuse the last row or column.
+static std::vector<stbi_uc> halve(stbi_uc const *src, uint32_t &width,
+                                  uint32_t &height) {
+  auto dstWidth = std::max(width / 2, 1u);
+  auto dstHeight = std::max(height / 2, 1u);
+  std::vector<stbi_uc> dst((size_t)dstWidth * dstHeight * texelSize);
+
+  for (uint32_t y = 0; y < dstHeight; ++y) {
+    auto y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+    for (uint32_t x = 0; x < dstWidth; ++x) {
+      auto x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+      for (uint32_t c = 0; c < texelSize; ++c) {
+        auto at = [&](uint32_t sx, uint32_t sy) {
+          return (uint32_t)src[((size_t)sy * width + sx) * texelSize + c];
+        };
+        auto sum = at(x0, y0) + at(x1, y0) + at(x0, y1) + at(x1, y1);
+        dst[((size_t)y * dstWidth + x) * texelSize + c] = (stbi_uc)(sum / 4);
+      }
+    }
+  }
+
+  width = dstWidth;
+  height = dstHeight;
+  return dst;
+}
+
+namespace vkext {
+Texture::Texture(std::filesystem::path path) : path(std::move(path)) {}
+
+std::shared_ptr<Image> Texture::getImage() const {
+  std::lock_guard<std::mutex> guard(mutex);
+  return image;
+}
+
+std::shared_ptr<ImageView> Texture::getView() const {
+  std::lock_guard<std::mutex> guard(mutex);
+  return view;
+}
+
+TextureState Texture::getState() const {
+  std::lock_guard<std::mutex> guard(mutex);
+  return state;
+}
+
+uint32_t Texture::getGeneration() const {
+  std::lock_guard<std::mutex> guard(mutex);
+  return generation;
+}
+
+bool Texture::update(UploadContext &uploadContext, UploadToken acquired,
+                     bool needsAcquire) {
+  std::lock_guard<std::mutex> guard(mutex);
+
+  auto completed = pending.end();
+  for (auto it = pending.begin(); it != pending.end(); ++it)
+    if (uploadContext.isComplete(it->token) &&
+        (!needsAcquire || it->token.batch <= acquired.batch))
+      completed = it;
+  if (completed == pending.end())
+    return false;
+
+  image = completed->image;
+  view = completed->view;
+  if (state != TextureState::Failed)
+    state = completed->state;
+  ++generation;
+  // Older versions are superseded even if their uploads or acquires are
+  // still running; the upload batch and OwnershipAcquire::keepAlive hold
+  // their images until those complete.
+  pending.erase(pending.begin(), completed + 1);
+  return true;
+}
+
+TextureLoader::TextureLoader(std::shared_ptr<Device> device,
+                             std::shared_ptr<UploadContext> uploadContext,
+                             TextureLoaderCreateInfo const &createInfo)
+    : device{device}, uploadContext{uploadContext}, createInfo{createInfo} {
+  if (createInfo.generateMips && !uploadContext->canGenerateMips())
+    throw std::runtime_error("generateMips needs an UploadContext with a "
+                             "MipGenerator");
+
+  auto workerCount = createInfo.workerCount;
+  if (workerCount == 0)
+    workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+  for (uint32_t i = 0; i < workerCount; ++i)
+    workers.emplace_back([this]() { work(); });
+}
+
+TextureLoader::~TextureLoader() {
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    stopping = true;
+    jobs.clear();
+  }
+  jobReady.notify_all();
+  budgetFreed.notify_all();
+  workers.clear();
+}
+
+std::shared_ptr<Texture>
+TextureLoader::load(std::filesystem::path const &path) {
+  auto texture = std::make_shared<Texture>(path);
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    jobs.push_back(texture);
+    loading.push_back(texture);
+  }
+  jobReady.notify_one();
+  return texture;
+}
+
+OwnershipAcquire
+TextureLoader::acquireOwnership(CommandBufferRecording &recording) {
+  auto acquire = uploadContext->acquireOwnership(recording);
+  std::lock_guard<std::mutex> guard(mutex);
+  acquired.batch = std::max(acquired.batch, acquire.token.batch);
+  return acquire;
+}
+
+uint32_t TextureLoader::poll() {
+  std::vector<std::shared_ptr<Texture>> textures;
+  UploadToken acquired;
+  {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (std::exchange(uploadsSinceFlush, false))
+      uploadContext->flush();
+    textures = loading;
+    acquired = this->acquired;
+  }
+
+  auto needsAcquire = uploadContext->needsTransfer(createInfo.sharingMode);
+  uint32_t changed = 0;
+  for (auto &texture : textures)
+    if (texture->update(*uploadContext, acquired, needsAcquire))
+      ++changed;
+
+  std::lock_guard<std::mutex> guard(mutex);
+  std::erase_if(loading, [](auto const &texture) {
+    std::lock_guard<std::mutex> textureGuard(texture->mutex);
+    return texture->pending.empty() &&
+           texture->state != TextureState::Queued &&
+           texture->state != TextureState::Placeholder;
+  });
+  return changed;
+}
+
+void TextureLoader::waitIdle() {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobsDone.wait(lock, [&]() { return jobs.empty() && jobsRunning == 0; });
+  }
+  poll();
+  uploadContext->waitIdle();
+  poll();
+}
+
+void TextureLoader::work() {
+  while (true) {
+    std::shared_ptr<Texture> texture;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      jobReady.wait(lock, [&]() { return stopping || !jobs.empty(); });
+      if (stopping)
+        return;
+      texture = jobs.front();
+      jobs.pop_front();
+      ++jobsRunning;
+    }
+
+    decode(*texture);
+
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      --jobsRunning;
+    }
+    jobsDone.notify_all();
+  }
+}
+
+void TextureLoader::decode(Texture &texture) {
+  auto fail = [&]() {
+    std::lock_guard<std::mutex> guard(texture.mutex);
+    texture.state = TextureState::Failed;
+  };
+
+  int width, height, channels;
+  if (!stbi_info(texture.path.c_str(), &width, &height, &channels))
+    return fail();
+
+  // Reserve the decoded size up front so that decodes wait on the budget
+  // instead of overshooting it.
+  auto bytes = (size_t)width * height * texelSize;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    budgetFreed.wait(lock, [&]() {
+      return stopping || bytesInFlight == 0 ||
+             bytesInFlight + bytes <= createInfo.maxBytesInFlight;
+    });
+    if (stopping)
+      return;
+    bytesInFlight += bytes;
+  }
+
+  auto release = [&]() {
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      bytesInFlight -= bytes;
+      uploadsSinceFlush = true;
+    }
+    budgetFreed.notify_all();
+  };
+
+  try {
+    auto decoded = StbImage(texture.path, STBI_rgb_alpha);
+    if (decoded.data == nullptr)
+      throw std::runtime_error("failed to decode image");
+
+    auto fullWidth = (uint32_t)decoded.width;
+    auto fullHeight = (uint32_t)decoded.height;
+
+    if (createInfo.placeholderSize != 0 &&
+        std::max(fullWidth, fullHeight) > createInfo.placeholderSize) {
+      auto w = fullWidth, h = fullHeight;
+      auto texels = halve(decoded.data, w, h);
+      while (std::max(w, h) > createInfo.placeholderSize)
+        texels = halve(texels.data(), w, h);
+
+      auto version = upload(texels.data(), w, h, true);
+      std::lock_guard<std::mutex> guard(texture.mutex);
+      texture.pending.push_back(std::move(version));
+    }
+
+    auto version = upload(decoded.data, fullWidth, fullHeight, false);
+    {
+      std::lock_guard<std::mutex> guard(texture.mutex);
+      texture.pending.push_back(std::move(version));
+    }
+  } catch (...) {
+    release();
+    return fail();
+  }
+  release();
+}
+
+Texture::Version TextureLoader::upload(void const *texels, uint32_t width,
+                                       uint32_t height, bool placeholder) {
+  auto extent = VkExtent3D{.width = width, .height = height, .depth = 1};
+  auto generateMips = createInfo.generateMips && !placeholder;
+  auto mipLevels = generateMips ? Image::mipChainLength(extent) : 1;
+
+  auto usage = createInfo.usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  if (mipLevels > 1)
+    usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+  auto imageCreateInfo =
+      ImageCreateInfo{.imageType = VK_IMAGE_TYPE_2D,
+                      .format = createInfo.format,
+                      .extent = extent,
+                      .mipLevels = mipLevels,
+                      .arrayLayers = 1,
+                      .samples = VK_SAMPLE_COUNT_1_BIT,
+                      .tiling = VK_IMAGE_TILING_OPTIMAL,
+                      .usage = usage,
+                      .sharingMode = createInfo.sharingMode,
+                      .queueFamilyIndices = createInfo.queueFamilyIndices,
+                      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+
+  // Mip generation needs the GPU, so only single-level images are written
+  // by the host.
+  auto hostCopy =
+      !generateMips &&
+      Image::supportsHostCopy(*device, imageCreateInfo, createInfo.dstLayout);
+  if (hostCopy)
+    imageCreateInfo.usage |= VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+
+  auto image = std::make_shared<Image>(device, imageCreateInfo);
+  image->allocMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  auto view = std::make_shared<ImageView>(
+      device,
+      ImageViewCreateInfo{
+          .image = *image,
+          .viewType = VK_IMAGE_VIEW_TYPE_2D,
+          .format = createInfo.format,
+          .components = {},
+          .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                               .baseMipLevel = 0,
+                               .levelCount = mipLevels,
+                               .baseArrayLayer = 0,
+                               .layerCount = 1}});
+
+  // A default token is always complete.
+  auto token = UploadToken{};
+  if (hostCopy) {
+    image->hostCopy(texels, createInfo.dstLayout);
+  } else {
+    // Whether or not the upload throws, a batch may already refer to the
+    // image, so it is kept until that batch retires.
+    try {
+      token = uploadContext->upload(
+          image, texels, (VkDeviceSize)width * height * texelSize,
+          ImageUploadInfo{.dstStageMask = createInfo.dstStageMask,
+                          .dstAccessMask = createInfo.dstAccessMask,
+                          .dstLayout = createInfo.dstLayout,
+                          .generateMips = generateMips});
+    } catch (...) {
+      uploadContext->keepAlive(image);
+      uploadContext->keepAlive(view);
+      throw;
+    }
+    uploadContext->keepAlive(image);
+    uploadContext->keepAlive(view);
+  }
+
+  return Texture::Version{
+      .image = image,
+      .view = view,
+      .token = token,
+      .state = placeholder ? TextureState::Placeholder
+                           : TextureState::Resident};
+}
+}
\ No newline at end of file
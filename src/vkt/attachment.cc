@@ -0,0 +1,127 @@
+#include <vkt/attachment.h>
+#include <algorithm>
+
+Attachment::Attachment(std::shared_ptr<Device> device,
+                       AttachmentCreateInfo const &createInfo) {
+  this->device = device;
+  this->createInfo = createInfo;
+
+  if (this->createInfo.format == VK_FORMAT_UNDEFINED) {
+    auto format = device->physDev.findDepthFormat(createInfo.stencil);
+    if (!format.has_value())
+      throw std::runtime_error("no supported depth format");
+    this->createInfo.format = *format;
+  }
+
+  auto attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                         VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+  if (createInfo.usage & ~attachmentUsage)
+    this->createInfo.transient = false;
+
+  create();
+}
+
+Attachment::operator VkImageView() {
+  return *view;
+}
+
+std::shared_ptr<Image> Attachment::getImage() const {
+  return image;
+}
+
+std::shared_ptr<ImageView> Attachment::getView() const {
+  return view;
+}
+
+VkFormat Attachment::getFormat() const {
+  return createInfo.format;
+}
+
+VkImageAspectFlags Attachment::getAspects() const {
+  return formatAspects(createInfo.format);
+}
+
+bool Attachment::isTransient() const {
+  return createInfo.transient;
+}
+
+bool Attachment::resize(VkExtent2D extent) {
+  if (extent.width <= createInfo.extent.width &&
+      extent.height <= createInfo.extent.height)
+    return false;
+
+  createInfo.extent.width = std::max(extent.width, createInfo.extent.width);
+  createInfo.extent.height = std::max(extent.height, createInfo.extent.height);
+  create();
+  return true;
+}
+
+VkAttachmentDescription
+Attachment::description(VkAttachmentLoadOp loadOp, VkImageLayout finalLayout,
+                        VkImageLayout initialLayout) const {
+  auto storeOp = createInfo.transient ? VK_ATTACHMENT_STORE_OP_DONT_CARE
+                                      : VK_ATTACHMENT_STORE_OP_STORE;
+  auto hasStencil = (getAspects() & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+
+  return VkAttachmentDescription{
+      .flags = {},
+      .format = createInfo.format,
+      .samples = createInfo.samples,
+      .loadOp = loadOp,
+      .storeOp = storeOp,
+      .stencilLoadOp = hasStencil ? loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+      .stencilStoreOp = hasStencil ? storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+      .initialLayout = initialLayout,
+      .finalLayout = finalLayout};
+}
+
+void Attachment::create() {
+  auto usage = createInfo.usage;
+  if (createInfo.transient)
+    usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+  // Release the old image first so that its memory can be reused.
+  view = nullptr;
+  image = nullptr;
+
+  image = std::make_shared<Image>(
+      device,
+      ImageCreateInfo{.flags = {},
+                      .imageType = VK_IMAGE_TYPE_2D,
+                      .format = createInfo.format,
+                      .extent = VkExtent3D{.width = createInfo.extent.width,
+                                           .height = createInfo.extent.height,
+                                           .depth = 1},
+                      .mipLevels = 1,
+                      .arrayLayers = 1,
+                      .samples = createInfo.samples,
+                      .tiling = VK_IMAGE_TILING_OPTIMAL,
+                      .usage = usage,
+                      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                      .queueFamilyIndices = {},
+                      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED});
+
+  // Lazily allocated memory is only committed if the tile contents spill,
+  // and the allocator gives it a dedicated allocation.
+  image->allocMemory(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                     createInfo.transient
+                         ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT
+                         : 0);
+
+  // Views of combined formats used as attachments cover both aspects.
+  view = std::make_shared<ImageView>(
+      device,
+      ImageViewCreateInfo{
+          .flags = {},
+          .image = *image,
+          .viewType = VK_IMAGE_VIEW_TYPE_2D,
+          .format = createInfo.format,
+          .components = {},
+          .subresourceRange =
+              VkImageSubresourceRange{.aspectMask = getAspects(),
+                                      .baseMipLevel = 0,
+                                      .levelCount = 1,
+                                      .baseArrayLayer = 0,
+                                      .layerCount = 1}});
+}
@@ -1,7 +1,6 @@
 #include <vkt/buffer.h>
-#include <vkt/command_buffer.h>
+#include <vkt/upload_context.h>
 #include <vkt/device_memory.h>
-#include <cstring>
 
 Buffer::Buffer(std::shared_ptr<Device> device,
                BufferCreateInfo const &createInfo) {
@@ -11,13 +10,19 @@ Buffer::Buffer(std::shared_ptr<Device> device,
   for (auto const &queueFamilyIndex : createInfo.queueFamilyIndices)
     queueFamilyIndices.push_back(queueFamilyIndex);
 
-  auto sharingMode = createInfo.sharingMode;
+  sharingMode = createInfo.sharingMode;
   if (queueFamilyIndices.size() < 2)
     sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+  auto externalInfo = VkExternalMemoryBufferCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO,
+      .pNext = nullptr,
+      .handleTypes = createInfo.externalMemoryHandleTypes};
+
   VkBufferCreateInfo vk_createInfo = {
       .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-      .pNext = nullptr,
+      .pNext = createInfo.externalMemoryHandleTypes != 0 ? &externalInfo
+                                                         : nullptr,
       .flags = {},
       .size = createInfo.size,
       .usage = createInfo.usage,
@@ -36,10 +41,51 @@ Buffer::Buffer(std::shared_ptr<Device> device,
       device);
 }
 
+std::shared_ptr<Buffer> Buffer::importHostMemory(std::shared_ptr<Device> device,
+                                                 void const *data,
+                                                 VkDeviceSize size,
+                                                 VkBufferUsageFlags usage) {
+  auto alignment = device->getHostPointerAlignment();
+  if (alignment == 0 || size == 0 || (uintptr_t)data % alignment != 0 ||
+      size % alignment != 0)
+    return nullptr;
+
+  auto memoryTypeBits = device->getHostPointerMemoryTypeBits(data);
+  if (memoryTypeBits == 0)
+    return nullptr;
+
+  auto buffer = std::make_shared<Buffer>(
+      device,
+      BufferCreateInfo{
+          .size = size,
+          .usage = usage,
+          .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+          .queueFamilyIndices = {},
+          .externalMemoryHandleTypes =
+              VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT});
+
+  auto requirements = buffer->getMemoryRequirements();
+  auto memoryTypeIndex = device->physDev.findMemoryTypeIndex(
+      requirements.memoryTypeBits & memoryTypeBits, 0);
+  if (!memoryTypeIndex.has_value() || requirements.size > size)
+    return nullptr;
+
+  auto memory = std::make_shared<DeviceMemory>(
+      device, MemoryAllocateInfo{.size = size,
+                                 .memoryTypeIndex = memoryTypeIndex.value(),
+                                 .importHostPointer = (void *)data});
+  buffer->bindMemory(memory);
+  return buffer;
+}
+
 Buffer::operator VkBuffer() {
   return buffer;
 }
 
+VkSharingMode Buffer::getSharingMode() const {
+  return sharingMode;
+}
+
 VkMemoryRequirements Buffer::getMemoryRequirements() {
   VkMemoryRequirements memRequirements = {};
   device->vkGetBufferMemoryRequirements(*device, buffer, &memRequirements);
@@ -47,64 +93,36 @@ VkMemoryRequirements Buffer::getMemoryRequirements() {
 }
 
 void Buffer::stage(const void *data, VkDeviceSize size, Queue &transferQueue) {
-  auto queueFamilyIndex = transferQueue.getQueueFamilyIndex();
-
-  auto staging = Buffer(device, {.size = size,
-                                 .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                 .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-                                 .queueFamilyIndices = {queueFamilyIndex}});
-
-  auto &stagingMemory =
-      staging.allocMemory(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-  {
-    auto stagingMemoryMap = stagingMemory.map();
-    std::memcpy(stagingMemoryMap.get(), data, size);
-  }
-
-  auto cmdPool = CommandPool(
-      device,
-      CommandPoolCreateInfo{.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
-                            .queueFamilyIndex = queueFamilyIndex});
-
-  auto copyCmdBuf = CommandBuffer(
-      device,
-      CommandBufferAllocateInfo{.commandPool = stack_ptr(cmdPool),
-                                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY});
-
-  {
-    auto rec = CommandBufferRecording(
-        stack_ptr(copyCmdBuf),
-        CommandBufferBeginInfo{
-            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT});
-
-    rec.copyBuffer(staging, buffer, {VkBufferCopy{.size = size}});
-  }
-
-  transferQueue.submit(QueueSubmitInfo{
-      .waitSemaphoresAndStages = {},
-      .commandBuffers = {copyCmdBuf},
-      .signalSemaphores = {},
-      .fence = VK_NULL_HANDLE,
-  });
-  transferQueue.wait();
+  auto uploadContext =
+      UploadContext(device, transferQueue,
+                    UploadContextCreateInfo{.stagingSize = size,
+                                            .chunkSize = size,
+                                            .maxBatchesInFlight = 1});
+  uploadContext.uploadFromHost(*this, data, size);
+  uploadContext.waitIdle();
 }
 
-DeviceMemory &Buffer::allocMemory(VkMemoryPropertyFlags properties) {
-  auto memoryReqs = getMemoryRequirements();
-  auto memoryTypeIndex = device->physDev.findMemoryTypeIndex(
-      memoryReqs.memoryTypeBits, properties);
-  auto memory = std::make_shared<DeviceMemory>(
-      device, MemoryAllocateInfo{.size = memoryReqs.size,
-                                 .memoryTypeIndex = memoryTypeIndex.value()});
-  VK_CHECK(device->vkBindBufferMemory(*device, buffer, *memory, 0));
-  this->memory = memory;
+MemoryAllocation &Buffer::allocMemory(VkMemoryPropertyFlags properties,
+                                      VkMemoryPropertyFlags preferred,
+                                      VkMemoryPropertyFlags avoided) {
+  auto memory = device->allocator->allocate(
+      MemoryAllocationCreateInfo{.requirements = getMemoryRequirements(),
+                                 .properties = properties,
+                                 .preferredProperties = preferred,
+                                 .avoidedProperties = avoided,
+                                 .linear = true});
+  bindMemory(memory);
   return *memory;
 }
 
+void Buffer::bindMemory(std::shared_ptr<MemoryAllocation> allocation) {
+  VK_CHECK(device->vkBindBufferMemory(*device, buffer, *allocation,
+                                      allocation->getOffset()));
+  this->memory = allocation;
+}
+
 void Buffer::bindMemory(std::shared_ptr<DeviceMemory> deviceMemory,
                         VkDeviceSize offset) {
-  VK_CHECK(device->vkBindBufferMemory(*device, buffer, *deviceMemory, 0));
-  this->memory = deviceMemory;
+  bindMemory(std::make_shared<MemoryAllocation>(
+      deviceMemory, offset, deviceMemory->getSize() - offset));
 }
\ No newline at end of file
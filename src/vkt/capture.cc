@@ -0,0 +1,1252 @@
+#include <vkt/capture.h>
+#include <vkt/device.h>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+static_assert(sizeof(VkCommandBuffer) == sizeof(uint64_t),
+              "capture files store handles as 64-bit ids");
+
+// Host memory is compared in blocks of this size; changed blocks next to
+// each other go out as one HostWrite.
+static constexpr size_t hostWriteBlockSize = 256;
+
+struct CaptureRecord {
+  std::vector<char> bytes;
+
+  void putBytes(void const *data, size_t size) {
+    auto begin = (char const *)data;
+    bytes.insert(bytes.end(), begin, begin + size);
+  }
+
+  template <typename T>
+  void put(T const &value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    putBytes(&value, sizeof(T));
+  }
+
+  template <typename T, typename... Rest>
+  void put(T const &value, Rest const &...rest) {
+    put(value);
+    put(rest...);
+  }
+
+  template <typename T>
+  void putArray(T const *values, uint32_t count) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    put(count);
+    if (count > 0)
+      putBytes(values, sizeof(T) * count);
+  }
+
+  template <typename T>
+  void putOptional(T const *value) {
+    put((uint8_t)(value != nullptr));
+    if (value)
+      put(*value);
+  }
+
+  void putString(char const *value) {
+    putArray(value, (uint32_t)std::strlen(value));
+  }
+};
+
+struct Capture::State {
+  DeviceDispatch real;
+  VkPhysicalDeviceMemoryProperties memoryProps;
+
+  std::mutex fileMutex;
+  std::ofstream file;
+
+  struct Mapping {
+    VkDeviceSize offset;
+    char const *data;
+    std::vector<char> shadow;
+    // Imported host memory has meaningful contents from the start.
+    bool writeAll;
+  };
+
+  struct Swapchain {
+    VkFormat format;
+    VkExtent2D extent;
+    uint32_t arrayLayers;
+    VkImageUsageFlags usage;
+    bool imagesCaptured = false;
+  };
+
+  std::mutex objectMutex;
+  std::map<VkDeviceMemory, VkDeviceSize> memorySizes;
+  std::map<VkDeviceMemory, Mapping> mappings;
+  std::map<VkImage, VkFormat> imageFormats;
+  std::map<VkSwapchainKHR, Swapchain> swapchains;
+
+  CaptureRecord &begin(CaptureOp op) {
+    thread_local CaptureRecord record;
+    record.bytes.clear();
+    record.put(op, (uint32_t)0);
+    return record;
+  }
+
+  void end(CaptureRecord &record) {
+    auto size = (uint32_t)(record.bytes.size() - 2 * sizeof(uint32_t));
+    std::memcpy(record.bytes.data() + sizeof(uint32_t), &size, sizeof(size));
+
+    std::lock_guard<std::mutex> guard(fileMutex);
+    file.write(record.bytes.data(), (std::streamsize)record.bytes.size());
+  }
+
+  void writeHostWrite(VkDeviceMemory memory, VkDeviceSize offset,
+                      char const *data, size_t size) {
+    auto &record = begin(CaptureOp::HostWrite);
+    record.put(memory, offset);
+    record.putArray(data, (uint32_t)size);
+    end(record);
+  }
+
+  void writeMapping(VkDeviceMemory memory, Mapping &mapping) {
+    auto size = mapping.shadow.size();
+    if (mapping.writeAll) {
+      writeHostWrite(memory, mapping.offset, mapping.data, size);
+      std::memcpy(mapping.shadow.data(), mapping.data, size);
+      mapping.writeAll = false;
+      return;
+    }
+
+    size_t runBegin = 0, runEnd = 0;
+    for (size_t block = 0; block < size; block += hostWriteBlockSize) {
+      auto blockSize = std::min(hostWriteBlockSize, size - block);
+      if (std::memcmp(mapping.data + block, mapping.shadow.data() + block,
+                      blockSize) == 0)
+        continue;
+
+      if (runEnd != block) {
+        if (runEnd > runBegin)
+          writeHostWrite(memory, mapping.offset + runBegin,
+                         mapping.data + runBegin, runEnd - runBegin);
+        runBegin = block;
+      }
+      std::memcpy(mapping.shadow.data() + block, mapping.data + block,
+                  blockSize);
+      runEnd = block + blockSize;
+    }
+    if (runEnd > runBegin)
+      writeHostWrite(memory, mapping.offset + runBegin,
+                     mapping.data + runBegin, runEnd - runBegin);
+  }
+
+  void writeHostMemory() {
+    std::lock_guard<std::mutex> guard(objectMutex);
+    for (auto &[memory, mapping] : mappings)
+      writeMapping(memory, mapping);
+  }
+
+  void trackMapping(VkDeviceMemory memory, VkDeviceSize offset,
+                    void const *data, VkDeviceSize size, bool writeAll) {
+    std::lock_guard<std::mutex> guard(objectMutex);
+    if (size == VK_WHOLE_SIZE)
+      size = memorySizes[memory] - offset;
+
+    auto &mapping = mappings[memory];
+    mapping.offset = offset;
+    mapping.data = (char const *)data;
+    mapping.shadow.assign(mapping.data, mapping.data + size);
+    mapping.writeAll = writeAll;
+  }
+
+  void untrackMapping(VkDeviceMemory memory, bool flush) {
+    std::lock_guard<std::mutex> guard(objectMutex);
+    auto it = mappings.find(memory);
+    if (it == mappings.end())
+      return;
+    if (flush)
+      writeMapping(memory, it->second);
+    mappings.erase(it);
+  }
+};
+
+static Capture::State *active = nullptr;
+
+static void putShaderStage(CaptureRecord &record,
+                           VkPipelineShaderStageCreateInfo const &stage) {
+  record.put(stage);
+  record.putString(stage.pName);
+  record.putOptional(stage.pSpecializationInfo);
+  if (auto const *spec = stage.pSpecializationInfo) {
+    record.putArray(spec->pMapEntries, spec->mapEntryCount);
+    record.putArray((char const *)spec->pData, (uint32_t)spec->dataSize);
+  }
+}
+
+static void const *findNext(void const *pNext, VkStructureType sType) {
+  for (auto next = (VkBaseInStructure const *)pNext; next;
+       next = next->pNext)
+    if (next->sType == sType)
+      return next;
+  return nullptr;
+}
+
+static VkResult VKAPI_CALL capture_vkAllocateMemory(
+    VkDevice device, VkMemoryAllocateInfo const *allocateInfo,
+    VkAllocationCallbacks const *allocator, VkDeviceMemory *memory) {
+  auto result =
+      active->real.vkAllocateMemory(device, allocateInfo, allocator, memory);
+  if (result != VK_SUCCESS)
+    return result;
+
+  auto const *import = (VkImportMemoryHostPointerInfoEXT const *)findNext(
+      allocateInfo->pNext,
+      VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT);
+
+  auto propertyFlags =
+      active->memoryProps.memoryTypes[allocateInfo->memoryTypeIndex]
+          .propertyFlags;
+  if (import)
+    propertyFlags |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+  auto &record = active->begin(CaptureOp::AllocateMemory);
+  record.put(*memory, allocateInfo->allocationSize, propertyFlags);
+  active->end(record);
+
+  {
+    std::lock_guard<std::mutex> guard(active->objectMutex);
+    active->memorySizes[*memory] = allocateInfo->allocationSize;
+  }
+  if (import)
+    active->trackMapping(*memory, 0, import->pHostPointer,
+                         allocateInfo->allocationSize, true);
+  return result;
+}
+
+static void VKAPI_CALL
+capture_vkFreeMemory(VkDevice device, VkDeviceMemory memory,
+                     VkAllocationCallbacks const *allocator) {
+  active->untrackMapping(memory, false);
+  {
+    std::lock_guard<std::mutex> guard(active->objectMutex);
+    active->memorySizes.erase(memory);
+  }
+  active->real.vkFreeMemory(device, memory, allocator);
+}
+
+static VkResult VKAPI_CALL capture_vkMapMemory(VkDevice device,
+                                               VkDeviceMemory memory,
+                                               VkDeviceSize offset,
+                                               VkDeviceSize size,
+                                               VkMemoryMapFlags flags,
+                                               void **data) {
+  auto result =
+      active->real.vkMapMemory(device, memory, offset, size, flags, data);
+  if (result == VK_SUCCESS)
+    active->trackMapping(memory, offset, *data, size, false);
+  return result;
+}
+
+static void VKAPI_CALL capture_vkUnmapMemory(VkDevice device,
+                                             VkDeviceMemory memory) {
+  active->untrackMapping(memory, true);
+  active->real.vkUnmapMemory(device, memory);
+}
+
+static VkResult VKAPI_CALL capture_vkCreateBuffer(
+    VkDevice device, VkBufferCreateInfo const *createInfo,
+    VkAllocationCallbacks const *allocator, VkBuffer *buffer) {
+  auto result =
+      active->real.vkCreateBuffer(device, createInfo, allocator, buffer);
+  if (result == VK_SUCCESS) {
+    auto &record = active->begin(CaptureOp::CreateBuffer);
+    record.put(*buffer, *createInfo);
+    active->end(record);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL capture_vkBindBufferMemory(VkDevice device,
+                                                      VkBuffer buffer,
+                                                      VkDeviceMemory memory,
+                                                      VkDeviceSize offset) {
+  auto &record = active->begin(CaptureOp::BindBufferMemory);
+  record.put(buffer, memory, offset);
+  active->end(record);
+  return active->real.vkBindBufferMemory(device, buffer, memory, offset);
+}
+
+static void VKAPI_CALL
+capture_vkDestroyBuffer(VkDevice device, VkBuffer buffer,
+                        VkAllocationCallbacks const *allocator) {
+  auto &record = active->begin(CaptureOp::DestroyBuffer);
+  record.put(buffer);
+  active->end(record);
+  active->real.vkDestroyBuffer(device, buffer, allocator);
+}
+
+static VkResult VKAPI_CALL capture_vkCreateImage(
+    VkDevice device, VkImageCreateInfo const *createInfo,
+    VkAllocationCallbacks const *allocator, VkImage *image) {
+  auto result =
+      active->real.vkCreateImage(device, createInfo, allocator, image);
+  if (result == VK_SUCCESS) {
+    auto &record = active->begin(CaptureOp::CreateImage);
+    record.put(*image, *createInfo);
+    active->end(record);
+
+    std::lock_guard<std::mutex> guard(active->objectMutex);
+    active->imageFormats[*image] = createInfo->format;
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL capture_vkBindImageMemory(VkDevice device,
+                                                     VkImage image,
+                                                     VkDeviceMemory memory,
+                                                     VkDeviceSize offset) {
+  VkMemoryRequirements requirements;
+  active->real.vkGetImageMemoryRequirements(device, image, &requirements);
+
+  auto &record = active->begin(CaptureOp::BindImageMemory);
+  record.put(image, memory, offset, requirements.size);
+  active->end(record);
+  return active->real.vkBindImageMemory(device, image, memory, offset);
+}
+
+static void VKAPI_CALL
+capture_vkDestroyImage(VkDevice device, VkImage image,
+                       VkAllocationCallbacks const *allocator) {
+  auto &record = active->begin(CaptureOp::DestroyImage);
+  record.put(image);
+  active->end(record);
+  {
+    std::lock_guard<std::mutex> guard(active->objectMutex);
+    active->imageFormats.erase(image);
+  }
+  active->real.vkDestroyImage(device, image, allocator);
+}
+
+static VkResult VKAPI_CALL capture_vkCreateSwapchainKHR(
+    VkDevice device, VkSwapchainCreateInfoKHR const *createInfo,
+    VkAllocationCallbacks const *allocator, VkSwapchainKHR *swapchain) {
+  auto result = active->real.vkCreateSwapchainKHR(device, createInfo,
+                                                  allocator, swapchain);
+  if (result == VK_SUCCESS) {
+    std::lock_guard<std::mutex> guard(active->objectMutex);
+    active->swapchains[*swapchain] = {
+        .format = createInfo->imageFormat,
+        .extent = createInfo->imageExtent,
+        .arrayLayers = createInfo->imageArrayLayers,
+        .usage = createInfo->imageUsage};
+  }
+  return result;
+}
+
+static void VKAPI_CALL
+capture_vkDestroySwapchainKHR(VkDevice device, VkSwapchainKHR swapchain,
+                              VkAllocationCallbacks const *allocator) {
+  {
+    std::lock_guard<std::mutex> guard(active->objectMutex);
+    active->swapchains.erase(swapchain);
+  }
+  active->real.vkDestroySwapchainKHR(device, swapchain, allocator);
+}
+
+// Swapchain images are replayed as ordinary images of the same format,
+// extent and usage.
+static VkResult VKAPI_CALL
+capture_vkGetSwapchainImagesKHR(VkDevice device, VkSwapchainKHR swapchain,
+                                uint32_t *imageCount, VkImage *images) {
+  auto result = active->real.vkGetSwapchainImagesKHR(device, swapchain,
+                                                     imageCount, images);
+  if (result != VK_SUCCESS || images == nullptr)
+    return result;
+
+  std::lock_guard<std::mutex> guard(active->objectMutex);
+  auto &info = active->swapchains[swapchain];
+  if (info.imagesCaptured)
+    return result;
+  info.imagesCaptured = true;
+
+  auto createInfo = VkImageCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .pNext = nullptr,
+      .flags = {},
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = info.format,
+      .extent = {info.extent.width, info.extent.height, 1},
+      .mipLevels = 1,
+      .arrayLayers = info.arrayLayers,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = info.usage,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .queueFamilyIndexCount = 0,
+      .pQueueFamilyIndices = nullptr,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED};
+  for (uint32_t index = 0; index < *imageCount; ++index) {
+    auto &record = active->begin(CaptureOp::SwapchainImage);
+    record.put(images[index], createInfo);
+    active->end(record);
+    active->imageFormats[images[index]] = info.format;
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL capture_vkCopyMemoryToImageEXT(
+    VkDevice device, VkCopyMemoryToImageInfoEXT const *copyInfo) {
+  VkDeviceSize bytesPerTexel;
+  {
+    std::lock_guard<std::mutex> guard(active->objectMutex);
+    bytesPerTexel = formatTexelSize(active->imageFormats[copyInfo->dstImage]);
+  }
+
+  auto &record = active->begin(CaptureOp::CopyMemoryToImage);
+  record.put(copyInfo->dstImage, copyInfo->dstImageLayout,
+             copyInfo->regionCount);
+  for (uint32_t index = 0; index < copyInfo->regionCount; ++index) {
+    auto const &region = copyInfo->pRegions[index];
+    auto const &extent = region.imageExtent;
+    VkDeviceSize rowLength =
+        region.memoryRowLength ? region.memoryRowLength : extent.width;
+    VkDeviceSize imageHeight =
+        region.memoryImageHeight ? region.memoryImageHeight : extent.height;
+    VkDeviceSize slices =
+        (VkDeviceSize)extent.depth * region.imageSubresource.layerCount;
+    auto size = ((slices - 1) * imageHeight * rowLength +
+                 (extent.height - 1) * rowLength + extent.width) *
+                bytesPerTexel;
+
+    record.put(region);
+    record.putArray((char const *)region.pHostPointer, (uint32_t)size);
+  }
+  active->end(record);
+  return active->real.vkCopyMemoryToImageEXT(device, copyInfo);
+}
+
+static VkResult VKAPI_CALL capture_vkTransitionImageLayoutEXT(
+    VkDevice device, uint32_t transitionCount,
+    VkHostImageLayoutTransitionInfoEXT const *transitions) {
+  auto &record = active->begin(CaptureOp::TransitionImageLayout);
+  record.putArray(transitions, transitionCount);
+  active->end(record);
+  return active->real.vkTransitionImageLayoutEXT(device, transitionCount,
+                                                 transitions);
+}
+
+static VkResult VKAPI_CALL capture_vkCreateImageView(
+    VkDevice device, VkImageViewCreateInfo const *createInfo,
+    VkAllocationCallbacks const *allocator, VkImageView *imageView) {
+  auto result =
+      active->real.vkCreateImageView(device, createInfo, allocator, imageView);
+  if (result == VK_SUCCESS) {
+    auto &record = active->begin(CaptureOp::CreateImageView);
+    record.put(*imageView, *createInfo);
+    active->end(record);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL capture_vkCreateSampler(
+    VkDevice device, VkSamplerCreateInfo const *createInfo,
+    VkAllocationCallbacks const *allocator, VkSampler *sampler) {
+  auto result =
+      active->real.vkCreateSampler(device, createInfo, allocator, sampler);
+  if (result == VK_SUCCESS) {
+    auto &record = active->begin(CaptureOp::CreateSampler);
+    record.put(*sampler, *createInfo);
+    active->end(record);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL capture_vkCreateShaderModule(
+    VkDevice device, VkShaderModuleCreateInfo const *createInfo,
+    VkAllocationCallbacks const *allocator, VkShaderModule *shaderModule) {
+  auto result = active->real.vkCreateShaderModule(device, createInfo,
+                                                  allocator, shaderModule);
+  if (result == VK_SUCCESS) {
+    auto &record = active->begin(CaptureOp::CreateShaderModule);
+    record.put(*shaderModule, createInfo->flags);
+    record.putArray((char const *)createInfo->pCode,
+                    (uint32_t)createInfo->codeSize);
+    active->end(record);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL capture_vkCreateDescriptorSetLayout(
+    VkDevice device, VkDescriptorSetLayoutCreateInfo const *createInfo,
+    VkAllocationCallbacks const *allocator, VkDescriptorSetLayout *layout) {
+  auto result = active->real.vkCreateDescriptorSetLayout(device, createInfo,
+                                                         allocator, layout);
+  if (result == VK_SUCCESS) {
+    auto &record = active->begin(CaptureOp::CreateDescriptorSetLayout);
+    record.put(*layout, createInfo->flags, createInfo->bindingCount);
+    for (uint32_t index = 0; index < createInfo->bindingCount; ++index) {
+      auto const &binding = createInfo->pBindings[index];
+      record.put(binding);
+      record.putArray(binding.pImmutableSamplers,
+                      binding.pImmutableSamplers ? binding.descriptorCount
+                                                 : 0);
+    }
+    active->end(record);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL capture_vkCreatePipelineLayout(
+    VkDevice device, VkPipelineLayoutCreateInfo const *createInfo,
+    VkAllocationCallbacks const *allocator, VkPipelineLayout *layout) {
+  auto result = active->real.vkCreatePipelineLayout(device, createInfo,
+                                                    allocator, layout);
+  if (result == VK_SUCCESS) {
+    auto &record = active->begin(CaptureOp::CreatePipelineLayout);
+    record.put(*layout, createInfo->flags);
+    record.putArray(createInfo->pSetLayouts, createInfo->setLayoutCount);
+    record.putArray(createInfo->pPushConstantRanges,
+                    createInfo->pushConstantRangeCount);
+    active->end(record);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL capture_vkCreateDescriptorPool(
+    VkDevice device, VkDescriptorPoolCreateInfo const *createInfo,
+    VkAllocationCallbacks const *allocator, VkDescriptorPool *pool) {
+  auto result =
+      active->real.vkCreateDescriptorPool(device, createInfo, allocator, pool);
+  if (result == VK_SUCCESS) {
+    auto &record = active->begin(CaptureOp::CreateDescriptorPool);
+    record.put(*pool, createInfo->flags, createInfo->maxSets);
+    record.putArray(createInfo->pPoolSizes, createInfo->poolSizeCount);
+    active->end(record);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL capture_vkAllocateDescriptorSets(
+    VkDevice device, VkDescriptorSetAllocateInfo const *allocateInfo,
+    VkDescriptorSet *sets) {
+  auto result =
+      active->real.vkAllocateDescriptorSets(device, allocateInfo, sets);
+  if (result == VK_SUCCESS) {
+    auto &record = active->begin(CaptureOp::AllocateDescriptorSets);
+    record.put(allocateInfo->descriptorPool);
+    record.putArray(allocateInfo->pSetLayouts,
+                    allocateInfo->descriptorSetCount);
+    record.putArray(sets, allocateInfo->descriptorSetCount);
+    active->end(record);
+  }
+  return result;
+}
+
+enum class DescriptorInfoKind : uint8_t { None, Image, Buffer, TexelBuffer };
+
+static DescriptorInfoKind descriptorInfoKind(VkDescriptorType type) {
+  switch (type) {
+  case VK_DESCRIPTOR_TYPE_SAMPLER:
+  case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+  case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+  case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+  case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+    return DescriptorInfoKind::Image;
+  case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+  case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+  case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+  case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+    return DescriptorInfoKind::Buffer;
+  case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+  case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+    return DescriptorInfoKind::TexelBuffer;
+  default:
+    return DescriptorInfoKind::None;
+  }
+}
+
+static void VKAPI_CALL capture_vkUpdateDescriptorSets(
+    VkDevice device, uint32_t writeCount, VkWriteDescriptorSet const *writes,
+    uint32_t copyCount, VkCopyDescriptorSet const *copies) {
+  auto &record = active->begin(CaptureOp::UpdateDescriptorSets);
+  record.put(writeCount);
+  for (uint32_t index = 0; index < writeCount; ++index) {
+    auto const &write = writes[index];
+    auto kind = descriptorInfoKind(write.descriptorType);
+    record.put(write, kind);
+    if (kind == DescriptorInfoKind::Image)
+      record.putArray(write.pImageInfo, write.descriptorCount);
+    else if (kind == DescriptorInfoKind::Buffer)
+      record.putArray(write.pBufferInfo, write.descriptorCount);
+    else if (kind == DescriptorInfoKind::TexelBuffer)
+      record.putArray(write.pTexelBufferView, write.descriptorCount);
+  }
+  record.putArray(copies, copyCount);
+  active->end(record);
+
+  active->real.vkUpdateDescriptorSets(device, writeCount, writes, copyCount,
+                                      copies);
+}
+
+static VkResult VKAPI_CALL capture_vkCreateRenderPass(
+    VkDevice device, VkRenderPassCreateInfo const *createInfo,
+    VkAllocationCallbacks const *allocator, VkRenderPass *renderPass) {
+  auto result = active->real.vkCreateRenderPass(device, createInfo, allocator,
+                                                renderPass);
+  if (result != VK_SUCCESS)
+    return result;
+
+  auto &record = active->begin(CaptureOp::CreateRenderPass);
+  record.put(*renderPass, createInfo->flags);
+  record.putArray(createInfo->pAttachments, createInfo->attachmentCount);
+  record.put(createInfo->subpassCount);
+  for (uint32_t index = 0; index < createInfo->subpassCount; ++index) {
+    auto const &subpass = createInfo->pSubpasses[index];
+    record.put(subpass);
+    record.putArray(subpass.pInputAttachments, subpass.inputAttachmentCount);
+    record.putArray(subpass.pColorAttachments, subpass.colorAttachmentCount);
+    record.putArray(subpass.pResolveAttachments,
+                    subpass.pResolveAttachments ? subpass.colorAttachmentCount
+                                                : 0);
+    record.putOptional(subpass.pDepthStencilAttachment);
+    record.putArray(subpass.pPreserveAttachments,
+                    subpass.preserveAttachmentCount);
+  }
+  record.putArray(createInfo->pDependencies, createInfo->dependencyCount);
+  active->end(record);
+  return result;
+}
+
+static VkResult VKAPI_CALL capture_vkCreateFramebuffer(
+    VkDevice device, VkFramebufferCreateInfo const *createInfo,
+    VkAllocationCallbacks const *allocator, VkFramebuffer *framebuffer) {
+  auto result = active->real.vkCreateFramebuffer(device, createInfo,
+                                                 allocator, framebuffer);
+  if (result == VK_SUCCESS) {
+    auto &record = active->begin(CaptureOp::CreateFramebuffer);
+    record.put(*framebuffer, *createInfo);
+    record.putArray(createInfo->pAttachments, createInfo->attachmentCount);
+    active->end(record);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL capture_vkCreateComputePipelines(
+    VkDevice device, VkPipelineCache cache, uint32_t createInfoCount,
+    VkComputePipelineCreateInfo const *createInfos,
+    VkAllocationCallbacks const *allocator, VkPipeline *pipelines) {
+  auto result = active->real.vkCreateComputePipelines(
+      device, cache, createInfoCount, createInfos, allocator, pipelines);
+  if (result != VK_SUCCESS)
+    return result;
+
+  for (uint32_t index = 0; index < createInfoCount; ++index) {
+    auto const &createInfo = createInfos[index];
+    auto &record = active->begin(CaptureOp::CreateComputePipeline);
+    record.put(pipelines[index], createInfo.flags);
+    putShaderStage(record, createInfo.stage);
+    record.put(createInfo.layout);
+    active->end(record);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL capture_vkCreateGraphicsPipelines(
+    VkDevice device, VkPipelineCache cache, uint32_t createInfoCount,
+    VkGraphicsPipelineCreateInfo const *createInfos,
+    VkAllocationCallbacks const *allocator, VkPipeline *pipelines) {
+  auto result = active->real.vkCreateGraphicsPipelines(
+      device, cache, createInfoCount, createInfos, allocator, pipelines);
+  if (result != VK_SUCCESS)
+    return result;
+
+  for (uint32_t index = 0; index < createInfoCount; ++index) {
+    auto const &createInfo = createInfos[index];
+    auto &record = active->begin(CaptureOp::CreateGraphicsPipeline);
+    record.put(pipelines[index], createInfo.flags, createInfo.stageCount);
+    for (uint32_t stage = 0; stage < createInfo.stageCount; ++stage)
+      putShaderStage(record, createInfo.pStages[stage]);
+
+    auto const *vertexInput = createInfo.pVertexInputState;
+    record.putOptional(vertexInput);
+    if (vertexInput) {
+      record.putArray(vertexInput->pVertexBindingDescriptions,
+                      vertexInput->vertexBindingDescriptionCount);
+      record.putArray(vertexInput->pVertexAttributeDescriptions,
+                      vertexInput->vertexAttributeDescriptionCount);
+    }
+
+    record.putOptional(createInfo.pInputAssemblyState);
+    record.putOptional(createInfo.pTessellationState);
+
+    auto const *viewport = createInfo.pViewportState;
+    record.putOptional(viewport);
+    if (viewport) {
+      record.putArray(viewport->pViewports,
+                      viewport->pViewports ? viewport->viewportCount : 0);
+      record.putArray(viewport->pScissors,
+                      viewport->pScissors ? viewport->scissorCount : 0);
+    }
+
+    record.putOptional(createInfo.pRasterizationState);
+
+    auto const *multisample = createInfo.pMultisampleState;
+    record.putOptional(multisample);
+    if (multisample)
+      record.putArray(multisample->pSampleMask,
+                      multisample->pSampleMask
+                          ? (multisample->rasterizationSamples + 31) / 32
+                          : 0);
+
+    record.putOptional(createInfo.pDepthStencilState);
+
+    auto const *colorBlend = createInfo.pColorBlendState;
+    record.putOptional(colorBlend);
+    if (colorBlend)
+      record.putArray(colorBlend->pAttachments, colorBlend->attachmentCount);
+
+    auto const *dynamic = createInfo.pDynamicState;
+    record.putOptional(dynamic);
+    if (dynamic)
+      record.putArray(dynamic->pDynamicStates, dynamic->dynamicStateCount);
+
+    auto const *rendering = (VkPipelineRenderingCreateInfo const *)findNext(
+        createInfo.pNext, VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO);
+    record.putOptional(rendering);
+    if (rendering)
+      record.putArray(rendering->pColorAttachmentFormats,
+                      rendering->colorAttachmentCount);
+
+    record.put(createInfo.layout, createInfo.renderPass, createInfo.subpass);
+    active->end(record);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL capture_vkAllocateCommandBuffers(
+    VkDevice device, VkCommandBufferAllocateInfo const *allocateInfo,
+    VkCommandBuffer *commandBuffers) {
+  auto result = active->real.vkAllocateCommandBuffers(device, allocateInfo,
+                                                      commandBuffers);
+  if (result == VK_SUCCESS) {
+    auto &record = active->begin(CaptureOp::AllocateCommandBuffers);
+    record.put(allocateInfo->level);
+    record.putArray(commandBuffers, allocateInfo->commandBufferCount);
+    active->end(record);
+  }
+  return result;
+}
+
+static VkResult VKAPI_CALL capture_vkQueueSubmit(VkQueue queue,
+                                                 uint32_t submitCount,
+                                                 VkSubmitInfo const *submits,
+                                                 VkFence fence) {
+  active->writeHostMemory();
+  for (uint32_t index = 0; index < submitCount; ++index) {
+    auto &record = active->begin(CaptureOp::Submit);
+    record.putArray(submits[index].pCommandBuffers,
+                    submits[index].commandBufferCount);
+    active->end(record);
+  }
+  return active->real.vkQueueSubmit(queue, submitCount, submits, fence);
+}
+
+static VkResult VKAPI_CALL capture_vkQueueSubmit2(VkQueue queue,
+                                                  uint32_t submitCount,
+                                                  VkSubmitInfo2 const *submits,
+                                                  VkFence fence) {
+  active->writeHostMemory();
+  std::vector<VkCommandBuffer> commandBuffers;
+  for (uint32_t index = 0; index < submitCount; ++index) {
+    auto const &submit = submits[index];
+    commandBuffers.clear();
+    for (uint32_t info = 0; info < submit.commandBufferInfoCount; ++info)
+      commandBuffers.push_back(submit.pCommandBufferInfos[info].commandBuffer);
+
+    auto &record = active->begin(CaptureOp::Submit);
+    record.putArray(commandBuffers.data(), (uint32_t)commandBuffers.size());
+    active->end(record);
+  }
+  return active->real.vkQueueSubmit2(queue, submitCount, submits, fence);
+}
+
+static VkResult VKAPI_CALL
+capture_vkQueuePresentKHR(VkQueue queue, VkPresentInfoKHR const *presentInfo) {
+  active->end(active->begin(CaptureOp::Frame));
+  return active->real.vkQueuePresentKHR(queue, presentInfo);
+}
+
+static VkResult VKAPI_CALL
+capture_vkBeginCommandBuffer(VkCommandBuffer commandBuffer,
+                             VkCommandBufferBeginInfo const *beginInfo) {
+  auto &record = active->begin(CaptureOp::BeginCommandBuffer);
+  record.put(commandBuffer, beginInfo->flags);
+
+  auto const *inheritance = beginInfo->pInheritanceInfo;
+  record.putOptional(inheritance);
+  VkCommandBufferInheritanceRenderingInfo const *rendering = nullptr;
+  if (inheritance)
+    rendering = (VkCommandBufferInheritanceRenderingInfo const *)findNext(
+        inheritance->pNext,
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO);
+  record.putOptional(rendering);
+  if (rendering)
+    record.putArray(rendering->pColorAttachmentFormats,
+                    rendering->colorAttachmentCount);
+  active->end(record);
+
+  return active->real.vkBeginCommandBuffer(commandBuffer, beginInfo);
+}
+
+static VkResult VKAPI_CALL
+capture_vkEndCommandBuffer(VkCommandBuffer commandBuffer) {
+  auto &record = active->begin(CaptureOp::EndCommandBuffer);
+  record.put(commandBuffer);
+  active->end(record);
+  return active->real.vkEndCommandBuffer(commandBuffer);
+}
+
+static void VKAPI_CALL
+capture_vkCmdBeginRenderPass(VkCommandBuffer commandBuffer,
+                             VkRenderPassBeginInfo const *beginInfo,
+                             VkSubpassContents contents) {
+  auto &record = active->begin(CaptureOp::CmdBeginRenderPass);
+  record.put(commandBuffer, beginInfo->renderPass, beginInfo->framebuffer,
+             beginInfo->renderArea, contents);
+  record.putArray(beginInfo->pClearValues, beginInfo->clearValueCount);
+  active->end(record);
+  active->real.vkCmdBeginRenderPass(commandBuffer, beginInfo, contents);
+}
+
+static void VKAPI_CALL
+capture_vkCmdEndRenderPass(VkCommandBuffer commandBuffer) {
+  auto &record = active->begin(CaptureOp::CmdEndRenderPass);
+  record.put(commandBuffer);
+  active->end(record);
+  active->real.vkCmdEndRenderPass(commandBuffer);
+}
+
+static void VKAPI_CALL capture_vkCmdNextSubpass(VkCommandBuffer commandBuffer,
+                                                VkSubpassContents contents) {
+  auto &record = active->begin(CaptureOp::CmdNextSubpass);
+  record.put(commandBuffer, contents);
+  active->end(record);
+  active->real.vkCmdNextSubpass(commandBuffer, contents);
+}
+
+static void VKAPI_CALL
+capture_vkCmdBeginRendering(VkCommandBuffer commandBuffer,
+                            VkRenderingInfo const *renderingInfo) {
+  auto &record = active->begin(CaptureOp::CmdBeginRendering);
+  record.put(commandBuffer, renderingInfo->flags, renderingInfo->renderArea,
+             renderingInfo->layerCount, renderingInfo->viewMask);
+  record.putArray(renderingInfo->pColorAttachments,
+                  renderingInfo->colorAttachmentCount);
+  record.putOptional(renderingInfo->pDepthAttachment);
+  record.putOptional(renderingInfo->pStencilAttachment);
+  active->end(record);
+  active->real.vkCmdBeginRendering(commandBuffer, renderingInfo);
+}
+
+static void VKAPI_CALL
+capture_vkCmdEndRendering(VkCommandBuffer commandBuffer) {
+  auto &record = active->begin(CaptureOp::CmdEndRendering);
+  record.put(commandBuffer);
+  active->end(record);
+  active->real.vkCmdEndRendering(commandBuffer);
+}
+
+static void VKAPI_CALL capture_vkCmdClearColorImage(
+    VkCommandBuffer commandBuffer, VkImage image, VkImageLayout layout,
+    VkClearColorValue const *color, uint32_t rangeCount,
+    VkImageSubresourceRange const *ranges) {
+  auto &record = active->begin(CaptureOp::CmdClearColorImage);
+  record.put(commandBuffer, image, layout, *color);
+  record.putArray(ranges, rangeCount);
+  active->end(record);
+  active->real.vkCmdClearColorImage(commandBuffer, image, layout, color,
+                                    rangeCount, ranges);
+}
+
+static void VKAPI_CALL
+capture_vkCmdBindPipeline(VkCommandBuffer commandBuffer,
+                          VkPipelineBindPoint bindPoint, VkPipeline pipeline) {
+  auto &record = active->begin(CaptureOp::CmdBindPipeline);
+  record.put(commandBuffer, bindPoint, pipeline);
+  active->end(record);
+  active->real.vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
+}
+
+static void VKAPI_CALL capture_vkCmdSetViewport(VkCommandBuffer commandBuffer,
+                                                uint32_t firstViewport,
+                                                uint32_t viewportCount,
+                                                VkViewport const *viewports) {
+  auto &record = active->begin(CaptureOp::CmdSetViewport);
+  record.put(commandBuffer, firstViewport);
+  record.putArray(viewports, viewportCount);
+  active->end(record);
+  active->real.vkCmdSetViewport(commandBuffer, firstViewport, viewportCount,
+                                viewports);
+}
+
+static void VKAPI_CALL capture_vkCmdSetScissor(VkCommandBuffer commandBuffer,
+                                               uint32_t firstScissor,
+                                               uint32_t scissorCount,
+                                               VkRect2D const *scissors) {
+  auto &record = active->begin(CaptureOp::CmdSetScissor);
+  record.put(commandBuffer, firstScissor);
+  record.putArray(scissors, scissorCount);
+  active->end(record);
+  active->real.vkCmdSetScissor(commandBuffer, firstScissor, scissorCount,
+                               scissors);
+}
+
+static void VKAPI_CALL capture_vkCmdPipelineBarrier(
+    VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStageMask,
+    VkPipelineStageFlags dstStageMask, VkDependencyFlags dependencyFlags,
+    uint32_t memoryBarrierCount, VkMemoryBarrier const *memoryBarriers,
+    uint32_t bufferBarrierCount, VkBufferMemoryBarrier const *bufferBarriers,
+    uint32_t imageBarrierCount, VkImageMemoryBarrier const *imageBarriers) {
+  auto &record = active->begin(CaptureOp::CmdPipelineBarrier);
+  record.put(commandBuffer, srcStageMask, dstStageMask, dependencyFlags);
+  record.putArray(memoryBarriers, memoryBarrierCount);
+  record.putArray(bufferBarriers, bufferBarrierCount);
+  record.putArray(imageBarriers, imageBarrierCount);
+  active->end(record);
+  active->real.vkCmdPipelineBarrier(
+      commandBuffer, srcStageMask, dstStageMask, dependencyFlags,
+      memoryBarrierCount, memoryBarriers, bufferBarrierCount, bufferBarriers,
+      imageBarrierCount, imageBarriers);
+}
+
+static void VKAPI_CALL
+capture_vkCmdPipelineBarrier2(VkCommandBuffer commandBuffer,
+                              VkDependencyInfo const *dependencyInfo) {
+  auto &record = active->begin(CaptureOp::CmdPipelineBarrier2);
+  record.put(commandBuffer, dependencyInfo->dependencyFlags);
+  record.putArray(dependencyInfo->pMemoryBarriers,
+                  dependencyInfo->memoryBarrierCount);
+  record.putArray(dependencyInfo->pBufferMemoryBarriers,
+                  dependencyInfo->bufferMemoryBarrierCount);
+  record.putArray(dependencyInfo->pImageMemoryBarriers,
+                  dependencyInfo->imageMemoryBarrierCount);
+  active->end(record);
+  active->real.vkCmdPipelineBarrier2(commandBuffer, dependencyInfo);
+}
+
+static void VKAPI_CALL capture_vkCmdBindVertexBuffers(
+    VkCommandBuffer commandBuffer, uint32_t firstBinding,
+    uint32_t bindingCount, VkBuffer const *buffers,
+    VkDeviceSize const *offsets) {
+  auto &record = active->begin(CaptureOp::CmdBindVertexBuffers);
+  record.put(commandBuffer, firstBinding);
+  record.putArray(buffers, bindingCount);
+  record.putArray(offsets, bindingCount);
+  active->end(record);
+  active->real.vkCmdBindVertexBuffers(commandBuffer, firstBinding,
+                                      bindingCount, buffers, offsets);
+}
+
+static void VKAPI_CALL capture_vkCmdBindIndexBuffer(
+    VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset,
+    VkIndexType indexType) {
+  auto &record = active->begin(CaptureOp::CmdBindIndexBuffer);
+  record.put(commandBuffer, buffer, offset, indexType);
+  active->end(record);
+  active->real.vkCmdBindIndexBuffer(commandBuffer, buffer, offset, indexType);
+}
+
+static void VKAPI_CALL capture_vkCmdBindDescriptorSets(
+    VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint,
+    VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount,
+    VkDescriptorSet const *sets, uint32_t dynamicOffsetCount,
+    uint32_t const *dynamicOffsets) {
+  auto &record = active->begin(CaptureOp::CmdBindDescriptorSets);
+  record.put(commandBuffer, bindPoint, layout, firstSet);
+  record.putArray(sets, setCount);
+  record.putArray(dynamicOffsets, dynamicOffsetCount);
+  active->end(record);
+  active->real.vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout,
+                                       firstSet, setCount, sets,
+                                       dynamicOffsetCount, dynamicOffsets);
+}
+
+static void VKAPI_CALL capture_vkCmdPushConstants(
+    VkCommandBuffer commandBuffer, VkPipelineLayout layout,
+    VkShaderStageFlags stageFlags, uint32_t offset, uint32_t size,
+    void const *values) {
+  auto &record = active->begin(CaptureOp::CmdPushConstants);
+  record.put(commandBuffer, layout, stageFlags, offset);
+  record.putArray((char const *)values, size);
+  active->end(record);
+  active->real.vkCmdPushConstants(commandBuffer, layout, stageFlags, offset,
+                                  size, values);
+}
+
+static void VKAPI_CALL capture_vkCmdCopyBuffer(VkCommandBuffer commandBuffer,
+                                               VkBuffer srcBuffer,
+                                               VkBuffer dstBuffer,
+                                               uint32_t regionCount,
+                                               VkBufferCopy const *regions) {
+  auto &record = active->begin(CaptureOp::CmdCopyBuffer);
+  record.put(commandBuffer, srcBuffer, dstBuffer);
+  record.putArray(regions, regionCount);
+  active->end(record);
+  active->real.vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer,
+                               regionCount, regions);
+}
+
+static void VKAPI_CALL capture_vkCmdCopyBufferToImage(
+    VkCommandBuffer commandBuffer, VkBuffer srcBuffer, VkImage dstImage,
+    VkImageLayout dstImageLayout, uint32_t regionCount,
+    VkBufferImageCopy const *regions) {
+  auto &record = active->begin(CaptureOp::CmdCopyBufferToImage);
+  record.put(commandBuffer, srcBuffer, dstImage, dstImageLayout);
+  record.putArray(regions, regionCount);
+  active->end(record);
+  active->real.vkCmdCopyBufferToImage(commandBuffer, srcBuffer, dstImage,
+                                      dstImageLayout, regionCount, regions);
+}
+
+static void VKAPI_CALL capture_vkCmdCopyImageToBuffer(
+    VkCommandBuffer commandBuffer, VkImage srcImage,
+    VkImageLayout srcImageLayout, VkBuffer dstBuffer, uint32_t regionCount,
+    VkBufferImageCopy const *regions) {
+  auto &record = active->begin(CaptureOp::CmdCopyImageToBuffer);
+  record.put(commandBuffer, srcImage, srcImageLayout, dstBuffer);
+  record.putArray(regions, regionCount);
+  active->end(record);
+  active->real.vkCmdCopyImageToBuffer(commandBuffer, srcImage, srcImageLayout,
+                                      dstBuffer, regionCount, regions);
+}
+
+static void VKAPI_CALL capture_vkCmdBlitImage(
+    VkCommandBuffer commandBuffer, VkImage srcImage,
+    VkImageLayout srcImageLayout, VkImage dstImage,
+    VkImageLayout dstImageLayout, uint32_t regionCount,
+    VkImageBlit const *regions, VkFilter filter) {
+  auto &record = active->begin(CaptureOp::CmdBlitImage);
+  record.put(commandBuffer, srcImage, srcImageLayout, dstImage,
+             dstImageLayout, filter);
+  record.putArray(regions, regionCount);
+  active->end(record);
+  active->real.vkCmdBlitImage(commandBuffer, srcImage, srcImageLayout,
+                              dstImage, dstImageLayout, regionCount, regions,
+                              filter);
+}
+
+static void VKAPI_CALL capture_vkCmdDraw(VkCommandBuffer commandBuffer,
+                                         uint32_t vertexCount,
+                                         uint32_t instanceCount,
+                                         uint32_t firstVertex,
+                                         uint32_t firstInstance) {
+  auto &record = active->begin(CaptureOp::CmdDraw);
+  record.put(commandBuffer, vertexCount, instanceCount, firstVertex,
+             firstInstance);
+  active->end(record);
+  active->real.vkCmdDraw(commandBuffer, vertexCount, instanceCount,
+                         firstVertex, firstInstance);
+}
+
+static void VKAPI_CALL capture_vkCmdDrawIndexed(
+    VkCommandBuffer commandBuffer, uint32_t indexCount, uint32_t instanceCount,
+    uint32_t firstIndex, int32_t vertexOffset, uint32_t firstInstance) {
+  auto &record = active->begin(CaptureOp::CmdDrawIndexed);
+  record.put(commandBuffer, indexCount, instanceCount, firstIndex,
+             vertexOffset, firstInstance);
+  active->end(record);
+  active->real.vkCmdDrawIndexed(commandBuffer, indexCount, instanceCount,
+                                firstIndex, vertexOffset, firstInstance);
+}
+
+static void VKAPI_CALL capture_vkCmdDrawIndirect(VkCommandBuffer commandBuffer,
+                                                 VkBuffer buffer,
+                                                 VkDeviceSize offset,
+                                                 uint32_t drawCount,
+                                                 uint32_t stride) {
+  auto &record = active->begin(CaptureOp::CmdDrawIndirect);
+  record.put(commandBuffer, buffer, offset, drawCount, stride);
+  active->end(record);
+  active->real.vkCmdDrawIndirect(commandBuffer, buffer, offset, drawCount,
+                                 stride);
+}
+
+static void VKAPI_CALL capture_vkCmdDrawIndexedIndirect(
+    VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset,
+    uint32_t drawCount, uint32_t stride) {
+  auto &record = active->begin(CaptureOp::CmdDrawIndexedIndirect);
+  record.put(commandBuffer, buffer, offset, drawCount, stride);
+  active->end(record);
+  active->real.vkCmdDrawIndexedIndirect(commandBuffer, buffer, offset,
+                                        drawCount, stride);
+}
+
+static void VKAPI_CALL capture_vkCmdDrawIndexedIndirectCount(
+    VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset,
+    VkBuffer countBuffer, VkDeviceSize countBufferOffset,
+    uint32_t maxDrawCount, uint32_t stride) {
+  auto &record = active->begin(CaptureOp::CmdDrawIndexedIndirectCount);
+  record.put(commandBuffer, buffer, offset, countBuffer, countBufferOffset,
+             maxDrawCount, stride);
+  active->end(record);
+  active->real.vkCmdDrawIndexedIndirectCount(commandBuffer, buffer, offset,
+                                             countBuffer, countBufferOffset,
+                                             maxDrawCount, stride);
+}
+
+// Multi-draws are stored tightly packed whatever their stride.
+static void VKAPI_CALL capture_vkCmdDrawMultiEXT(
+    VkCommandBuffer commandBuffer, uint32_t drawCount,
+    VkMultiDrawInfoEXT const *vertexInfo, uint32_t instanceCount,
+    uint32_t firstInstance, uint32_t stride) {
+  auto &record = active->begin(CaptureOp::CmdDrawMulti);
+  record.put(commandBuffer, instanceCount, firstInstance, drawCount);
+  for (uint32_t index = 0; index < drawCount; ++index)
+    record.put(*(VkMultiDrawInfoEXT const *)((char const *)vertexInfo +
+                                             (size_t)index * stride));
+  active->end(record);
+  active->real.vkCmdDrawMultiEXT(commandBuffer, drawCount, vertexInfo,
+                                 instanceCount, firstInstance, stride);
+}
+
+static void VKAPI_CALL capture_vkCmdDrawMultiIndexedEXT(
+    VkCommandBuffer commandBuffer, uint32_t drawCount,
+    VkMultiDrawIndexedInfoEXT const *indexInfo, uint32_t instanceCount,
+    uint32_t firstInstance, uint32_t stride, int32_t const *vertexOffset) {
+  auto &record = active->begin(CaptureOp::CmdDrawMultiIndexed);
+  record.put(commandBuffer, instanceCount, firstInstance);
+  record.putOptional(vertexOffset);
+  record.put(drawCount);
+  for (uint32_t index = 0; index < drawCount; ++index)
+    record.put(*(VkMultiDrawIndexedInfoEXT const *)((char const *)indexInfo +
+                                                    (size_t)index * stride));
+  active->end(record);
+  active->real.vkCmdDrawMultiIndexedEXT(commandBuffer, drawCount, indexInfo,
+                                        instanceCount, firstInstance, stride,
+                                        vertexOffset);
+}
+
+static void VKAPI_CALL capture_vkCmdDispatch(VkCommandBuffer commandBuffer,
+                                             uint32_t groupCountX,
+                                             uint32_t groupCountY,
+                                             uint32_t groupCountZ) {
+  auto &record = active->begin(CaptureOp::CmdDispatch);
+  record.put(commandBuffer, groupCountX, groupCountY, groupCountZ);
+  active->end(record);
+  active->real.vkCmdDispatch(commandBuffer, groupCountX, groupCountY,
+                             groupCountZ);
+}
+
+static void VKAPI_CALL
+capture_vkCmdExecuteCommands(VkCommandBuffer commandBuffer,
+                             uint32_t commandBufferCount,
+                             VkCommandBuffer const *commandBuffers) {
+  auto &record = active->begin(CaptureOp::CmdExecuteCommands);
+  record.put(commandBuffer);
+  record.putArray(commandBuffers, commandBufferCount);
+  active->end(record);
+  active->real.vkCmdExecuteCommands(commandBuffer, commandBufferCount,
+                                    commandBuffers);
+}
+
+#define CAPTURE_DEFS(MACRO)                                                    \
+  MACRO(vkAllocateMemory);                                                     \
+  MACRO(vkFreeMemory);                                                         \
+  MACRO(vkMapMemory);                                                          \
+  MACRO(vkUnmapMemory);                                                        \
+  MACRO(vkCreateBuffer);                                                       \
+  MACRO(vkBindBufferMemory);                                                   \
+  MACRO(vkDestroyBuffer);                                                      \
+  MACRO(vkCreateImage);                                                        \
+  MACRO(vkBindImageMemory);                                                    \
+  MACRO(vkDestroyImage);                                                       \
+  MACRO(vkCreateSwapchainKHR);                                                 \
+  MACRO(vkDestroySwapchainKHR);                                                \
+  MACRO(vkGetSwapchainImagesKHR);                                              \
+  MACRO(vkCopyMemoryToImageEXT);                                               \
+  MACRO(vkTransitionImageLayoutEXT);                                           \
+  MACRO(vkCreateImageView);                                                    \
+  MACRO(vkCreateSampler);                                                      \
+  MACRO(vkCreateShaderModule);                                                 \
+  MACRO(vkCreateDescriptorSetLayout);                                          \
+  MACRO(vkCreatePipelineLayout);                                               \
+  MACRO(vkCreateDescriptorPool);                                               \
+  MACRO(vkAllocateDescriptorSets);                                             \
+  MACRO(vkUpdateDescriptorSets);                                               \
+  MACRO(vkCreateRenderPass);                                                   \
+  MACRO(vkCreateFramebuffer);                                                  \
+  MACRO(vkCreateComputePipelines);                                             \
+  MACRO(vkCreateGraphicsPipelines);                                            \
+  MACRO(vkAllocateCommandBuffers);                                             \
+  MACRO(vkQueueSubmit);                                                        \
+  MACRO(vkQueueSubmit2);                                                       \
+  MACRO(vkQueuePresentKHR);                                                    \
+  MACRO(vkBeginCommandBuffer);                                                 \
+  MACRO(vkEndCommandBuffer);                                                   \
+  MACRO(vkCmdBeginRenderPass);                                                 \
+  MACRO(vkCmdEndRenderPass);                                                   \
+  MACRO(vkCmdNextSubpass);                                                     \
+  MACRO(vkCmdBeginRendering);                                                  \
+  MACRO(vkCmdEndRendering);                                                    \
+  MACRO(vkCmdClearColorImage);                                                 \
+  MACRO(vkCmdBindPipeline);                                                    \
+  MACRO(vkCmdSetViewport);                                                     \
+  MACRO(vkCmdSetScissor);                                                      \
+  MACRO(vkCmdPipelineBarrier);                                                 \
+  MACRO(vkCmdPipelineBarrier2);                                                \
+  MACRO(vkCmdBindVertexBuffers);                                               \
+  MACRO(vkCmdBindIndexBuffer);                                                 \
+  MACRO(vkCmdBindDescriptorSets);                                              \
+  MACRO(vkCmdPushConstants);                                                   \
+  MACRO(vkCmdCopyBuffer);                                                      \
+  MACRO(vkCmdCopyBufferToImage);                                               \
+  MACRO(vkCmdCopyImageToBuffer);                                               \
+  MACRO(vkCmdBlitImage);                                                       \
+  MACRO(vkCmdDraw);                                                            \
+  MACRO(vkCmdDrawIndexed);                                                     \
+  MACRO(vkCmdDrawIndirect);                                                    \
+  MACRO(vkCmdDrawIndexedIndirect);                                             \
+  MACRO(vkCmdDrawIndexedIndirectCount);                                        \
+  MACRO(vkCmdDrawMultiEXT);                                                    \
+  MACRO(vkCmdDrawMultiIndexedEXT);                                             \
+  MACRO(vkCmdDispatch);                                                        \
+  MACRO(vkCmdExecuteCommands)
+
+Capture::Capture(Device &device, std::string const &path,
+                 DeviceCreateInfo const &deviceCreateInfo)
+    : device{device}, state{std::make_unique<State>()} {
+  if (active)
+    throw std::runtime_error("a capture is already active");
+
+  state->file.open(path, std::ios::binary | std::ios::trunc);
+  if (!state->file)
+    throw std::runtime_error("failed to open capture file " + path);
+  state->file.write((char const *)&captureMagic, sizeof(captureMagic));
+  state->file.write((char const *)&captureVersion, sizeof(captureVersion));
+
+  state->real = device;
+  state->memoryProps = device.physDev.memoryProps;
+  active = state.get();
+
+  auto &record = state->begin(CaptureOp::Device);
+  record.put(deviceCreateInfo.enabledFeatures,
+             deviceCreateInfo.enabledExtendedFeatures,
+             (uint32_t)deviceCreateInfo.enabledExtensions.size());
+  for (auto const &extension : deviceCreateInfo.enabledExtensions)
+    record.putString(extension.c_str());
+  state->end(record);
+
+  // Entry points of extensions that were not enabled stay null.
+#define HOOK(name)                                                             \
+  if (state->real.name)                                                        \
+  device.name = capture_##name
+  CAPTURE_DEFS(HOOK);
+#undef HOOK
+}
+
+Capture::~Capture() {
+  static_cast<DeviceDispatch &>(device) = state->real;
+  active = nullptr;
+}
+
+void Capture::frame() {
+  state->end(state->begin(CaptureOp::Frame));
+}
@@ -1,7 +1,11 @@
 #include <vkt/command_buffer.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
 
 CommandBuffer::CommandBuffer(std::shared_ptr<Device> device,
-                             CommandBufferAllocateInfo allocInfo) {
+                             CommandBufferAllocateInfo allocInfo)
+    : dispatch{*device} {
   this->device = device;
 
   VkCommandBufferAllocateInfo vk_allocInfo{
@@ -23,8 +27,6 @@ CommandBuffer::CommandBuffer(std::shared_ptr<Device> device,
         device.vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
       },
       device, allocInfo.commandPool);
-
-  loadFunctions();
 }
 
 CommandBuffer::operator VkCommandBuffer() {
@@ -32,108 +34,666 @@ CommandBuffer::operator VkCommandBuffer() {
 }
 
 void CommandBuffer::reset(VkCommandBufferResetFlags flags) {
-  VK_CHECK(vkResetCommandBuffer(commandBuffer, flags));
+  VK_CHECK(dispatch.vkResetCommandBuffer(commandBuffer, flags));
+  retained.clear();
+}
+
+Device &CommandBuffer::getDevice() const {
+  return *device;
 }
 
-void CommandBuffer::loadFunctions() {
-#define LOAD(name)                                                             \
-  this->name = (PFN_##name)vkGetDeviceProcAddr(*device, #name);                \
-  if (this->name == nullptr)                                                   \
-    throw std::runtime_error(#name);
+void CommandBuffer::retain(std::shared_ptr<void> const &object) {
+  if (retained.empty() || retained.back() != object)
+    retained.push_back(object);
+}
 
-  CMD_BUF_DEFS(LOAD);
-#undef LOAD
+void CommandBuffer::releaseRetained() {
+  retained.clear();
 }
 
 CommandBufferRecording::CommandBufferRecording(
     std::shared_ptr<CommandBuffer> commandBuffer,
     CommandBufferBeginInfo const &beginInfo) {
   this->commandBuffer = commandBuffer;
+  this->inheritanceInfo = beginInfo.inheritanceInfo;
+  this->synchronization2 =
+      commandBuffer->getDevice().getExtendedFeatures().synchronization2;
+  commandBuffer->retained.clear();
+
+  auto &pending = commandBuffer->pendingBarriers;
+  pending.dependencyFlags = {};
+  pending.memory.reset();
+  pending.buffers.clear();
+  pending.images.clear();
+
+  auto vk_inheritanceInfo = VkCommandBufferInheritanceInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+      .pNext = nullptr,
+      .renderPass = VK_NULL_HANDLE,
+      .subpass = 0,
+      .framebuffer = VK_NULL_HANDLE,
+      .occlusionQueryEnable = VK_FALSE,
+      .queryFlags = {},
+      .pipelineStatistics = {}};
+  auto vk_renderingInfo = VkCommandBufferInheritanceRenderingInfo{
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+      .pNext = nullptr,
+      .flags = {},
+      .viewMask = 0,
+      .colorAttachmentCount = 0,
+      .pColorAttachmentFormats = nullptr,
+      .depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+      .stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+      .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT};
+  if (inheritanceInfo.has_value()) {
+    if (inheritanceInfo->renderPass != nullptr)
+      vk_inheritanceInfo.renderPass = *inheritanceInfo->renderPass;
+    vk_inheritanceInfo.subpass = inheritanceInfo->subpass;
+    if (inheritanceInfo->framebuffer != nullptr)
+      vk_inheritanceInfo.framebuffer = *inheritanceInfo->framebuffer;
+
+    if (inheritanceInfo->renderingInfo.has_value()) {
+      auto const &renderingInfo = *inheritanceInfo->renderingInfo;
+      vk_renderingInfo.viewMask = renderingInfo.viewMask;
+      vk_renderingInfo.colorAttachmentCount =
+          (uint32_t)renderingInfo.colorAttachmentFormats.size();
+      vk_renderingInfo.pColorAttachmentFormats =
+          renderingInfo.colorAttachmentFormats.data();
+      vk_renderingInfo.depthAttachmentFormat =
+          renderingInfo.depthAttachmentFormat;
+      vk_renderingInfo.stencilAttachmentFormat =
+          renderingInfo.stencilAttachmentFormat;
+      vk_renderingInfo.rasterizationSamples =
+          inheritanceInfo->rasterizationSamples;
+      vk_inheritanceInfo.pNext = &vk_renderingInfo;
+    }
+  }
 
   auto vk_beginInfo = VkCommandBufferBeginInfo{
       .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
       .pNext = nullptr,
       .flags = beginInfo.flags,
-      .pInheritanceInfo = nullptr};
+      .pInheritanceInfo =
+          inheritanceInfo.has_value() ? &vk_inheritanceInfo : nullptr};
 
-  VK_CHECK(commandBuffer->vkBeginCommandBuffer(*commandBuffer, &vk_beginInfo));
+  VK_CHECK(commandBuffer->dispatch.vkBeginCommandBuffer(*commandBuffer,
+                                                        &vk_beginInfo));
 }
 
 CommandBufferRecording::~CommandBufferRecording() {
-  VK_CHECK(commandBuffer->vkEndCommandBuffer(*commandBuffer));
+  flushBarriers();
+  VK_CHECK(commandBuffer->dispatch.vkEndCommandBuffer(*commandBuffer));
 }
 
 void CommandBufferRecording::clearColorImage(
     VkImage image, VkImageLayout imageLayout, VkClearColorValue const &color,
-    std::vector<VkImageSubresourceRange> const &ranges) {
-  commandBuffer->vkCmdClearColorImage(*commandBuffer, image, imageLayout,
-                                      &color, (uint32_t)ranges.size(),
-                                      ranges.data());
+    std::span<VkImageSubresourceRange const> ranges) {
+  flushBarriers();
+  commandBuffer->dispatch.vkCmdClearColorImage(
+      *commandBuffer, image, imageLayout, &color, (uint32_t)ranges.size(),
+      ranges.data());
+}
+
+void CommandBufferRecording::clearColorImage(
+    VkImage image, VkImageLayout imageLayout, VkClearColorValue const &color,
+    std::initializer_list<VkImageSubresourceRange> ranges) {
+  clearColorImage(image, imageLayout, color,
+                  std::span<VkImageSubresourceRange const>(ranges));
+}
+
+void CommandBufferRecording::copyBuffer(VkBuffer source, VkBuffer dest,
+                                        std::span<VkBufferCopy const> regions) {
+  flushBarriers();
+  commandBuffer->dispatch.vkCmdCopyBuffer(*commandBuffer, source, dest,
+                                          (uint32_t)regions.size(),
+                                          regions.data());
 }
 
 void CommandBufferRecording::copyBuffer(
-    VkBuffer source, VkBuffer dest, std::vector<VkBufferCopy> const &regions) {
-  commandBuffer->vkCmdCopyBuffer(*commandBuffer, source, dest,
-                                 (uint32_t)regions.size(), regions.data());
+    VkBuffer source, VkBuffer dest,
+    std::initializer_list<VkBufferCopy> regions) {
+  copyBuffer(source, dest, std::span<VkBufferCopy const>(regions));
 }
 
 void CommandBufferRecording::bindDescriptorSets(
     VkPipelineBindPoint pipelineBindPoint, VkPipelineLayout layout,
-    uint32_t firstSet, std::vector<VkDescriptorSet> const &descriptorSets,
-    std::optional<std::vector<uint32_t>> const &dynamicOffsets) {
-  uint32_t dynamicOffsetCount = 0;
-  uint32_t const *pDynamicOffsets = nullptr;
-  if (dynamicOffsets.has_value()) {
-    dynamicOffsetCount = dynamicOffsets.value().size();
-    pDynamicOffsets = dynamicOffsets.value().data();
-  }
-  commandBuffer->vkCmdBindDescriptorSets(
+    uint32_t firstSet, std::span<VkDescriptorSet const> descriptorSets,
+    std::span<uint32_t const> dynamicOffsets) {
+  commandBuffer->dispatch.vkCmdBindDescriptorSets(
       *commandBuffer, pipelineBindPoint, layout, firstSet,
       (uint32_t)descriptorSets.size(), descriptorSets.data(),
-      dynamicOffsetCount, pDynamicOffsets);
+      (uint32_t)dynamicOffsets.size(), dynamicOffsets.data());
 }
 
-void CommandBufferRecording::pipelineBarrier(DependencyInfo const &depInfo) {
-  for (auto &memoryBarrier : depInfo.memoryBarriers) {
-    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-    memoryBarrier.pNext = nullptr;
+void CommandBufferRecording::bindDescriptorSets(
+    VkPipelineBindPoint pipelineBindPoint, VkPipelineLayout layout,
+    uint32_t firstSet, std::initializer_list<VkDescriptorSet> descriptorSets,
+    std::initializer_list<uint32_t> dynamicOffsets) {
+  bindDescriptorSets(pipelineBindPoint, layout, firstSet,
+                     std::span<VkDescriptorSet const>(descriptorSets),
+                     std::span<uint32_t const>(dynamicOffsets));
+}
+
+void CommandBufferRecording::pushConstants(VkPipelineLayout layout,
+                                           VkShaderStageFlags stageFlags,
+                                           uint32_t offset, uint32_t size,
+                                           void const *values) {
+  commandBuffer->dispatch.vkCmdPushConstants(*commandBuffer, layout,
+                                             stageFlags, offset, size, values);
+}
+
+// Source stages that wait for nothing and destination stages that block
+// nothing, which is what TOP_OF_PIPE and BOTTOM_OF_PIPE mean there.
+template <typename Barrier> static bool ordersNothing(Barrier const &barrier) {
+  return (barrier.srcStageMask & ~VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT) == 0 ||
+         (barrier.dstStageMask & ~VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT) == 0;
+}
+
+template <typename Barrier>
+static void mergeMasks(Barrier &into, Barrier const &barrier) {
+  into.srcStageMask |= barrier.srcStageMask;
+  into.srcAccessMask |= barrier.srcAccessMask;
+  into.dstStageMask |= barrier.dstStageMask;
+  into.dstAccessMask |= barrier.dstAccessMask;
+}
+
+template <typename Barrier>
+static void checkLegacyMasks(Barrier const &barrier) {
+  auto masks = barrier.srcStageMask | barrier.srcAccessMask |
+               barrier.dstStageMask | barrier.dstAccessMask;
+  if (masks >> 32 != 0)
+    throw std::runtime_error("barrier needs the synchronization2 feature");
+}
+
+static bool overlaps(uint64_t offsetA, uint64_t sizeA, uint64_t offsetB,
+                     uint64_t sizeB, uint64_t remaining) {
+  auto endA = sizeA == remaining ? UINT64_MAX : offsetA + sizeA;
+  auto endB = sizeB == remaining ? UINT64_MAX : offsetB + sizeB;
+  return offsetA < endB && offsetB < endA;
+}
+
+static bool overlaps(VkImageSubresourceRange const &a,
+                     VkImageSubresourceRange const &b) {
+  return (a.aspectMask & b.aspectMask) != 0 &&
+         overlaps(a.baseMipLevel, a.levelCount, b.baseMipLevel, b.levelCount,
+                  VK_REMAINING_MIP_LEVELS) &&
+         overlaps(a.baseArrayLayer, a.layerCount, b.baseArrayLayer,
+                  b.layerCount, VK_REMAINING_ARRAY_LAYERS);
+}
+
+// Meta stages such as ALL_COMMANDS share no bits with the stages they stand
+// for, so they are taken to intersect any stage.
+static bool stagesIntersect(VkPipelineStageFlags2 srcStageMask,
+                            VkPipelineStageFlags2 dstStageMask) {
+  auto src = srcStageMask & ~VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT;
+  auto dst = dstStageMask & ~VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT;
+  if (src == 0 || dst == 0)
+    return false;
+  auto meta = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT |
+              VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT |
+              VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT;
+  return (src & dst) != 0 || ((src | dst) & meta) != 0;
+}
+
+static bool sameRange(VkImageSubresourceRange const &a,
+                      VkImageSubresourceRange const &b) {
+  return a.aspectMask == b.aspectMask && a.baseMipLevel == b.baseMipLevel &&
+         a.levelCount == b.levelCount && a.baseArrayLayer == b.baseArrayLayer &&
+         a.layerCount == b.layerCount;
+}
+
+void CommandBufferRecording::batchWith(VkDependencyFlags dependencyFlags,
+                                       VkPipelineStageFlags2 srcStageMask) {
+  auto &pending = commandBuffer->pendingBarriers;
+  // Barriers of one command do not chain, so a barrier whose source stages
+  // wait on the batch's destination stages has to follow it.
+  VkPipelineStageFlags2 dstStageMask = 0;
+  if (pending.memory.has_value())
+    dstStageMask |= pending.memory->dstStageMask;
+  for (auto const &barrier : pending.buffers)
+    dstStageMask |= barrier.dstStageMask;
+  for (auto const &barrier : pending.images)
+    dstStageMask |= barrier.dstStageMask;
+
+  if (stagesIntersect(srcStageMask, dstStageMask))
+    flushBarriers();
+  if (dependencyFlags != pending.dependencyFlags) {
+    flushBarriers();
+    pending.dependencyFlags = dependencyFlags;
   }
+}
 
-  for (auto &bufferMemoryBarrier : depInfo.bufferMemoryBarriers) {
-    bufferMemoryBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-    bufferMemoryBarrier.pNext = nullptr;
+void CommandBufferRecording::barrier(VkMemoryBarrier2 const &memoryBarrier,
+                                     VkDependencyFlags dependencyFlags) {
+  if (!synchronization2)
+    checkLegacyMasks(memoryBarrier);
+  if (ordersNothing(memoryBarrier)) {
+    ++barrierCounts.dropped;
+    return;
   }
 
-  for (auto &imageMemoryBarrier : depInfo.imageMemoryBarriers) {
-    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    imageMemoryBarrier.pNext = nullptr;
+  batchWith(dependencyFlags, memoryBarrier.srcStageMask);
+  auto &memory = commandBuffer->pendingBarriers.memory;
+  if (memory.has_value()) {
+    mergeMasks(*memory, memoryBarrier);
+    ++barrierCounts.merged;
+    return;
   }
+  memory = memoryBarrier;
+  memory->sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+  memory->pNext = nullptr;
+}
 
-  commandBuffer->vkCmdPipelineBarrier(
-      *commandBuffer, depInfo.srcStageMask, depInfo.dstStageMask,
-      depInfo.dependencyFlags, (uint32_t)depInfo.memoryBarriers.size(),
-      depInfo.memoryBarriers.data(),
-      (uint32_t)depInfo.bufferMemoryBarriers.size(),
-      depInfo.bufferMemoryBarriers.data(),
-      (uint32_t)depInfo.imageMemoryBarriers.size(),
-      depInfo.imageMemoryBarriers.data());
+void CommandBufferRecording::barrier(
+    VkBufferMemoryBarrier2 const &bufferMemoryBarrier,
+    VkDependencyFlags dependencyFlags) {
+  auto const &barrier = bufferMemoryBarrier;
+  if (!synchronization2)
+    checkLegacyMasks(barrier);
+  auto transfersOwnership =
+      barrier.srcQueueFamilyIndex != barrier.dstQueueFamilyIndex;
+  if (!transfersOwnership && ordersNothing(barrier)) {
+    ++barrierCounts.dropped;
+    return;
+  }
+
+  batchWith(dependencyFlags, barrier.srcStageMask);
+  auto &buffers = commandBuffer->pendingBarriers.buffers;
+  for (auto &other : buffers) {
+    if (other.buffer != barrier.buffer)
+      continue;
+
+    auto sameFamilies =
+        other.srcQueueFamilyIndex == barrier.srcQueueFamilyIndex &&
+        other.dstQueueFamilyIndex == barrier.dstQueueFamilyIndex;
+    if (sameFamilies && !transfersOwnership) {
+      auto offset = std::min(other.offset, barrier.offset);
+      auto size = VK_WHOLE_SIZE;
+      if (other.size != VK_WHOLE_SIZE && barrier.size != VK_WHOLE_SIZE)
+        size = std::max(other.offset + other.size,
+                        barrier.offset + barrier.size) -
+               offset;
+
+      // The widened range may reach barriers that neither range overlapped.
+      auto reachesAnother = std::any_of(
+          buffers.begin(), buffers.end(),
+          [&](VkBufferMemoryBarrier2 const &another) -> bool {
+            return &another != &other && another.buffer == barrier.buffer &&
+                   overlaps(another.offset, another.size, offset, size,
+                            VK_WHOLE_SIZE);
+          });
+      if (reachesAnother) {
+        flushBarriers();
+        break;
+      }
+
+      other.offset = offset;
+      other.size = size;
+      mergeMasks(other, barrier);
+      ++barrierCounts.merged;
+      return;
+    }
+    if (sameFamilies && other.offset == barrier.offset &&
+        other.size == barrier.size) {
+      mergeMasks(other, barrier);
+      ++barrierCounts.merged;
+      return;
+    }
+    if (overlaps(other.offset, other.size, barrier.offset, barrier.size,
+                 VK_WHOLE_SIZE)) {
+      flushBarriers();
+      break;
+    }
+  }
+
+  buffers.push_back(barrier);
+  buffers.back().sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+  buffers.back().pNext = nullptr;
+}
+
+void CommandBufferRecording::barrier(
+    VkImageMemoryBarrier2 const &imageMemoryBarrier,
+    VkDependencyFlags dependencyFlags) {
+  auto const &barrier = imageMemoryBarrier;
+  if (!synchronization2)
+    checkLegacyMasks(barrier);
+  auto transfersOwnership =
+      barrier.srcQueueFamilyIndex != barrier.dstQueueFamilyIndex;
+  if (!transfersOwnership && barrier.oldLayout == barrier.newLayout &&
+      ordersNothing(barrier)) {
+    ++barrierCounts.dropped;
+    return;
+  }
+
+  batchWith(dependencyFlags, barrier.srcStageMask);
+  auto &images = commandBuffer->pendingBarriers.images;
+  for (auto &other : images) {
+    if (other.image != barrier.image ||
+        !overlaps(other.subresourceRange, barrier.subresourceRange))
+      continue;
+
+    // Barriers of one command are unordered, so a barrier can only follow
+    // another on the same subresources by becoming part of it.
+    auto sameSubresources =
+        sameRange(other.subresourceRange, barrier.subresourceRange);
+    auto otherTransfersOwnership =
+        other.srcQueueFamilyIndex != other.dstQueueFamilyIndex;
+    auto merges = false;
+    if (transfersOwnership)
+      merges = sameSubresources &&
+               other.srcQueueFamilyIndex == barrier.srcQueueFamilyIndex &&
+               other.dstQueueFamilyIndex == barrier.dstQueueFamilyIndex &&
+               other.oldLayout == barrier.oldLayout &&
+               other.newLayout == barrier.newLayout;
+    else
+      merges = sameSubresources && !otherTransfersOwnership &&
+               (barrier.oldLayout == other.newLayout ||
+                barrier.oldLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+    if (merges) {
+      mergeMasks(other, barrier);
+      other.newLayout = barrier.newLayout;
+      ++barrierCounts.merged;
+      return;
+    }
+    flushBarriers();
+    break;
+  }
+
+  images.push_back(barrier);
+  images.back().sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+  images.back().pNext = nullptr;
+}
+
+void CommandBufferRecording::flushBarriers() {
+  auto &pending = commandBuffer->pendingBarriers;
+  auto count = (uint32_t)(pending.memory.has_value() + pending.buffers.size() +
+                          pending.images.size());
+  if (count == 0)
+    return;
+
+  if (synchronization2) {
+    auto dependencyInfo = VkDependencyInfo{
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = nullptr,
+        .dependencyFlags = pending.dependencyFlags,
+        .memoryBarrierCount = pending.memory.has_value() ? 1u : 0u,
+        .pMemoryBarriers =
+            pending.memory.has_value() ? &*pending.memory : nullptr,
+        .bufferMemoryBarrierCount = (uint32_t)pending.buffers.size(),
+        .pBufferMemoryBarriers = pending.buffers.data(),
+        .imageMemoryBarrierCount = (uint32_t)pending.images.size(),
+        .pImageMemoryBarriers = pending.images.data()};
+    commandBuffer->dispatch.vkCmdPipelineBarrier2(*commandBuffer,
+                                                  &dependencyInfo);
+  } else {
+    flushLegacyBarriers();
+  }
+
+  ++barrierCounts.batches;
+  barrierCounts.barriers += count;
+  pending.memory.reset();
+  pending.buffers.clear();
+  pending.images.clear();
+}
+
+void CommandBufferRecording::flushLegacyBarriers() {
+  auto &pending = commandBuffer->pendingBarriers;
+  VkPipelineStageFlags2 srcStageMask = 0, dstStageMask = 0;
+
+  auto memoryBarrier =
+      VkMemoryBarrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                      .pNext = nullptr,
+                      .srcAccessMask = {},
+                      .dstAccessMask = {}};
+  if (pending.memory.has_value()) {
+    srcStageMask |= pending.memory->srcStageMask;
+    dstStageMask |= pending.memory->dstStageMask;
+    memoryBarrier.srcAccessMask = (VkAccessFlags)pending.memory->srcAccessMask;
+    memoryBarrier.dstAccessMask = (VkAccessFlags)pending.memory->dstAccessMask;
+  }
+
+  pending.legacyBuffers.clear();
+  for (auto const &barrier : pending.buffers) {
+    srcStageMask |= barrier.srcStageMask;
+    dstStageMask |= barrier.dstStageMask;
+    pending.legacyBuffers.push_back(VkBufferMemoryBarrier{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = (VkAccessFlags)barrier.srcAccessMask,
+        .dstAccessMask = (VkAccessFlags)barrier.dstAccessMask,
+        .srcQueueFamilyIndex = barrier.srcQueueFamilyIndex,
+        .dstQueueFamilyIndex = barrier.dstQueueFamilyIndex,
+        .buffer = barrier.buffer,
+        .offset = barrier.offset,
+        .size = barrier.size});
+  }
+
+  pending.legacyImages.clear();
+  for (auto const &barrier : pending.images) {
+    srcStageMask |= barrier.srcStageMask;
+    dstStageMask |= barrier.dstStageMask;
+    pending.legacyImages.push_back(VkImageMemoryBarrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = (VkAccessFlags)barrier.srcAccessMask,
+        .dstAccessMask = (VkAccessFlags)barrier.dstAccessMask,
+        .oldLayout = barrier.oldLayout,
+        .newLayout = barrier.newLayout,
+        .srcQueueFamilyIndex = barrier.srcQueueFamilyIndex,
+        .dstQueueFamilyIndex = barrier.dstQueueFamilyIndex,
+        .image = barrier.image,
+        .subresourceRange = barrier.subresourceRange});
+  }
+
+  // Unlike in synchronization2, empty stage masks are not allowed.
+  if (srcStageMask == 0)
+    srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+  if (dstStageMask == 0)
+    dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+  commandBuffer->dispatch.vkCmdPipelineBarrier(
+      *commandBuffer, (VkPipelineStageFlags)srcStageMask,
+      (VkPipelineStageFlags)dstStageMask, pending.dependencyFlags,
+      pending.memory.has_value() ? 1 : 0, &memoryBarrier,
+      (uint32_t)pending.legacyBuffers.size(), pending.legacyBuffers.data(),
+      (uint32_t)pending.legacyImages.size(), pending.legacyImages.data());
+}
+
+void CommandBufferRecording::pipelineBarrier(DependencyInfo const &depInfo) {
+  auto srcStageMask = (VkPipelineStageFlags2)depInfo.srcStageMask;
+  auto dstStageMask = (VkPipelineStageFlags2)depInfo.dstStageMask;
+  auto flags = depInfo.dependencyFlags;
+
+  if (depInfo.memoryBarriers.empty() && depInfo.bufferMemoryBarriers.empty() &&
+      depInfo.imageMemoryBarriers.empty())
+    barrier(VkMemoryBarrier2{.srcStageMask = srcStageMask,
+                             .srcAccessMask = {},
+                             .dstStageMask = dstStageMask,
+                             .dstAccessMask = {}},
+            flags);
+
+  for (auto const &memoryBarrier : depInfo.memoryBarriers)
+    barrier(VkMemoryBarrier2{.srcStageMask = srcStageMask,
+                             .srcAccessMask = memoryBarrier.srcAccessMask,
+                             .dstStageMask = dstStageMask,
+                             .dstAccessMask = memoryBarrier.dstAccessMask},
+            flags);
+
+  for (auto const &bufferBarrier : depInfo.bufferMemoryBarriers)
+    barrier(
+        VkBufferMemoryBarrier2{
+            .srcStageMask = srcStageMask,
+            .srcAccessMask = bufferBarrier.srcAccessMask,
+            .dstStageMask = dstStageMask,
+            .dstAccessMask = bufferBarrier.dstAccessMask,
+            .srcQueueFamilyIndex = bufferBarrier.srcQueueFamilyIndex,
+            .dstQueueFamilyIndex = bufferBarrier.dstQueueFamilyIndex,
+            .buffer = bufferBarrier.buffer,
+            .offset = bufferBarrier.offset,
+            .size = bufferBarrier.size},
+        flags);
+
+  for (auto const &imageBarrier : depInfo.imageMemoryBarriers)
+    barrier(
+        VkImageMemoryBarrier2{
+            .srcStageMask = srcStageMask,
+            .srcAccessMask = imageBarrier.srcAccessMask,
+            .dstStageMask = dstStageMask,
+            .dstAccessMask = imageBarrier.dstAccessMask,
+            .oldLayout = imageBarrier.oldLayout,
+            .newLayout = imageBarrier.newLayout,
+            .srcQueueFamilyIndex = imageBarrier.srcQueueFamilyIndex,
+            .dstQueueFamilyIndex = imageBarrier.dstQueueFamilyIndex,
+            .image = imageBarrier.image,
+            .subresourceRange = imageBarrier.subresourceRange},
+        flags);
+}
+void CommandBufferRecording::pipelineBarrier(
+    VkPipelineStageFlags srcStageMask, VkPipelineStageFlags dstStageMask,
+    VkDependencyFlags dependencyFlags,
+    std::span<VkMemoryBarrier const> memoryBarriers,
+    std::span<VkBufferMemoryBarrier const> bufferMemoryBarriers,
+    std::span<VkImageMemoryBarrier const> imageMemoryBarriers) {
+  flushBarriers();
+  commandBuffer->dispatch.vkCmdPipelineBarrier(
+      *commandBuffer, srcStageMask, dstStageMask, dependencyFlags,
+      (uint32_t)memoryBarriers.size(), memoryBarriers.data(),
+      (uint32_t)bufferMemoryBarriers.size(), bufferMemoryBarriers.data(),
+      (uint32_t)imageMemoryBarriers.size(), imageMemoryBarriers.data());
 }
 
 void CommandBufferRecording::copyBufferToImage(
     CopyBufferToImageInfo const &copyInfo) {
-  commandBuffer->vkCmdCopyBufferToImage(
+  flushBarriers();
+  commandBuffer->dispatch.vkCmdCopyBufferToImage(
       *commandBuffer, copyInfo.srcBuffer, copyInfo.dstImage,
       copyInfo.dstImageLayout, (uint32_t)copyInfo.regions.size(),
       copyInfo.regions.data());
 }
 
+void CommandBufferRecording::copyImageToBuffer(
+    CopyImageToBufferInfo const &copyInfo) {
+  flushBarriers();
+  commandBuffer->dispatch.vkCmdCopyImageToBuffer(
+      *commandBuffer, copyInfo.srcImage, copyInfo.srcImageLayout,
+      copyInfo.dstBuffer, (uint32_t)copyInfo.regions.size(),
+      copyInfo.regions.data());
+}
+
+void CommandBufferRecording::blitImage(BlitImageInfo const &blitInfo) {
+  flushBarriers();
+  commandBuffer->dispatch.vkCmdBlitImage(
+      *commandBuffer, blitInfo.srcImage, blitInfo.srcImageLayout,
+      blitInfo.dstImage, blitInfo.dstImageLayout,
+      (uint32_t)blitInfo.regions.size(), blitInfo.regions.data(),
+      blitInfo.filter);
+}
+
+void CommandBufferRecording::bindPipeline(VkPipelineBindPoint pipelineBindPoint,
+                                          VkPipeline pipeline) {
+  commandBuffer->dispatch.vkCmdBindPipeline(*commandBuffer, pipelineBindPoint,
+                                            pipeline);
+}
+
+void CommandBufferRecording::dispatch(uint32_t groupCountX,
+                                      uint32_t groupCountY,
+                                      uint32_t groupCountZ) {
+  flushBarriers();
+  commandBuffer->dispatch.vkCmdDispatch(*commandBuffer, groupCountX,
+                                        groupCountY, groupCountZ);
+}
+
+// Secondary buffers are passed to vkCmdExecuteCommands in batches so that
+// no temporary array has to be allocated.
+static void executeSecondaries(
+    CommandBuffer &commandBuffer,
+    std::span<std::shared_ptr<CommandBuffer> const> secondaries) {
+  std::array<VkCommandBuffer, 16> batch;
+  for (size_t done = 0; done < secondaries.size(); done += batch.size()) {
+    auto count = std::min(secondaries.size() - done, batch.size());
+    for (size_t i = 0; i < count; ++i) {
+      commandBuffer.retain(secondaries[done + i]);
+      batch[i] = *secondaries[done + i];
+    }
+    commandBuffer.dispatch.vkCmdExecuteCommands(commandBuffer,
+                                                (uint32_t)count, batch.data());
+  }
+}
+
+void CommandBufferRecording::executeCommands(
+    std::span<std::shared_ptr<CommandBuffer> const> commandBuffers) {
+  flushBarriers();
+  executeSecondaries(*commandBuffer, commandBuffers);
+}
+
+void CommandBufferRecording::executeCommands(
+    std::initializer_list<std::shared_ptr<CommandBuffer>> commandBuffers) {
+  flushBarriers();
+  executeSecondaries(*commandBuffer, commandBuffers);
+}
+
+BarrierCounts const &CommandBufferRecording::getBarrierCounts() const {
+  return barrierCounts;
+}
+
+CommandBufferRenderPass::CommandBufferRenderPass(
+    std::shared_ptr<CommandBufferRecording> recording,
+    RenderPassBeginInfo const &renderPassInfo)
+    : commandBuffer{*recording->commandBuffer}, ownedRecording{recording} {
+  recording->flushBarriers();
+  begin(renderPassInfo);
+}
+
+CommandBufferRenderPass::CommandBufferRenderPass(
+    CommandBufferRecording &recording,
+    RenderPassBeginInfo const &renderPassInfo)
+    : commandBuffer{*recording.commandBuffer} {
+  recording.flushBarriers();
+  begin(renderPassInfo);
+}
+
 CommandBufferRenderPass::CommandBufferRenderPass(
     std::shared_ptr<CommandBufferRecording> recording,
-    RenderPassBeginInfo const &renderPassInfo) {
-  this->commandBuffer = recording->commandBuffer;
-  boundRefs.push_back(renderPassInfo.renderPass);
-  boundRefs.push_back(recording);
-  boundRefs.push_back(renderPassInfo.framebuffer);
+    RenderingInfo const &renderingInfo)
+    : commandBuffer{*recording->commandBuffer}, ownedRecording{recording} {
+  recording->flushBarriers();
+  begin(renderingInfo);
+}
+
+CommandBufferRenderPass::CommandBufferRenderPass(
+    CommandBufferRecording &recording, RenderingInfo const &renderingInfo)
+    : commandBuffer{*recording.commandBuffer} {
+  recording.flushBarriers();
+  begin(renderingInfo);
+}
+
+CommandBufferRenderPass::CommandBufferRenderPass(
+    std::shared_ptr<CommandBufferRecording> recording)
+    : CommandBufferRenderPass(*recording) {
+  ownedRecording = recording;
+}
+
+CommandBufferRenderPass::CommandBufferRenderPass(
+    CommandBufferRecording &recording)
+    : commandBuffer{*recording.commandBuffer} {
+  if (!recording.inheritanceInfo.has_value())
+    throw std::runtime_error("recording does not continue a render pass");
+  recording.flushBarriers();
+  continued = true;
+}
+
+CommandBufferRenderPass::~CommandBufferRenderPass() {
+  if (continued)
+    return;
+  if (dynamicRendering)
+    commandBuffer.dispatch.vkCmdEndRendering(commandBuffer);
+  else
+    commandBuffer.dispatch.vkCmdEndRenderPass(commandBuffer);
+}
+
+void CommandBufferRenderPass::begin(RenderPassBeginInfo const &renderPassInfo) {
+  commandBuffer.retain(renderPassInfo.renderPass);
+  commandBuffer.retain(renderPassInfo.framebuffer);
 
   auto vk_renderPassInfo = VkRenderPassBeginInfo{
       .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
@@ -145,49 +705,237 @@ CommandBufferRenderPass::CommandBufferRenderPass(
 
   };
 
-  commandBuffer->vkCmdBeginRenderPass(*commandBuffer, &vk_renderPassInfo,
-                                      renderPassInfo.subpassContents);
+  commandBuffer.dispatch.vkCmdBeginRenderPass(
+      commandBuffer, &vk_renderPassInfo, renderPassInfo.subpassContents);
 }
 
-CommandBufferRenderPass::~CommandBufferRenderPass() {
-  commandBuffer->vkCmdEndRenderPass(*commandBuffer);
+void CommandBufferRenderPass::begin(RenderingInfo const &renderingInfo) {
+  dynamicRendering = true;
+
+  auto attachment = [&](RenderingAttachmentInfo const &info) {
+    commandBuffer.retain(info.imageView);
+    if (info.resolveImageView != nullptr)
+      commandBuffer.retain(info.resolveImageView);
+    return VkRenderingAttachmentInfo{
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .pNext = nullptr,
+        .imageView = *info.imageView,
+        .imageLayout = info.imageLayout,
+        .resolveMode = info.resolveMode,
+        .resolveImageView = info.resolveImageView != nullptr
+                                ? (VkImageView)*info.resolveImageView
+                                : VK_NULL_HANDLE,
+        .resolveImageLayout = info.resolveImageLayout,
+        .loadOp = info.loadOp,
+        .storeOp = info.storeOp,
+        .clearValue = info.clearValue};
+  };
+
+  // Implementations support at least 4 and usually 8 color attachments.
+  std::array<VkRenderingAttachmentInfo, 8> colorAttachments;
+  if (renderingInfo.colorAttachments.size() > colorAttachments.size())
+    throw std::runtime_error("too many color attachments");
+  for (size_t i = 0; i < renderingInfo.colorAttachments.size(); ++i)
+    colorAttachments[i] = attachment(renderingInfo.colorAttachments[i]);
+
+  VkRenderingAttachmentInfo depthAttachment, stencilAttachment;
+  if (renderingInfo.depthAttachment.has_value())
+    depthAttachment = attachment(*renderingInfo.depthAttachment);
+  if (renderingInfo.stencilAttachment.has_value())
+    stencilAttachment = attachment(*renderingInfo.stencilAttachment);
+
+  auto vk_renderingInfo = VkRenderingInfo{
+      .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+      .pNext = nullptr,
+      .flags = renderingInfo.flags,
+      .renderArea = renderingInfo.renderArea,
+      .layerCount = renderingInfo.layerCount,
+      .viewMask = renderingInfo.viewMask,
+      .colorAttachmentCount = (uint32_t)renderingInfo.colorAttachments.size(),
+      .pColorAttachments = colorAttachments.data(),
+      .pDepthAttachment =
+          renderingInfo.depthAttachment.has_value() ? &depthAttachment
+                                                    : nullptr,
+      .pStencilAttachment = renderingInfo.stencilAttachment.has_value()
+                                ? &stencilAttachment
+                                : nullptr};
+
+  commandBuffer.dispatch.vkCmdBeginRendering(commandBuffer, &vk_renderingInfo);
 }
 
 void CommandBufferRenderPass::bindPipeline(
-    std::shared_ptr<GraphicsPipeline> pipeline) {
-  boundRefs.push_back(pipeline);
-  commandBuffer->vkCmdBindPipeline(*commandBuffer,
-                                   VK_PIPELINE_BIND_POINT_GRAPHICS, *pipeline);
+    std::shared_ptr<GraphicsPipeline> const &pipeline) {
+  commandBuffer.retain(pipeline);
+  auto viewport = bound.viewport;
+  auto scissor = bound.scissor;
+  bindPipeline(*pipeline);
+
+  // Dynamic state survives binding a pipeline that declares it dynamic.
+  if (pipeline->hasDynamicState(VK_DYNAMIC_STATE_VIEWPORT))
+    bound.viewport = viewport;
+  if (pipeline->hasDynamicState(VK_DYNAMIC_STATE_SCISSOR))
+    bound.scissor = scissor;
+}
+
+void CommandBufferRenderPass::bindPipeline(VkPipeline pipeline) {
+  if (pipeline == bound.pipeline) {
+    ++elided.pipelines;
+    return;
+  }
+  bound.pipeline = pipeline;
+  // A pipeline with a static viewport or scissor overwrites the dynamic one.
+  bound.viewport.reset();
+  bound.scissor.reset();
+
+  commandBuffer.dispatch.vkCmdBindPipeline(
+      commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+}
+
+void CommandBufferRenderPass::bindDescriptorSets(
+    VkPipelineLayout layout, uint32_t firstSet,
+    std::span<VkDescriptorSet const> descriptorSets,
+    std::span<uint32_t const> dynamicOffsets) {
+  if (layout != bound.layout) {
+    bound.layout = layout;
+    bound.descriptorSets = {};
+  }
+
+  auto isBound = [&](size_t i) {
+    auto set = firstSet + i;
+    return set < maxTrackedSets &&
+           bound.descriptorSets[set] == descriptorSets[i];
+  };
+
+  // Only the sets between the first and last ones that differ are bound.
+  size_t first = 0, last = descriptorSets.size();
+  if (dynamicOffsets.empty()) {
+    while (first < last && isBound(first))
+      ++first;
+    while (last > first && isBound(last - 1))
+      --last;
+  }
+  if (first == last) {
+    ++elided.descriptorSets;
+    return;
+  }
+
+  // Sets bound with dynamic offsets are forgotten, as a later bind of the
+  // same set may use different offsets.
+  for (auto i = first; i < last; ++i)
+    if (firstSet + i < maxTrackedSets)
+      bound.descriptorSets[firstSet + i] =
+          dynamicOffsets.empty() ? descriptorSets[i] : VK_NULL_HANDLE;
+
+  commandBuffer.dispatch.vkCmdBindDescriptorSets(
+      commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout,
+      firstSet + (uint32_t)first, (uint32_t)(last - first),
+      descriptorSets.data() + first, (uint32_t)dynamicOffsets.size(),
+      dynamicOffsets.data());
+}
+
+void CommandBufferRenderPass::bindDescriptorSets(
+    VkPipelineLayout layout, uint32_t firstSet,
+    std::initializer_list<VkDescriptorSet> descriptorSets,
+    std::initializer_list<uint32_t> dynamicOffsets) {
+  bindDescriptorSets(layout, firstSet,
+                     std::span<VkDescriptorSet const>(descriptorSets),
+                     std::span<uint32_t const>(dynamicOffsets));
+}
+
+void CommandBufferRenderPass::pushConstants(VkPipelineLayout layout,
+                                            VkShaderStageFlags stageFlags,
+                                            uint32_t offset, uint32_t size,
+                                            void const *values) {
+  commandBuffer.dispatch.vkCmdPushConstants(commandBuffer, layout, stageFlags,
+                                            offset, size, values);
 }
 
 void CommandBufferRenderPass::setViewport(VkViewport const &viewport) {
-  commandBuffer->vkCmdSetViewport(*commandBuffer, 0, 1, &viewport);
+  if (bound.viewport.has_value() &&
+      std::memcmp(&*bound.viewport, &viewport, sizeof(viewport)) == 0) {
+    ++elided.viewports;
+    return;
+  }
+  bound.viewport = viewport;
+
+  commandBuffer.dispatch.vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 }
 
 void CommandBufferRenderPass::setScissor(VkRect2D const &scissor) {
-  commandBuffer->vkCmdSetScissor(*commandBuffer, 0, 1, &scissor);
+  if (bound.scissor.has_value() &&
+      std::memcmp(&*bound.scissor, &scissor, sizeof(scissor)) == 0) {
+    ++elided.scissors;
+    return;
+  }
+  bound.scissor = scissor;
+
+  commandBuffer.dispatch.vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 }
 
 void CommandBufferRenderPass::draw(uint32_t vertexCount, uint32_t instanceCount,
                                    uint32_t firstVertex,
                                    uint32_t firstInstance) {
-  commandBuffer->vkCmdDraw(*commandBuffer, vertexCount, instanceCount,
-                           firstVertex, firstInstance);
+  commandBuffer.dispatch.vkCmdDraw(commandBuffer, vertexCount, instanceCount,
+                                   firstVertex, firstInstance);
 }
 
 void CommandBufferRenderPass::bindVertexBuffers(
-    std::vector<std::pair<std::shared_ptr<Buffer>, VkDeviceSize>> const
-        &buffersAndOffsets) {
-  std::vector<VkBuffer> vk_buffers;
-  std::vector<VkDeviceSize> vk_offsets;
-  for (auto const &[buffer, offset] : buffersAndOffsets) {
-    vk_buffers.push_back(*buffer);
-    vk_offsets.push_back(offset);
+    std::span<std::pair<std::shared_ptr<Buffer>, VkDeviceSize> const>
+        buffersAndOffsets) {
+  std::array<VkBuffer, 16> buffers;
+  std::array<VkDeviceSize, 16> offsets;
+  for (size_t done = 0; done < buffersAndOffsets.size();
+       done += buffers.size()) {
+    auto count = std::min(buffersAndOffsets.size() - done, buffers.size());
+    for (size_t i = 0; i < count; ++i) {
+      auto const &[buffer, offset] = buffersAndOffsets[done + i];
+      commandBuffer.retain(buffer);
+      buffers[i] = *buffer;
+      offsets[i] = offset;
+    }
+    bindVertexBuffers((uint32_t)done, std::span(buffers.data(), count),
+                      std::span(offsets.data(), count));
+  }
+}
+
+void CommandBufferRenderPass::bindVertexBuffers(
+    std::initializer_list<std::pair<std::shared_ptr<Buffer>, VkDeviceSize>>
+        buffersAndOffsets) {
+  bindVertexBuffers(
+      std::span<std::pair<std::shared_ptr<Buffer>, VkDeviceSize> const>(
+          buffersAndOffsets));
+}
+
+void CommandBufferRenderPass::bindVertexBuffers(
+    uint32_t firstBinding, std::span<VkBuffer const> buffers,
+    std::span<VkDeviceSize const> offsets) {
+  auto isBound = [&](size_t i) {
+    auto binding = firstBinding + i;
+    return binding < maxTrackedBindings &&
+           bound.vertexBuffers[binding] == buffers[i] &&
+           bound.vertexOffsets[binding] == offsets[i];
   };
 
-  commandBuffer->vkCmdBindVertexBuffers(*commandBuffer, 0,
-                                        buffersAndOffsets.size(),
-                                        vk_buffers.data(), vk_offsets.data());
+  size_t first = 0, last = buffers.size();
+  while (first < last && isBound(first))
+    ++first;
+  while (last > first && isBound(last - 1))
+    --last;
+  if (first == last) {
+    ++elided.vertexBuffers;
+    return;
+  }
+
+  for (auto i = first; i < last; ++i) {
+    if (firstBinding + i < maxTrackedBindings) {
+      bound.vertexBuffers[firstBinding + i] = buffers[i];
+      bound.vertexOffsets[firstBinding + i] = offsets[i];
+    }
+  }
+
+  commandBuffer.dispatch.vkCmdBindVertexBuffers(
+      commandBuffer, firstBinding + (uint32_t)first, (uint32_t)(last - first),
+      buffers.data() + first, offsets.data() + first);
 }
 
 void CommandBufferRenderPass::drawIndexed(uint32_t indexCount,
@@ -195,17 +943,106 @@ void CommandBufferRenderPass::drawIndexed(uint32_t indexCount,
                                           uint32_t firstIndex,
                                           int32_t vertexOffset,
                                           uint32_t firstInstance) {
-  commandBuffer->vkCmdDrawIndexed(*commandBuffer, indexCount, instanceCount,
-                                  firstIndex, vertexOffset, firstInstance);
+  commandBuffer.dispatch.vkCmdDrawIndexed(commandBuffer, indexCount,
+                                          instanceCount, firstIndex,
+                                          vertexOffset, firstInstance);
+}
+
+void CommandBufferRenderPass::drawIndirect(VkBuffer buffer,
+                                           VkDeviceSize offset,
+                                           uint32_t drawCount,
+                                           uint32_t stride) {
+  commandBuffer.dispatch.vkCmdDrawIndirect(commandBuffer, buffer, offset,
+                                           drawCount, stride);
+}
+
+void CommandBufferRenderPass::drawIndexedIndirect(VkBuffer buffer,
+                                                  VkDeviceSize offset,
+                                                  uint32_t drawCount,
+                                                  uint32_t stride) {
+  commandBuffer.dispatch.vkCmdDrawIndexedIndirect(commandBuffer, buffer,
+                                                  offset, drawCount, stride);
+}
+
+void CommandBufferRenderPass::drawIndexedIndirectCount(
+    VkBuffer buffer, VkDeviceSize offset, VkBuffer countBuffer,
+    VkDeviceSize countOffset, uint32_t maxDrawCount, uint32_t stride) {
+  commandBuffer.dispatch.vkCmdDrawIndexedIndirectCount(
+      commandBuffer, buffer, offset, countBuffer, countOffset, maxDrawCount,
+      stride);
+}
+
+void CommandBufferRenderPass::drawMulti(
+    std::span<VkMultiDrawInfoEXT const> draws, uint32_t instanceCount,
+    uint32_t firstInstance) {
+  auto maxCount = commandBuffer.getDevice().getMaxMultiDrawCount();
+  if (maxCount == 0) {
+    for (auto const &info : draws)
+      draw(info.vertexCount, instanceCount, info.firstVertex, firstInstance);
+    return;
+  }
+
+  for (size_t done = 0; done < draws.size(); done += maxCount) {
+    auto count = std::min<size_t>(draws.size() - done, maxCount);
+    commandBuffer.dispatch.vkCmdDrawMultiEXT(
+        commandBuffer, (uint32_t)count, draws.data() + done, instanceCount,
+        firstInstance, sizeof(VkMultiDrawInfoEXT));
+  }
+}
+
+void CommandBufferRenderPass::drawMultiIndexed(
+    std::span<VkMultiDrawIndexedInfoEXT const> draws, uint32_t instanceCount,
+    uint32_t firstInstance) {
+  auto maxCount = commandBuffer.getDevice().getMaxMultiDrawCount();
+  if (maxCount == 0) {
+    for (auto const &info : draws)
+      drawIndexed(info.indexCount, instanceCount, info.firstIndex,
+                  info.vertexOffset, firstInstance);
+    return;
+  }
+
+  for (size_t done = 0; done < draws.size(); done += maxCount) {
+    auto count = std::min<size_t>(draws.size() - done, maxCount);
+    commandBuffer.dispatch.vkCmdDrawMultiIndexedEXT(
+        commandBuffer, (uint32_t)count, draws.data() + done, instanceCount,
+        firstInstance, sizeof(VkMultiDrawIndexedInfoEXT), nullptr);
+  }
 }
 
 void CommandBufferRenderPass::bindIndexBuffer(VkBuffer buffer,
                                               VkDeviceSize offset,
                                               VkIndexType indexType) {
-  commandBuffer->vkCmdBindIndexBuffer(*commandBuffer, buffer, offset,
-                                      indexType);
+  if (buffer == bound.indexBuffer && offset == bound.indexOffset &&
+      indexType == bound.indexType) {
+    ++elided.indexBuffers;
+    return;
+  }
+  bound.indexBuffer = buffer;
+  bound.indexOffset = offset;
+  bound.indexType = indexType;
+
+  commandBuffer.dispatch.vkCmdBindIndexBuffer(commandBuffer, buffer, offset,
+                                              indexType);
 }
 
 void CommandBufferRenderPass::nextSubpass(VkSubpassContents contents) {
-  commandBuffer->vkCmdNextSubpass(*commandBuffer, contents);
+  commandBuffer.dispatch.vkCmdNextSubpass(commandBuffer, contents);
+  bound = {};
+}
+
+// Secondary command buffers leave the primary's state undefined.
+void CommandBufferRenderPass::executeCommands(
+    std::span<std::shared_ptr<CommandBuffer> const> commandBuffers) {
+  executeSecondaries(commandBuffer, commandBuffers);
+  bound = {};
+}
+
+void CommandBufferRenderPass::executeCommands(
+    std::initializer_list<std::shared_ptr<CommandBuffer>> commandBuffers) {
+  executeSecondaries(commandBuffer, commandBuffers);
+  bound = {};
+}
+
+ElidedStateCounts const &CommandBufferRenderPass::getElidedCounts() const {
+  return elided;
 }
\ No newline at end of file
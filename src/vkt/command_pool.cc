@@ -25,3 +25,7 @@ CommandPool::CommandPool(std::shared_ptr<Device> device,
 CommandPool::operator VkCommandPool() {
   return commandPool;
 }
+
+void CommandPool::reset(VkCommandPoolResetFlags flags) {
+  VK_CHECK(device->vkResetCommandPool(*device, commandPool, flags));
+}
\ No newline at end of file
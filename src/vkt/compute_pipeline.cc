@@ -0,0 +1,50 @@
+#include <vkt/compute_pipeline.h>
+
+ComputePipeline::ComputePipeline(std::shared_ptr<Device> device,
+                                 ComputePipelineCreateInfo const &createInfo) {
+  this->device = device;
+  this->pipelineLayout = createInfo.pipelineLayout;
+
+  auto const &shaderStage = createInfo.shaderStage;
+  auto const &specializationInfo = shaderStage.specializationInfo;
+
+  VkSpecializationInfo vk_specializationInfo;
+  VkSpecializationInfo const *pSpecializationInfo = nullptr;
+  if (specializationInfo.has_value()) {
+    vk_specializationInfo = VkSpecializationInfo{
+        .mapEntryCount = (uint32_t)specializationInfo->mapEntries.size(),
+        .pMapEntries = specializationInfo->mapEntries.data(),
+        .dataSize = specializationInfo->dataSize,
+        .pData = specializationInfo->data};
+    pSpecializationInfo = &vk_specializationInfo;
+  }
+
+  auto vk_createInfo = VkComputePipelineCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .pNext = VK_NULL_HANDLE,
+      .flags = {},
+      .stage =
+          VkPipelineShaderStageCreateInfo{
+              .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+              .pNext = VK_NULL_HANDLE,
+              .flags = {},
+              .stage = shaderStage.stage,
+              .module = *shaderStage.module,
+              .pName = shaderStage.name.c_str(),
+              .pSpecializationInfo = pSpecializationInfo},
+      .layout = *createInfo.pipelineLayout,
+      .basePipelineHandle = VK_NULL_HANDLE,
+      .basePipelineIndex = -1};
+
+  VkPipeline pipeline;
+  VK_CHECK(device->vkCreateComputePipelines(*device, VK_NULL_HANDLE, 1,
+                                            &vk_createInfo, VK_NULL_HANDLE,
+                                            &pipeline));
+
+  this->pipeline = Handle<VkPipeline, Device>(
+      pipeline,
+      [](VkPipeline pipeline, Device &device) -> void {
+        device.vkDestroyPipeline(device, pipeline, nullptr);
+      },
+      device);
+}
@@ -1,4 +1,12 @@
 #include <vkt/device.h>
+#include <vkt/memory_allocator.h>
+#include <vkt/capture.h>
+#include <algorithm>
+#include <cstdlib>
+
+// Allocations after which cached memory budgets are re-queried even if
+// refreshMemoryBudgets() was not called.
+static constexpr uint32_t BUDGET_REFRESH_INTERVAL = 64;
 
 Device::Device(std::shared_ptr<Loader> loader, PhysicalDevice physicalDevice,
                DeviceCreateInfo const &deviceCreateInfo) {
@@ -20,9 +28,53 @@ Device::Device(std::shared_ptr<Loader> loader, PhysicalDevice physicalDevice,
   auto extNames = vkMapNames(deviceCreateInfo.enabledExtensions);
   auto layerNames = vkMapNames(deviceCreateInfo.enabledLayers);
 
+  enabledFeatures = deviceCreateInfo.enabledFeatures;
+  extendedFeatures = deviceCreateInfo.enabledExtendedFeatures;
+
+  void *featureChain = nullptr;
+  VkPhysicalDeviceHostImageCopyFeaturesEXT hostImageCopyFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_FEATURES_EXT,
+      .pNext = nullptr,
+      .hostImageCopy = VK_TRUE};
+  if (extendedFeatures.hostImageCopy) {
+    hostImageCopyFeatures.pNext = featureChain;
+    featureChain = &hostImageCopyFeatures;
+  }
+
+  VkPhysicalDeviceMultiDrawFeaturesEXT multiDrawFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTI_DRAW_FEATURES_EXT,
+      .pNext = nullptr,
+      .multiDraw = VK_TRUE};
+  if (extendedFeatures.multiDraw) {
+    multiDrawFeatures.pNext = featureChain;
+    featureChain = &multiDrawFeatures;
+  }
+
+  VkPhysicalDeviceVulkan12Features vulkan12Features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+      .pNext = nullptr};
+  vulkan12Features.drawIndirectCount = extendedFeatures.drawIndirectCount;
+  vulkan12Features.timelineSemaphore = extendedFeatures.timelineSemaphore;
+  if (extendedFeatures.drawIndirectCount ||
+      extendedFeatures.timelineSemaphore) {
+    vulkan12Features.pNext = featureChain;
+    featureChain = &vulkan12Features;
+  }
+
+  VkPhysicalDeviceVulkan13Features vulkan13Features = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+      .pNext = nullptr};
+  vulkan13Features.dynamicRendering = extendedFeatures.dynamicRendering;
+  vulkan13Features.synchronization2 = extendedFeatures.synchronization2;
+  if (extendedFeatures.dynamicRendering ||
+      extendedFeatures.synchronization2) {
+    vulkan13Features.pNext = featureChain;
+    featureChain = &vulkan13Features;
+  }
+
   VkDeviceCreateInfo vk_deviceCreateInfo{
       .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-      .pNext = VK_NULL_HANDLE,
+      .pNext = featureChain,
       .flags = deviceCreateInfo.flags,
       .queueCreateInfoCount = (uint32_t)vk_queueCreateInfos.size(),
       .pQueueCreateInfos = vk_queueCreateInfos.data(),
@@ -43,7 +95,68 @@ Device::Device(std::shared_ptr<Loader> loader, PhysicalDevice physicalDevice,
       },
       loader);
 
-  loadFunctions();
+  load(device, vkGetDeviceProcAddr);
+
+  for (auto const &queueCreateInfo : deviceCreateInfo.queueCreateInfos)
+    for (uint32_t queueIndex = 0;
+         queueIndex < queueCreateInfo.queuePriorities.size(); ++queueIndex)
+      queueMutexes.try_emplace({queueCreateInfo.queueFamilyIndex, queueIndex});
+
+  auto capturePath = deviceCreateInfo.capturePath;
+  if (capturePath.empty())
+    if (auto const *path = std::getenv("VKT_CAPTURE"))
+      capturePath = path;
+  if (!capturePath.empty())
+    capture = std::make_shared<Capture>(*this, capturePath, deviceCreateInfo);
+
+  memoryBudgetEnabled =
+      std::find(deviceCreateInfo.enabledExtensions.begin(),
+                deviceCreateInfo.enabledExtensions.end(),
+                VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) !=
+      deviceCreateInfo.enabledExtensions.end();
+  refreshMemoryBudgets();
+
+  if (std::find(deviceCreateInfo.enabledExtensions.begin(),
+                deviceCreateInfo.enabledExtensions.end(),
+                VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) !=
+      deviceCreateInfo.enabledExtensions.end()) {
+    VkPhysicalDeviceExternalMemoryHostPropertiesEXT hostProps = {
+        .sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT,
+        .pNext = nullptr};
+    VkPhysicalDeviceProperties2 props2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &hostProps};
+    loader->vkGetPhysicalDeviceProperties2(physDev, &props2);
+    hostPointerAlignment = hostProps.minImportedHostPointerAlignment;
+  }
+
+  if (extendedFeatures.multiDraw) {
+    VkPhysicalDeviceMultiDrawPropertiesEXT multiDrawProps = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTI_DRAW_PROPERTIES_EXT,
+        .pNext = nullptr};
+    VkPhysicalDeviceProperties2 props2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &multiDrawProps};
+    loader->vkGetPhysicalDeviceProperties2(physDev, &props2);
+    maxMultiDrawCount = multiDrawProps.maxMultiDrawCount;
+  }
+
+  if (extendedFeatures.hostImageCopy) {
+    VkPhysicalDeviceHostImageCopyPropertiesEXT hostImageCopyProps = {
+        .sType =
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT,
+        .pNext = nullptr};
+    VkPhysicalDeviceProperties2 props2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &hostImageCopyProps};
+    loader->vkGetPhysicalDeviceProperties2(physDev, &props2);
+    hostCopyDstLayouts.resize(hostImageCopyProps.copyDstLayoutCount);
+    hostImageCopyProps.pCopyDstLayouts = hostCopyDstLayouts.data();
+    loader->vkGetPhysicalDeviceProperties2(physDev, &props2);
+  }
+
+  allocator = std::make_shared<MemoryAllocator>(*this);
 }
 
 Device::operator VkDevice() {
@@ -98,8 +211,112 @@ void Device::updateDescriptorSets(
                          (uint32_t)copyOps.size(), copyOps.data());
 }
 
-void Device::loadFunctions() {
-#define LOAD(name) this->name = (PFN_##name)vkGetDeviceProcAddr(device, #name)
-  DEVICE_DEFS(LOAD);
-#undef LOAD
+VkDeviceSize MemoryHeapBudget::available() const {
+  return budget > usage ? budget - usage : 0;
+}
+
+MemoryHeapBudget Device::getMemoryBudget(uint32_t heapIndex) {
+  if (allocationsSinceRefresh >= BUDGET_REFRESH_INTERVAL)
+    refreshMemoryBudgets();
+
+  MemoryHeapBudget budget;
+  budget.heapSize = physDev.memoryProps.memoryHeaps[heapIndex].size;
+  budget.allocated = heapAllocated[heapIndex];
+  budget.budget = heapBudget[heapIndex];
+  // The driver's usage does not include allocations made since it was read.
+  auto usage = heapUsage[heapIndex] + budget.allocated;
+  auto allocatedAtRefresh = heapAllocatedAtRefresh[heapIndex].load();
+  budget.usage = usage > allocatedAtRefresh ? usage - allocatedAtRefresh : 0;
+  return budget;
+}
+
+std::vector<MemoryHeapBudget> Device::getMemoryBudgets() {
+  std::vector<MemoryHeapBudget> budgets;
+  for (uint32_t index = 0; index < physDev.memoryProps.memoryHeapCount;
+       ++index)
+    budgets.push_back(getMemoryBudget(index));
+  return budgets;
+}
+
+void Device::refreshMemoryBudgets() {
+  std::lock_guard<std::mutex> guard(budgetMutex);
+  allocationsSinceRefresh = 0;
+  auto const &memoryProps = physDev.memoryProps;
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+      .pNext = nullptr};
+  if (memoryBudgetEnabled) {
+    VkPhysicalDeviceMemoryProperties2 memoryProps2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+        .pNext = &budgetProps};
+    loader->vkGetPhysicalDeviceMemoryProperties2(physDev, &memoryProps2);
+  }
+
+  for (uint32_t index = 0; index < memoryProps.memoryHeapCount; ++index) {
+    auto allocated = heapAllocated[index].load();
+    heapAllocatedAtRefresh[index] = allocated;
+    if (memoryBudgetEnabled) {
+      heapBudget[index] = budgetProps.heapBudget[index];
+      heapUsage[index] = budgetProps.heapUsage[index];
+    } else {
+      heapBudget[index] = memoryProps.memoryHeaps[index].size / 10 * 8;
+      heapUsage[index] = allocated;
+    }
+  }
+}
+
+void Device::recordAllocation(uint32_t heapIndex, VkDeviceSize size) {
+  heapAllocated[heapIndex] += size;
+  ++allocationsSinceRefresh;
+}
+
+void Device::recordFree(uint32_t heapIndex, VkDeviceSize size) {
+  heapAllocated[heapIndex] -= size;
+}
+
+VkPhysicalDeviceFeatures const &Device::getEnabledFeatures() const {
+  return enabledFeatures;
+}
+
+DeviceExtendedFeatures const &Device::getExtendedFeatures() const {
+  return extendedFeatures;
+}
+
+uint32_t Device::getMaxMultiDrawCount() const {
+  return maxMultiDrawCount;
+}
+
+bool Device::isHostCopyDstLayout(VkImageLayout layout) const {
+  return std::find(hostCopyDstLayouts.begin(), hostCopyDstLayouts.end(),
+                   layout) != hostCopyDstLayouts.end();
+}
+
+Capture *Device::getCapture() const {
+  return capture.get();
+}
+
+std::mutex &Device::getQueueMutex(uint32_t queueFamilyIndex,
+                                  uint32_t queueIndex) {
+  auto it = queueMutexes.find({queueFamilyIndex, queueIndex});
+  if (it == queueMutexes.end())
+    throw std::runtime_error("queue was not created with the device");
+  return it->second;
+}
+
+VkDeviceSize Device::getHostPointerAlignment() const {
+  return hostPointerAlignment;
+}
+
+uint32_t Device::getHostPointerMemoryTypeBits(void const *hostPointer) {
+  if (hostPointerAlignment == 0)
+    return 0;
+
+  VkMemoryHostPointerPropertiesEXT hostPointerProps = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT,
+      .pNext = nullptr};
+  auto result = vkGetMemoryHostPointerPropertiesEXT(
+      device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+      hostPointer, &hostPointerProps);
+  return result == VK_SUCCESS ? hostPointerProps.memoryTypeBits : 0;
 }
\ No newline at end of file
@@ -0,0 +1,9 @@
+#include <vkt/device_dispatch.h>
+
+void DeviceDispatch::load(VkDevice device,
+                          PFN_vkGetDeviceProcAddr getDeviceProcAddr) {
+#define LOAD(name) this->name = (PFN_##name)getDeviceProcAddr(device, #name)
+  DEVICE_DEFS(LOAD);
+  CMD_BUF_DEFS(LOAD);
+#undef LOAD
+}
\ No newline at end of file
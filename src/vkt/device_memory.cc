@@ -6,10 +6,18 @@ DeviceMemory::DeviceMemory(std::shared_ptr<Device> device,
 
   this->device = device;
   this->allocationSize = allocInfo.size;
+  this->memoryTypeIndex = allocInfo.memoryTypeIndex;
+
+  auto importInfo = VkImportMemoryHostPointerInfoEXT{
+      .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT,
+      .pNext = nullptr,
+      .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+      .pHostPointer = allocInfo.importHostPointer};
+  auto imported = allocInfo.importHostPointer != nullptr;
 
   auto vk_allocInfo =
       VkMemoryAllocateInfo{.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-                           .pNext = nullptr,
+                           .pNext = imported ? &importInfo : nullptr,
                            .allocationSize = allocInfo.size,
                            .memoryTypeIndex = allocInfo.memoryTypeIndex};
 
@@ -17,10 +25,19 @@ DeviceMemory::DeviceMemory(std::shared_ptr<Device> device,
   VK_CHECK(
       device->vkAllocateMemory(*device, &vk_allocInfo, nullptr, &deviceMemory));
 
+  auto heapIndex = device->physDev.memoryProps
+                       .memoryTypes[allocInfo.memoryTypeIndex]
+                       .heapIndex;
+  // Imported pages were already allocated by the host.
+  auto size = imported ? 0 : allocInfo.size;
+  device->recordAllocation(heapIndex, size);
+
+  // vkFreeMemory implicitly unmaps a persistent mapping.
   this->deviceMemory = Handle<VkDeviceMemory, Device>(
       deviceMemory,
-      [](VkDeviceMemory deviceMemory, Device &device) -> void {
+      [heapIndex, size](VkDeviceMemory deviceMemory, Device &device) -> void {
         device.vkFreeMemory(device, deviceMemory, nullptr);
+        device.recordFree(heapIndex, size);
       },
       device);
 }
@@ -29,22 +46,93 @@ DeviceMemory::operator VkDeviceMemory() {
   return deviceMemory;
 }
 
-std::shared_ptr<void> DeviceMemory::map(VkDeviceSize offset,
-                                        VkDeviceSize size) {
-  if (!memoryMap.expired())
-    return memoryMap.lock();
+VkDeviceSize DeviceMemory::getSize() const {
+  return allocationSize;
+}
+
+uint32_t DeviceMemory::getMemoryTypeIndex() const {
+  return memoryTypeIndex;
+}
+
+VkMemoryPropertyFlags DeviceMemory::getPropertyFlags() const {
+  return device->physDev.memoryProps.memoryTypes[memoryTypeIndex]
+      .propertyFlags;
+}
+
+bool DeviceMemory::isHostCoherent() const {
+  return (getPropertyFlags() & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+void *DeviceMemory::map() {
+  std::lock_guard<std::mutex> guard(mapMutex);
+  if (mappedData == nullptr)
+    VK_CHECK(device->vkMapMemory(*device, deviceMemory, 0, VK_WHOLE_SIZE, {},
+                                 &mappedData));
+  return mappedData;
+}
+
+void DeviceMemory::flush(VkDeviceSize offset, VkDeviceSize size) {
+  if (isHostCoherent())
+    return;
+
+  auto range = alignedRange(offset, size);
+  VK_CHECK(device->vkFlushMappedMemoryRanges(*device, 1, &range));
+}
+
+void DeviceMemory::invalidate(VkDeviceSize offset, VkDeviceSize size) {
+  if (isHostCoherent())
+    return;
 
-  size = std::min(size, allocationSize);
-  void *ptr;
-  VK_CHECK(device->vkMapMemory(*device, deviceMemory, offset, size, {}, &ptr));
+  auto range = alignedRange(offset, size);
+  VK_CHECK(device->vkInvalidateMappedMemoryRanges(*device, 1, &range));
+}
+
+VkMappedMemoryRange DeviceMemory::alignedRange(VkDeviceSize offset,
+                                               VkDeviceSize size) {
+  auto atomSize = device->physDev.properties.limits.nonCoherentAtomSize;
+  auto begin = offset / atomSize * atomSize;
+
+  auto rangeSize = VK_WHOLE_SIZE;
+  if (size != VK_WHOLE_SIZE) {
+    auto end = (offset + size + atomSize - 1) / atomSize * atomSize;
+    rangeSize = std::min(end, allocationSize) - begin;
+  }
+
+  return VkMappedMemoryRange{.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+                             .pNext = nullptr,
+                             .memory = deviceMemory,
+                             .offset = begin,
+                             .size = rangeSize};
+}
+
+MappedRangeBatch::MappedRangeBatch(std::shared_ptr<Device> device) {
+  this->device = device;
+}
+
+void MappedRangeBatch::add(DeviceMemory &memory, VkDeviceSize offset,
+                           VkDeviceSize size) {
+  if (!memory.isHostCoherent())
+    ranges.push_back(memory.alignedRange(offset, size));
+}
+
+bool MappedRangeBatch::empty() const {
+  return ranges.empty();
+}
+
+void MappedRangeBatch::flush() {
+  if (ranges.empty())
+    return;
+
+  VK_CHECK(device->vkFlushMappedMemoryRanges(*device, (uint32_t)ranges.size(),
+                                             ranges.data()));
+  ranges.clear();
+}
 
-  VkDeviceMemory deviceMemory = this->deviceMemory;
-  std::shared_ptr<Device> device = this->device;
-  auto unmapMemory = [deviceMemory, device](void *ptr) -> void {
-    device->vkUnmapMemory(*device, deviceMemory);
-  };
+void MappedRangeBatch::invalidate() {
+  if (ranges.empty())
+    return;
 
-  auto memoryMap = std::shared_ptr<void>(ptr, unmapMemory);
-  this->memoryMap = memoryMap;
-  return memoryMap;
+  VK_CHECK(device->vkInvalidateMappedMemoryRanges(
+      *device, (uint32_t)ranges.size(), ranges.data()));
+  ranges.clear();
 }
@@ -0,0 +1,126 @@
+#include <vkt/draw_list.h>
+#include <algorithm>
+#include <stdexcept>
+
+DrawList::DrawList(std::shared_ptr<Device> device,
+                   DrawListCreateInfo const &createInfo) {
+  this->device = device;
+  this->createInfo = createInfo;
+
+  auto sharingMode = createInfo.queueFamilyIndices.size() > 1
+                         ? VK_SHARING_MODE_CONCURRENT
+                         : VK_SHARING_MODE_EXCLUSIVE;
+
+  // Read by the GPU once per draw; prefer device-local host-visible memory.
+  auto makeBuffer = [&](VkDeviceSize size, VkBufferUsageFlags usage,
+                        void *&data) {
+    auto buffer = std::make_shared<Buffer>(
+        device,
+        BufferCreateInfo{.size = size,
+                         .usage = usage,
+                         .sharingMode = sharingMode,
+                         .queueFamilyIndices = createInfo.queueFamilyIndices});
+    auto &memory = buffer->allocMemory(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    data = memory.map();
+    return buffer;
+  };
+
+  void *data;
+  commandBuffer = makeBuffer(createInfo.maxDraws *
+                                 sizeof(VkDrawIndexedIndirectCommand),
+                             VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, data);
+  commands = {(VkDrawIndexedIndirectCommand *)data, createInfo.maxDraws};
+
+  materialBuffer = makeBuffer(createInfo.maxDraws * sizeof(uint32_t),
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, data);
+  materials = {(uint32_t *)data, createInfo.maxDraws};
+
+  multiDraws.reserve(createInfo.maxDraws);
+}
+
+void DrawList::clear() {
+  multiDraws.clear();
+  sharedInstances = true;
+  count = 0;
+}
+
+uint32_t DrawList::add(DrawListEntry const &entry) {
+  if (count == createInfo.maxDraws)
+    throw std::runtime_error("draw list is full");
+
+  commands[count] =
+      VkDrawIndexedIndirectCommand{.indexCount = entry.indexCount,
+                                   .instanceCount = entry.instanceCount,
+                                   .firstIndex = entry.firstIndex,
+                                   .vertexOffset = entry.vertexOffset,
+                                   .firstInstance = entry.firstInstance};
+  materials[count] = entry.material;
+
+  multiDraws.push_back(
+      VkMultiDrawIndexedInfoEXT{.firstIndex = entry.firstIndex,
+                                .indexCount = entry.indexCount,
+                                .vertexOffset = entry.vertexOffset});
+  sharedInstances = sharedInstances &&
+                    entry.instanceCount == commands[0].instanceCount &&
+                    entry.firstInstance == commands[0].firstInstance;
+
+  return count++;
+}
+
+uint32_t DrawList::size() const {
+  return count;
+}
+
+void DrawList::draw(CommandBufferRenderPass &renderPass,
+                    std::optional<DrawIndexPushConstant> const &drawIndex) {
+  if (count == 0)
+    return;
+
+  auto pushDrawIndex = [&](uint32_t index) {
+    if (drawIndex.has_value())
+      renderPass.pushConstants(drawIndex->layout, drawIndex->stageFlags,
+                               drawIndex->offset, index);
+  };
+
+  // Calls take at most maxCount draws, and gl_DrawID restarts with each, so
+  // every call gets the index of its first draw.
+  auto drawChunks = [&](uint32_t maxCount, auto const &drawChunk) {
+    for (uint32_t first = 0; first < count; first += maxCount) {
+      pushDrawIndex(first);
+      drawChunk(first, std::min(count - first, maxCount));
+    }
+  };
+
+  if (device->getEnabledFeatures().multiDrawIndirect) {
+    drawChunks(
+        std::max(device->physDev.properties.limits.maxDrawIndirectCount, 1u),
+        [&](uint32_t first, uint32_t chunkCount) {
+          renderPass.drawIndexedIndirect(
+              *commandBuffer, first * sizeof(VkDrawIndexedIndirectCommand),
+              chunkCount);
+        });
+  } else if (device->getMaxMultiDrawCount() > 0 && sharedInstances) {
+    drawChunks(device->getMaxMultiDrawCount(),
+               [&](uint32_t first, uint32_t chunkCount) {
+                 renderPass.drawMultiIndexed(
+                     std::span(multiDraws).subspan(first, chunkCount),
+                     commands[0].instanceCount, commands[0].firstInstance);
+               });
+  } else {
+    for (uint32_t i = 0; i < count; ++i) {
+      pushDrawIndex(i);
+      renderPass.drawIndexedIndirect(
+          *commandBuffer, i * sizeof(VkDrawIndexedIndirectCommand), 1);
+    }
+  }
+}
+
+std::shared_ptr<Buffer> const &DrawList::getCommandBuffer() const {
+  return commandBuffer;
+}
+
+std::shared_ptr<Buffer> const &DrawList::getMaterialBuffer() const {
+  return materialBuffer;
+}
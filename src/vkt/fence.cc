@@ -30,3 +30,11 @@ void Fence::wait() {
 void Fence::reset() {
   VK_CHECK(device->vkResetFences(*device, 1, &(VkFence &)fence));
 }
+
+bool Fence::isSignalled() {
+  auto result = device->vkGetFenceStatus(*device, fence);
+  if (result == VK_NOT_READY)
+    return false;
+  VK_CHECK(result);
+  return true;
+}
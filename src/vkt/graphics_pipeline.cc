@@ -1,4 +1,5 @@
 #include <vkt/graphics_pipeline.h>
+#include <algorithm>
 
 GraphicsPipeline::GraphicsPipeline(
     std::shared_ptr<Device> device,
@@ -6,6 +7,7 @@ GraphicsPipeline::GraphicsPipeline(
   this->device = device;
   this->pipelineLayout = createInfo.pipelineLayout;
   this->renderPass = createInfo.renderPass;
+  this->dynamicStates = createInfo.dynamicStates;
 
   std::vector<VkSpecializationInfo> vk_specializationInfos;
   std::vector<VkPipelineShaderStageCreateInfo> vk_shaderStages;
@@ -156,9 +158,31 @@ GraphicsPipeline::GraphicsPipeline(
       .dynamicStateCount = (uint32_t)createInfo.dynamicStates.size(),
       .pDynamicStates = createInfo.dynamicStates.data()};
 
+  VkPipelineRenderingCreateInfo vk_renderingInfo = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+      .pNext = VK_NULL_HANDLE,
+      .viewMask = 0,
+      .colorAttachmentCount = 0,
+      .pColorAttachmentFormats = nullptr,
+      .depthAttachmentFormat = VK_FORMAT_UNDEFINED,
+      .stencilAttachmentFormat = VK_FORMAT_UNDEFINED};
+  if (createInfo.renderingInfo.has_value()) {
+    auto const &renderingInfo = *createInfo.renderingInfo;
+    vk_renderingInfo.viewMask = renderingInfo.viewMask;
+    vk_renderingInfo.colorAttachmentCount =
+        (uint32_t)renderingInfo.colorAttachmentFormats.size();
+    vk_renderingInfo.pColorAttachmentFormats =
+        renderingInfo.colorAttachmentFormats.data();
+    vk_renderingInfo.depthAttachmentFormat =
+        renderingInfo.depthAttachmentFormat;
+    vk_renderingInfo.stencilAttachmentFormat =
+        renderingInfo.stencilAttachmentFormat;
+  }
+
   auto vk_createInfo = VkGraphicsPipelineCreateInfo{
       .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-      .pNext = VK_NULL_HANDLE,
+      .pNext = createInfo.renderingInfo.has_value() ? &vk_renderingInfo
+                                                    : VK_NULL_HANDLE,
       .flags = {},
       .stageCount = (uint32_t)vk_shaderStages.size(),
       .pStages = vk_shaderStages.data(),
@@ -172,7 +196,9 @@ GraphicsPipeline::GraphicsPipeline(
       .pColorBlendState = &vk_colorBlendState,
       .pDynamicState = &vk_dynamicState,
       .layout = *createInfo.pipelineLayout,
-      .renderPass = *createInfo.renderPass,
+      .renderPass = createInfo.renderPass != nullptr
+                        ? (VkRenderPass)*createInfo.renderPass
+                        : VK_NULL_HANDLE,
       .subpass = createInfo.subpass,
       .basePipelineHandle = VK_NULL_HANDLE,
       .basePipelineIndex = -1};
@@ -188,4 +214,9 @@ GraphicsPipeline::GraphicsPipeline(
         device.vkDestroyPipeline(device, pipeline, nullptr);
       },
       device);
-}
\ No newline at end of file
+}
+
+bool GraphicsPipeline::hasDynamicState(VkDynamicState dynamicState) const {
+  return std::find(dynamicStates.begin(), dynamicStates.end(),
+                   dynamicState) != dynamicStates.end();
+}
@@ -1,7 +1,8 @@
 #include <vkt/image.h>
 #include <vkt/buffer.h>
-#include <vkt/command_buffer.h>
-#include <cstring>
+#include <vkt/upload_context.h>
+#include <algorithm>
+#include <bit>
 
 Image::Image(std::shared_ptr<Device> device,
              ImageCreateInfo const &createInfo) {
@@ -12,8 +13,8 @@ Image::Image(std::shared_ptr<Device> device,
   for (auto queueFamilyIndex : createInfo.queueFamilyIndices)
     queueFamilyIndices.push_back(queueFamilyIndex);
 
-  auto sharingMode = createInfo.sharingMode;
-  if (queueFamilyIndices.size() == 1)
+  sharingMode = createInfo.sharingMode;
+  if (queueFamilyIndices.size() < 2)
     sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
   auto vk_createInfo = VkImageCreateInfo{
@@ -43,130 +44,135 @@ Image::Image(std::shared_ptr<Device> device,
         device.vkDestroyImage(device, image, nullptr);
       },
       device);
+}
 
-  vkGetPhysicalDeviceImageFormatProperties(
-      device->physDev, createInfo.format, createInfo.imageType,
-      createInfo.tiling, createInfo.usage, createInfo.flags, &formatProps);
+uint32_t Image::mipChainLength(VkExtent3D extent) {
+  auto largest = std::max({extent.width, extent.height, extent.depth});
+  return (uint32_t)std::bit_width(largest);
 }
 
 Image::operator VkImage() {
   return image;
 }
 
+VkSharingMode Image::getSharingMode() const {
+  return sharingMode;
+}
+
 VkMemoryRequirements Image::getMemoryRequirements() {
   VkMemoryRequirements memRequirements = {};
   device->vkGetImageMemoryRequirements(*device, image, &memRequirements);
   return memRequirements;
 }
 
-DeviceMemory &Image::allocMemory(VkMemoryPropertyFlags properties) {
-  auto memoryReqs = getMemoryRequirements();
-  auto memoryTypeIndex = device->physDev.findMemoryTypeIndex(
-      memoryReqs.memoryTypeBits, properties);
-  auto memory = std::make_shared<DeviceMemory>(
-      device, MemoryAllocateInfo{.size = memoryReqs.size,
-                                 .memoryTypeIndex = memoryTypeIndex.value()});
-
-  VK_CHECK(device->vkBindImageMemory(*device, image, *memory, 0));
-  this->imageMemory = memory;
+MemoryAllocation &Image::allocMemory(VkMemoryPropertyFlags properties,
+                                     VkMemoryPropertyFlags preferred,
+                                     VkMemoryPropertyFlags avoided) {
+  // Render targets are never touched by the host; keep them out of the
+  // host-visible (ReBAR) heap unless that was asked for.
+  auto attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  if ((createInfo.usage & attachmentUsage) &&
+      !(properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+    avoided |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+
+  auto memory = device->allocator->allocate(MemoryAllocationCreateInfo{
+      .requirements = getMemoryRequirements(),
+      .properties = properties,
+      .preferredProperties = preferred,
+      .avoidedProperties = avoided,
+      .linear = createInfo.tiling == VK_IMAGE_TILING_LINEAR});
+  bindMemory(memory);
   return *memory;
 }
 
+void Image::bindMemory(std::shared_ptr<MemoryAllocation> allocation) {
+  VK_CHECK(device->vkBindImageMemory(*device, image, *allocation,
+                                     allocation->getOffset()));
+  this->imageMemory = allocation;
+}
+
 void Image::bindMemory(std::shared_ptr<DeviceMemory> deviceMemory,
                        VkDeviceSize offset) {
-  VK_CHECK(device->vkBindImageMemory(*device, image, *deviceMemory, offset));
-  this->imageMemory = deviceMemory;
+  bindMemory(std::make_shared<MemoryAllocation>(
+      deviceMemory, offset, deviceMemory->getSize() - offset));
+}
+
+bool Image::supportsHostCopy(Device &device,
+                             ImageCreateInfo const &createInfo,
+                             VkImageLayout dstLayout) {
+  if (!device.isHostCopyDstLayout(dstLayout))
+    return false;
+
+  return device.physDev
+      .getImageFormatProperties(ImageFormatQuery{
+          .format = createInfo.format,
+          .type = createInfo.imageType,
+          .tiling = createInfo.tiling,
+          .usage = createInfo.usage | VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT,
+          .flags = createInfo.flags})
+      .has_value();
+}
+
+bool Image::canHostCopy(VkImageLayout dstLayout) const {
+  return device->isHostCopyDstLayout(dstLayout) &&
+         (createInfo.usage & VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT) != 0;
+}
+
+void Image::hostCopy(void const *data, VkImageLayout dstLayout) {
+  auto aspects = formatAspects(createInfo.format);
+
+  auto transition = VkHostImageLayoutTransitionInfoEXT{
+      .sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT,
+      .pNext = nullptr,
+      .image = image,
+      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .newLayout = dstLayout,
+      .subresourceRange = {.aspectMask = aspects,
+                           .baseMipLevel = 0,
+                           .levelCount = VK_REMAINING_MIP_LEVELS,
+                           .baseArrayLayer = 0,
+                           .layerCount = VK_REMAINING_ARRAY_LAYERS}};
+  VK_CHECK(device->vkTransitionImageLayoutEXT(*device, 1, &transition));
+
+  auto region = VkMemoryToImageCopyEXT{
+      .sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT,
+      .pNext = nullptr,
+      .pHostPointer = data,
+      .memoryRowLength = 0,
+      .memoryImageHeight = 0,
+      .imageSubresource = {.aspectMask = aspects,
+                           .mipLevel = 0,
+                           .baseArrayLayer = 0,
+                           .layerCount = 1},
+      .imageOffset = {},
+      .imageExtent = createInfo.extent};
+  auto copyInfo = VkCopyMemoryToImageInfoEXT{
+      .sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT,
+      .pNext = nullptr,
+      .flags = {},
+      .dstImage = image,
+      .dstImageLayout = dstLayout,
+      .regionCount = 1,
+      .pRegions = &region};
+  VK_CHECK(device->vkCopyMemoryToImageEXT(*device, &copyInfo));
 }
 
 void Image::stage(void *data, VkDeviceSize size, Queue &transferQueue,
                   VkPipelineStageFlags dstStageMask,
                   VkAccessFlags dstAccessMask, VkImageLayout dstLayout) {
-  auto queueFamilyIndex = transferQueue.getQueueFamilyIndex();
-
-  auto staging = Buffer(
-      device, BufferCreateInfo{.size = size,
-                               .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                               .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
-                               .queueFamilyIndices = {queueFamilyIndex}});
-
-  auto &stagingMemory =
-      staging.allocMemory(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-  {
-    auto stagingMap = stagingMemory.map();
-    std::memcpy(stagingMap.get(), data, size);
-  }
-
-  auto cmdPool = CommandPool(
-      device,
-      CommandPoolCreateInfo{.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
-                            .queueFamilyIndex = queueFamilyIndex});
-
-  auto cmdBuf = CommandBuffer(
-      device,
-      CommandBufferAllocateInfo{.commandPool = stack_ptr(cmdPool),
-                                .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY});
-
-  {
-    auto rec = CommandBufferRecording(
-        stack_ptr(cmdBuf),
-        CommandBufferBeginInfo{
-            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT});
-
-    auto subresourceRange =
-        VkImageSubresourceRange{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                                .baseMipLevel = 0,
-                                .levelCount = 1,
-                                .baseArrayLayer = 0,
-                                .layerCount = 1};
-
-    rec.pipelineBarrier(
-        DependencyInfo{.srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-                       .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
-                       .dependencyFlags = {},
-                       .imageMemoryBarriers = {VkImageMemoryBarrier{
-                           .srcAccessMask = {},
-                           .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-                           .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-                           .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                           .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                           .image = image,
-                           .subresourceRange = subresourceRange}}});
-
-    rec.copyBufferToImage(CopyBufferToImageInfo{
-        .srcBuffer = staging,
-        .dstImage = image,
-        .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .regions = {
-            VkBufferImageCopy{.bufferOffset = 0,
-                              .bufferRowLength = 0,
-                              .bufferImageHeight = 0,
-                              .imageSubresource =
-                                  VkImageSubresourceLayers{
-                                      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                                      .mipLevel = 0,
-                                      .baseArrayLayer = 0,
-                                      .layerCount = 1},
-                              .imageOffset = {},
-                              .imageExtent = createInfo.extent}}});
-
-    rec.pipelineBarrier(
-        DependencyInfo{.srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
-                       .dstStageMask = dstStageMask,
-                       .dependencyFlags = {},
-                       .imageMemoryBarriers = {VkImageMemoryBarrier{
-                           .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-                           .dstAccessMask = dstAccessMask,
-                           .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           .newLayout = dstLayout,
-                           .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                           .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                           .image = image,
-                           .subresourceRange = subresourceRange}}});
-  }
-
-  transferQueue.submit(QueueSubmitInfo{.commandBuffers = {cmdBuf}});
-  transferQueue.wait();
-}
\ No newline at end of file
+  // Host writes become visible to the device with the next submission.
+  if (canHostCopy(dstLayout))
+    return hostCopy(data, dstLayout);
+
+  auto uploadContext =
+      UploadContext(device, transferQueue,
+                    UploadContextCreateInfo{.stagingSize = size,
+                                            .chunkSize = size,
+                                            .maxBatchesInFlight = 1});
+  uploadContext.upload(*this, data, size,
+                       ImageUploadInfo{.dstStageMask = dstStageMask,
+                                       .dstAccessMask = dstAccessMask,
+                                       .dstLayout = dstLayout});
+  uploadContext.waitIdle();
+}
@@ -10,6 +10,7 @@ Loader::Loader(PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr) {
   LOAD(vkCreateInstance);
   LOAD(vkDestroyInstance);
   LOAD(vkGetPhysicalDeviceProperties);
+  LOAD(vkGetPhysicalDeviceProperties2);
   LOAD(vkGetPhysicalDeviceFeatures);
   LOAD(vkGetPhysicalDeviceQueueFamilyProperties);
   LOAD(vkCreateDevice);
@@ -18,7 +19,9 @@ Loader::Loader(PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr) {
   LOAD(vkGetPhysicalDeviceSurfaceFormatsKHR);
   LOAD(vkGetPhysicalDeviceSurfacePresentModesKHR);
   LOAD(vkGetPhysicalDeviceMemoryProperties);
+  LOAD(vkGetPhysicalDeviceMemoryProperties2);
   LOAD(vkGetPhysicalDeviceSurfaceSupportKHR);
   LOAD(vkGetPhysicalDeviceFormatProperties);
+  LOAD(vkGetPhysicalDeviceImageFormatProperties);
 #undef LOAD
 }
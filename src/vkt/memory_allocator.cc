@@ -0,0 +1,513 @@
+#include <vkt/memory_allocator.h>
+#include <algorithm>
+#include <bit>
+
+// Two-level segregated fit (TLSF) bookkeeping for the ranges of a single
+// VkDeviceMemory block. Free ranges are binned by size class; a pair of
+// bitmaps finds a suitable bin in constant time.
+static constexpr uint32_t SL_INDEX_COUNT_LOG2 = 5;
+static constexpr uint32_t SL_INDEX_COUNT = 1u << SL_INDEX_COUNT_LOG2;
+static constexpr uint32_t FL_INDEX_SHIFT = SL_INDEX_COUNT_LOG2 + 3;
+static constexpr uint32_t FL_INDEX_MAX = 48;
+static constexpr uint32_t FL_INDEX_COUNT = FL_INDEX_MAX - FL_INDEX_SHIFT + 1;
+static constexpr VkDeviceSize SMALL_RANGE_SIZE = (VkDeviceSize)1
+                                                 << FL_INDEX_SHIFT;
+
+static uint32_t fls(VkDeviceSize x) {
+  return (uint32_t)std::bit_width(x) - 1;
+}
+
+static VkDeviceSize alignUp(VkDeviceSize x, VkDeviceSize alignment) {
+  return (x + alignment - 1) / alignment * alignment;
+}
+
+static std::pair<uint32_t, uint32_t> mapping(VkDeviceSize size) {
+  if (size < SMALL_RANGE_SIZE)
+    return {0, (uint32_t)(size / (SMALL_RANGE_SIZE / SL_INDEX_COUNT))};
+
+  auto fl = fls(size);
+  auto sl = (uint32_t)(size >> (fl - SL_INDEX_COUNT_LOG2)) ^ SL_INDEX_COUNT;
+  return {fl - (FL_INDEX_SHIFT - 1), sl};
+}
+
+struct MemoryRange {
+  VkDeviceSize offset, size;
+  bool free;
+  MemoryRange *prevPhys, *nextPhys;
+  MemoryRange *prevFree, *nextFree;
+};
+
+class MemoryBlock {
+public:
+  MemoryBlock(std::shared_ptr<DeviceMemory> memory, uint32_t poolKey);
+  ~MemoryBlock();
+
+  MemoryRange *allocate(VkDeviceSize size, VkDeviceSize alignment);
+  void free(MemoryRange *range);
+
+  bool empty() const;
+  void addStats(MemoryStats &stats) const;
+
+  std::shared_ptr<DeviceMemory> memory;
+  uint32_t poolKey;
+
+private:
+  uint64_t flBitmap = 0;
+  std::array<uint32_t, FL_INDEX_COUNT> slBitmap = {};
+  std::array<std::array<MemoryRange *, SL_INDEX_COUNT>, FL_INDEX_COUNT>
+      freeHeads = {};
+
+  MemoryRange *first = nullptr;
+  uint32_t allocationCount = 0;
+  VkDeviceSize usedBytes = 0;
+
+  MemoryRange *findFree(VkDeviceSize size);
+  void insertFree(MemoryRange *range);
+  void removeFree(MemoryRange *range);
+  MemoryRange *split(MemoryRange *range, VkDeviceSize size);
+  void merge(MemoryRange *range, MemoryRange *next);
+};
+
+MemoryBlock::MemoryBlock(std::shared_ptr<DeviceMemory> memory,
+                         uint32_t poolKey) {
+  this->memory = memory;
+  this->poolKey = poolKey;
+
+  first = new MemoryRange{.offset = 0,
+                          .size = memory->getSize(),
+                          .free = true,
+                          .prevPhys = nullptr,
+                          .nextPhys = nullptr,
+                          .prevFree = nullptr,
+                          .nextFree = nullptr};
+  insertFree(first);
+}
+
+MemoryBlock::~MemoryBlock() {
+  while (first != nullptr) {
+    auto *next = first->nextPhys;
+    delete first;
+    first = next;
+  }
+}
+
+MemoryRange *MemoryBlock::allocate(VkDeviceSize size,
+                                   VkDeviceSize alignment) {
+  alignment = std::max<VkDeviceSize>(alignment, 1);
+
+  auto fits = [&](MemoryRange *range) -> bool {
+    auto alignedOffset = alignUp(range->offset, alignment);
+    return alignedOffset + size <= range->offset + range->size;
+  };
+
+  // Ranges in the first suitable bin are large enough for the unaligned
+  // size; only when the head cannot absorb the padding do we search for room
+  // for the worst-case padding as well.
+  auto *range = findFree(size);
+  if (range == nullptr || !fits(range))
+    range = findFree(size + alignment - 1);
+  if (range == nullptr || !fits(range))
+    return nullptr;
+
+  removeFree(range);
+
+  auto padding = alignUp(range->offset, alignment) - range->offset;
+  if (padding > 0) {
+    auto *aligned = split(range, padding);
+    insertFree(range);
+    range = aligned;
+  }
+
+  if (range->size > size)
+    insertFree(split(range, size));
+
+  range->free = false;
+  ++allocationCount;
+  usedBytes += range->size;
+  return range;
+}
+
+void MemoryBlock::free(MemoryRange *range) {
+  --allocationCount;
+  usedBytes -= range->size;
+  range->free = true;
+
+  if (auto *prev = range->prevPhys; prev != nullptr && prev->free) {
+    removeFree(prev);
+    merge(prev, range);
+    range = prev;
+  }
+
+  if (auto *next = range->nextPhys; next != nullptr && next->free) {
+    removeFree(next);
+    merge(range, next);
+  }
+
+  insertFree(range);
+}
+
+bool MemoryBlock::empty() const {
+  return allocationCount == 0;
+}
+
+void MemoryBlock::addStats(MemoryStats &stats) const {
+  stats.blockCount += 1;
+  stats.allocationCount += allocationCount;
+  stats.reservedBytes += memory->getSize();
+  stats.usedBytes += usedBytes;
+
+  for (auto *range = first; range != nullptr; range = range->nextPhys) {
+    if (!range->free)
+      continue;
+    stats.freeRangeCount += 1;
+    stats.largestFreeRange = std::max(stats.largestFreeRange, range->size);
+  }
+}
+
+// Rounds the size up to the next bin boundary, so that every range in the
+// bin found is at least as large as requested.
+MemoryRange *MemoryBlock::findFree(VkDeviceSize size) {
+  if (size >= SMALL_RANGE_SIZE)
+    size += ((VkDeviceSize)1 << (fls(size) - SL_INDEX_COUNT_LOG2)) - 1;
+  else
+    size += SMALL_RANGE_SIZE / SL_INDEX_COUNT - 1;
+
+  auto [fl, sl] = mapping(size);
+  if (fl >= FL_INDEX_COUNT)
+    return nullptr;
+
+  uint32_t slMap = slBitmap[fl] & (~0u << sl);
+  if (slMap == 0) {
+    uint64_t flMap = flBitmap & (~(uint64_t)0 << (fl + 1));
+    if (flMap == 0)
+      return nullptr;
+
+    fl = (uint32_t)std::countr_zero(flMap);
+    slMap = slBitmap[fl];
+  }
+
+  sl = (uint32_t)std::countr_zero(slMap);
+  return freeHeads[fl][sl];
+}
+
+void MemoryBlock::insertFree(MemoryRange *range) {
+  auto [fl, sl] = mapping(range->size);
+  auto *&head = freeHeads[fl][sl];
+
+  range->prevFree = nullptr;
+  range->nextFree = head;
+  if (head != nullptr)
+    head->prevFree = range;
+  head = range;
+
+  slBitmap[fl] |= 1u << sl;
+  flBitmap |= (uint64_t)1 << fl;
+}
+
+void MemoryBlock::removeFree(MemoryRange *range) {
+  auto [fl, sl] = mapping(range->size);
+
+  if (range->prevFree != nullptr)
+    range->prevFree->nextFree = range->nextFree;
+  else
+    freeHeads[fl][sl] = range->nextFree;
+
+  if (range->nextFree != nullptr)
+    range->nextFree->prevFree = range->prevFree;
+
+  if (freeHeads[fl][sl] == nullptr) {
+    slBitmap[fl] &= ~(1u << sl);
+    if (slBitmap[fl] == 0)
+      flBitmap &= ~((uint64_t)1 << fl);
+  }
+
+  range->prevFree = range->nextFree = nullptr;
+}
+
+MemoryRange *MemoryBlock::split(MemoryRange *range, VkDeviceSize size) {
+  auto *rest = new MemoryRange{.offset = range->offset + size,
+                               .size = range->size - size,
+                               .free = true,
+                               .prevPhys = range,
+                               .nextPhys = range->nextPhys,
+                               .prevFree = nullptr,
+                               .nextFree = nullptr};
+
+  if (range->nextPhys != nullptr)
+    range->nextPhys->prevPhys = rest;
+  range->nextPhys = rest;
+  range->size = size;
+  return rest;
+}
+
+void MemoryBlock::merge(MemoryRange *range, MemoryRange *next) {
+  range->size += next->size;
+  range->nextPhys = next->nextPhys;
+  if (next->nextPhys != nullptr)
+    next->nextPhys->prevPhys = range;
+  delete next;
+}
+
+VkDeviceSize MemoryStats::freeBytes() const {
+  return reservedBytes - usedBytes;
+}
+
+float MemoryStats::fragmentation() const {
+  auto free = freeBytes();
+  if (free == 0)
+    return 0.0f;
+  return 1.0f - (float)largestFreeRange / (float)free;
+}
+
+MemoryStats &MemoryStats::operator+=(MemoryStats const &other) {
+  blockCount += other.blockCount;
+  allocationCount += other.allocationCount;
+  dedicatedAllocationCount += other.dedicatedAllocationCount;
+  freeRangeCount += other.freeRangeCount;
+  reservedBytes += other.reservedBytes;
+  usedBytes += other.usedBytes;
+  largestFreeRange = std::max(largestFreeRange, other.largestFreeRange);
+  return *this;
+}
+
+MemoryAllocation::MemoryAllocation(std::shared_ptr<DeviceMemory> memory,
+                                   VkDeviceSize offset, VkDeviceSize size) {
+  this->memory = memory;
+  this->offset = offset;
+  this->size = size;
+}
+
+MemoryAllocation::~MemoryAllocation() {
+  if (allocator != nullptr)
+    allocator->free(*this);
+}
+
+MemoryAllocation::operator VkDeviceMemory() {
+  return *memory;
+}
+
+std::shared_ptr<DeviceMemory> MemoryAllocation::getMemory() const {
+  return memory;
+}
+
+VkDeviceSize MemoryAllocation::getOffset() const {
+  return offset;
+}
+
+VkDeviceSize MemoryAllocation::getSize() const {
+  return size;
+}
+
+void *MemoryAllocation::map() {
+  return (char *)memory->map() + (size_t)offset;
+}
+
+void MemoryAllocation::flush(VkDeviceSize offset, VkDeviceSize size) {
+  memory->flush(this->offset + offset,
+                size == VK_WHOLE_SIZE ? this->size - offset : size);
+}
+
+void MemoryAllocation::invalidate(VkDeviceSize offset, VkDeviceSize size) {
+  memory->invalidate(this->offset + offset,
+                     size == VK_WHOLE_SIZE ? this->size - offset : size);
+}
+
+void MemoryAllocation::addTo(MappedRangeBatch &batch, VkDeviceSize offset,
+                             VkDeviceSize size) {
+  batch.add(*memory, this->offset + offset,
+            size == VK_WHOLE_SIZE ? this->size - offset : size);
+}
+
+MemoryAllocator::MemoryAllocator(Device &device,
+                                 MemoryAllocatorCreateInfo const &createInfo)
+    : device{device}, createInfo{createInfo} {}
+
+MemoryAllocator::~MemoryAllocator() = default;
+
+std::shared_ptr<MemoryAllocation>
+MemoryAllocator::allocate(MemoryAllocationCreateInfo const &allocInfo) {
+  auto const &reqs = allocInfo.requirements;
+
+  std::vector<uint32_t> memoryTypeIndices;
+  for (auto properties : {std::optional(allocInfo.properties),
+                          allocInfo.fallbackProperties}) {
+    if (!properties.has_value())
+      continue;
+    auto memoryTypeIndex = device.physDev.findMemoryTypeIndex(
+        reqs.memoryTypeBits, *properties, allocInfo.preferredProperties,
+        allocInfo.avoidedProperties);
+    if (memoryTypeIndex.has_value() &&
+        std::find(memoryTypeIndices.begin(), memoryTypeIndices.end(),
+                  *memoryTypeIndex) == memoryTypeIndices.end())
+      memoryTypeIndices.push_back(*memoryTypeIndex);
+  }
+  if (memoryTypeIndices.empty())
+    throw std::runtime_error("no suitable memory type");
+
+  for (auto memoryTypeIndex : memoryTypeIndices)
+    if (auto allocation = tryAllocate(memoryTypeIndex, allocInfo, true))
+      return allocation;
+
+  // Every candidate heap is over budget. Give the application a chance to
+  // release memory (without holding the lock, since that frees allocations)
+  // before going past the budget and leaving it to vkAllocateMemory.
+  auto memoryTypeIndex = memoryTypeIndices.front();
+  auto heapIndex =
+      device.physDev.memoryProps.memoryTypes[memoryTypeIndex].heapIndex;
+  if (device.onEvict(heapIndex, reqs.size) > 0)
+    if (auto allocation = tryAllocate(memoryTypeIndex, allocInfo, true))
+      return allocation;
+
+  return tryAllocate(memoryTypeIndex, allocInfo, false);
+}
+
+MemoryStats MemoryAllocator::getStats() {
+  MemoryStats stats = {};
+  for (uint32_t index = 0; index < device.physDev.memoryProps.memoryTypeCount;
+       ++index)
+    stats += getStats(index);
+  return stats;
+}
+
+MemoryStats MemoryAllocator::getStats(uint32_t memoryTypeIndex) {
+  std::lock_guard<std::mutex> guard(mutex);
+
+  MemoryStats stats = dedicatedStats[memoryTypeIndex];
+  for (auto poolKey : {2 * memoryTypeIndex, 2 * memoryTypeIndex + 1}) {
+    auto iter = pools.find(poolKey);
+    if (iter == pools.end())
+      continue;
+    for (auto const &block : iter->second)
+      block->addStats(stats);
+  }
+  return stats;
+}
+
+std::shared_ptr<MemoryAllocation>
+MemoryAllocator::tryAllocate(uint32_t memoryTypeIndex,
+                             MemoryAllocationCreateInfo const &allocInfo,
+                             bool withinBudget) {
+  auto reqs = allocInfo.requirements;
+
+  // Flushes and invalidates are widened to nonCoherentAtomSize, so
+  // neighbouring sub-allocations must not share an atom.
+  auto const &memoryType =
+      device.physDev.memoryProps.memoryTypes[memoryTypeIndex];
+  if ((memoryType.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+      !(memoryType.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+    auto atomSize = device.physDev.properties.limits.nonCoherentAtomSize;
+    reqs.alignment = alignUp(std::max(reqs.alignment, atomSize), atomSize);
+    reqs.size = alignUp(reqs.size, atomSize);
+  }
+
+  auto blockSize = preferredBlockSize(memoryTypeIndex);
+  auto fitsBudget = [&](VkDeviceSize size) -> bool {
+    return !withinBudget ||
+           device.getMemoryBudget(memoryType.heapIndex).available() >= size;
+  };
+
+  // Lazily allocated memory is committed per allocation as tiles spill;
+  // sub-allocating it from a block would commit it for every neighbour.
+  auto dedicated =
+      allocInfo.dedicated ||
+      (memoryType.propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+
+  std::lock_guard<std::mutex> guard(mutex);
+
+  if (dedicated || reqs.size > blockSize / 2) {
+    if (!fitsBudget(reqs.size))
+      return nullptr;
+
+    auto memory = std::make_shared<DeviceMemory>(
+        stack_ptr(device),
+        MemoryAllocateInfo{.size = reqs.size,
+                           .memoryTypeIndex = memoryTypeIndex});
+
+    auto &stats = dedicatedStats[memoryTypeIndex];
+    stats.allocationCount += 1;
+    stats.dedicatedAllocationCount += 1;
+    stats.reservedBytes += reqs.size;
+    stats.usedBytes += reqs.size;
+
+    auto allocation = std::make_shared<MemoryAllocation>(memory, 0, reqs.size);
+    allocation->allocator = this;
+    return allocation;
+  }
+
+  auto granularity = device.physDev.properties.limits.bufferImageGranularity;
+  auto poolKey = 2 * memoryTypeIndex;
+  if (granularity > 1 && !allocInfo.linear)
+    poolKey += 1;
+
+  auto &pool = pools[poolKey];
+
+  MemoryBlock *block = nullptr;
+  MemoryRange *range = nullptr;
+  for (auto &poolBlock : pool) {
+    range = poolBlock->allocate(reqs.size, reqs.alignment);
+    if (range != nullptr) {
+      block = poolBlock.get();
+      break;
+    }
+  }
+
+  if (range == nullptr) {
+    if (!fitsBudget(blockSize))
+      return nullptr;
+
+    auto memory = std::make_shared<DeviceMemory>(
+        stack_ptr(device),
+        MemoryAllocateInfo{.size = blockSize,
+                           .memoryTypeIndex = memoryTypeIndex});
+    block = pool.emplace_back(std::make_unique<MemoryBlock>(memory, poolKey))
+                .get();
+    range = block->allocate(reqs.size, reqs.alignment);
+  }
+
+  auto allocation = std::make_shared<MemoryAllocation>(
+      block->memory, range->offset, reqs.size);
+  allocation->allocator = this;
+  allocation->block = block;
+  allocation->range = range;
+  return allocation;
+}
+
+VkDeviceSize
+MemoryAllocator::preferredBlockSize(uint32_t memoryTypeIndex) const {
+  auto const &memoryProps = device.physDev.memoryProps;
+  auto heapIndex = memoryProps.memoryTypes[memoryTypeIndex].heapIndex;
+  auto heapSize = memoryProps.memoryHeaps[heapIndex].size;
+
+  if (heapSize <= createInfo.smallHeapMaxSize)
+    return alignUp(heapSize / 8, 32);
+  return createInfo.largeHeapBlockSize;
+}
+
+void MemoryAllocator::free(MemoryAllocation &allocation) {
+  std::lock_guard<std::mutex> guard(mutex);
+
+  if (allocation.block == nullptr) {
+    auto &stats = dedicatedStats[allocation.memory->getMemoryTypeIndex()];
+    stats.allocationCount -= 1;
+    stats.dedicatedAllocationCount -= 1;
+    stats.reservedBytes -= allocation.size;
+    stats.usedBytes -= allocation.size;
+    return;
+  }
+
+  auto *block = allocation.block;
+  block->free(allocation.range);
+  if (!block->empty())
+    return;
+
+  // Keep a single empty block around per pool so that an allocate/free cycle
+  // at the boundary does not hit vkAllocateMemory every time.
+  auto &pool = pools[block->poolKey];
+  auto emptyBlocks = std::count_if(
+      pool.begin(), pool.end(),
+      [](auto const &poolBlock) -> bool { return poolBlock->empty(); });
+  if (emptyBlocks > 1)
+    std::erase_if(pool, [block](auto const &poolBlock) -> bool {
+      return poolBlock.get() == block;
+    });
+}
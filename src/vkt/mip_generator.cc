@@ -0,0 +1,320 @@
+#include <vkt/mip_generator.h>
+#include <vkt/descriptor_pool.h>
+#include <algorithm>
+
+static constexpr uint32_t DOWNSAMPLE_GROUP_SIZE = 8;
+
+static int32_t mipExtent(uint32_t extent, uint32_t level) {
+  return (int32_t)std::max(extent >> level, 1u);
+}
+
+static VkImageSubresourceRange levelRange(Image const &image,
+                                          uint32_t baseMipLevel,
+                                          uint32_t levelCount) {
+  return VkImageSubresourceRange{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                 .baseMipLevel = baseMipLevel,
+                                 .levelCount = levelCount,
+                                 .baseArrayLayer = 0,
+                                 .layerCount = image.createInfo.arrayLayers};
+}
+
+static VkImageMemoryBarrier
+levelBarrier(Image &image, uint32_t baseMipLevel, uint32_t levelCount,
+             VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+             VkImageLayout oldLayout, VkImageLayout newLayout) {
+  return VkImageMemoryBarrier{
+      .srcAccessMask = srcAccessMask,
+      .dstAccessMask = dstAccessMask,
+      .oldLayout = oldLayout,
+      .newLayout = newLayout,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = image,
+      .subresourceRange = levelRange(image, baseMipLevel, levelCount)};
+}
+
+MipGenerator::MipGenerator(std::shared_ptr<Device> device,
+                           MipGeneratorCreateInfo const &createInfo) {
+  this->device = device;
+  this->downsampleShader = createInfo.downsampleShader;
+}
+
+std::optional<MipMethod> MipGenerator::method(Image const &image) {
+  auto const &createInfo = image.createInfo;
+  auto features =
+      device->physDev.getFormatProperties(createInfo.format)
+          .optimalTilingFeatures;
+
+  auto blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                      VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  if ((features & blitFeatures) == blitFeatures &&
+      (createInfo.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+    return MipMethod::Blit;
+
+  auto computeFeatures =
+      VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+  auto computeUsage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+  // The shader's output image has no format qualifier, so that one pipeline
+  // serves every format.
+  if (downsampleShader != nullptr &&
+      device->getEnabledFeatures().shaderStorageImageWriteWithoutFormat &&
+      (features & computeFeatures) == computeFeatures &&
+      (createInfo.usage & computeUsage) == computeUsage &&
+      createInfo.imageType == VK_IMAGE_TYPE_2D && createInfo.arrayLayers == 1)
+    return MipMethod::Compute;
+
+  return std::nullopt;
+}
+
+VkQueueFlags MipGenerator::requiredQueueFlags(Image const &image) {
+  auto mipMethod = method(image);
+  if (!mipMethod.has_value())
+    return {};
+  return *mipMethod == MipMethod::Blit ? VK_QUEUE_GRAPHICS_BIT
+                                       : VK_QUEUE_COMPUTE_BIT;
+}
+
+void MipGenerator::generate(CommandBufferRecording &recording, Image &image,
+                            MipGenerateInfo const &generateInfo,
+                            std::vector<std::shared_ptr<void>> &keepAlive) {
+  if (image.createInfo.mipLevels == 1) {
+    recording.pipelineBarrier(DependencyInfo{
+        .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+        .dstStageMask = generateInfo.dstStageMask,
+        .dependencyFlags = {},
+        .imageMemoryBarriers = {levelBarrier(
+            image, 0, 1, VK_ACCESS_TRANSFER_WRITE_BIT,
+            generateInfo.dstAccessMask, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            generateInfo.dstLayout)}});
+    return;
+  }
+
+  auto mipMethod = method(image);
+  if (!mipMethod.has_value())
+    throw std::runtime_error("image format cannot be mip-mapped");
+
+  if (*mipMethod == MipMethod::Blit)
+    generateBlit(recording, image, generateInfo);
+  else
+    generateCompute(recording, image, generateInfo, keepAlive);
+}
+
+void MipGenerator::generateBlit(CommandBufferRecording &recording,
+                                Image &image,
+                                MipGenerateInfo const &generateInfo) {
+  auto const &createInfo = image.createInfo;
+  auto levels = createInfo.mipLevels;
+
+  recording.pipelineBarrier(DependencyInfo{
+      .srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+      .dependencyFlags = {},
+      .imageMemoryBarriers = {levelBarrier(
+          image, 1, levels - 1, {}, VK_ACCESS_TRANSFER_WRITE_BIT,
+          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)}});
+
+  for (uint32_t level = 1; level < levels; ++level) {
+    recording.pipelineBarrier(DependencyInfo{
+        .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+        .dependencyFlags = {},
+        .imageMemoryBarriers = {levelBarrier(
+            image, level - 1, 1, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_TRANSFER_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)}});
+
+    auto subresource = [&](uint32_t mipLevel) -> auto {
+      return VkImageSubresourceLayers{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                                      .mipLevel = mipLevel,
+                                      .baseArrayLayer = 0,
+                                      .layerCount = createInfo.arrayLayers};
+    };
+    auto extent = [&](uint32_t mipLevel) -> auto {
+      return VkOffset3D{.x = mipExtent(createInfo.extent.width, mipLevel),
+                        .y = mipExtent(createInfo.extent.height, mipLevel),
+                        .z = mipExtent(createInfo.extent.depth, mipLevel)};
+    };
+
+    recording.blitImage(BlitImageInfo{
+        .srcImage = image,
+        .srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .dstImage = image,
+        .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .regions = {VkImageBlit{
+            .srcSubresource = subresource(level - 1),
+            .srcOffsets = {VkOffset3D{}, extent(level - 1)},
+            .dstSubresource = subresource(level),
+            .dstOffsets = {VkOffset3D{}, extent(level)}}},
+        .filter = VK_FILTER_LINEAR});
+  }
+
+  recording.pipelineBarrier(DependencyInfo{
+      .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+      .dstStageMask = generateInfo.dstStageMask,
+      .dependencyFlags = {},
+      .imageMemoryBarriers = {
+          levelBarrier(image, 0, levels - 1, VK_ACCESS_TRANSFER_WRITE_BIT,
+                       generateInfo.dstAccessMask,
+                       VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       generateInfo.dstLayout),
+          levelBarrier(image, levels - 1, 1, VK_ACCESS_TRANSFER_WRITE_BIT,
+                       generateInfo.dstAccessMask,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       generateInfo.dstLayout)}});
+}
+
+void MipGenerator::generateCompute(
+    CommandBufferRecording &recording, Image &image,
+    MipGenerateInfo const &generateInfo,
+    std::vector<std::shared_ptr<void>> &keepAlive) {
+  if (pipeline == nullptr)
+    createComputePipeline();
+
+  auto const &createInfo = image.createInfo;
+  auto levels = createInfo.mipLevels;
+
+  auto descriptorPool = std::make_shared<DescriptorPool>(
+      device,
+      DescriptorPoolCreateInfo{
+          .maxSets = levels - 1,
+          .poolSizes = {
+              VkDescriptorPoolSize{
+                  .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                  .descriptorCount = levels - 1},
+              VkDescriptorPoolSize{.type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                   .descriptorCount = levels - 1}}});
+  keepAlive.push_back(descriptorPool);
+  keepAlive.push_back(pipeline);
+  keepAlive.push_back(sampler);
+
+  std::vector<VkDescriptorSetLayout> setLayouts(levels - 1, *setLayout);
+  auto descriptorSets = descriptorPool->allocateDescriptorSets(
+      DescriptorSetAllocateInfo{.setLayouts = setLayouts});
+
+  std::vector<std::shared_ptr<ImageView>> levelViews;
+  for (uint32_t level = 0; level < levels; ++level) {
+    levelViews.push_back(std::make_shared<ImageView>(
+        device, ImageViewCreateInfo{.flags = {},
+                                    .image = image,
+                                    .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                                    .format = createInfo.format,
+                                    .components = {},
+                                    .subresourceRange =
+                                        levelRange(image, level, 1)}));
+    keepAlive.push_back(levelViews.back());
+  }
+
+  std::vector<DescriptorOp> writes;
+  for (uint32_t level = 1; level < levels; ++level) {
+    auto dstSet = descriptorSets[level - 1];
+    writes.push_back(WriteDescriptorSet{
+        .dstSet = dstSet,
+        .dstBinding = 0,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .imageInfos = {VkDescriptorImageInfo{
+            .sampler = *sampler,
+            .imageView = *levelViews[level - 1],
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL}}});
+    writes.push_back(WriteDescriptorSet{
+        .dstSet = dstSet,
+        .dstBinding = 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        .imageInfos = {VkDescriptorImageInfo{
+            .sampler = VK_NULL_HANDLE,
+            .imageView = *levelViews[level],
+            .imageLayout = VK_IMAGE_LAYOUT_GENERAL}}});
+  }
+  device->updateDescriptorSets(writes);
+
+  recording.pipelineBarrier(DependencyInfo{
+      .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      .dependencyFlags = {},
+      .imageMemoryBarriers = {
+          levelBarrier(image, 0, 1, VK_ACCESS_TRANSFER_WRITE_BIT,
+                       VK_ACCESS_SHADER_READ_BIT,
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+          levelBarrier(image, 1, levels - 1, {}, VK_ACCESS_SHADER_WRITE_BIT,
+                       VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL)}});
+
+  recording.bindPipeline(VK_PIPELINE_BIND_POINT_COMPUTE, *pipeline);
+
+  for (uint32_t level = 1; level < levels; ++level) {
+    recording.bindDescriptorSets(VK_PIPELINE_BIND_POINT_COMPUTE,
+                                 *pipelineLayout, 0,
+                                 {descriptorSets[level - 1]});
+
+    auto groups = [](int32_t extent) -> uint32_t {
+      return ((uint32_t)extent + DOWNSAMPLE_GROUP_SIZE - 1) /
+             DOWNSAMPLE_GROUP_SIZE;
+    };
+    recording.dispatch(groups(mipExtent(createInfo.extent.width, level)),
+                       groups(mipExtent(createInfo.extent.height, level)), 1);
+
+    recording.pipelineBarrier(DependencyInfo{
+        .srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        .dependencyFlags = {},
+        .imageMemoryBarriers = {levelBarrier(
+            image, level, 1, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_GENERAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)}});
+  }
+
+  recording.pipelineBarrier(DependencyInfo{
+      .srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      .dstStageMask = generateInfo.dstStageMask,
+      .dependencyFlags = {},
+      .imageMemoryBarriers = {levelBarrier(
+          image, 0, levels, VK_ACCESS_SHADER_WRITE_BIT,
+          generateInfo.dstAccessMask,
+          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, generateInfo.dstLayout)}});
+}
+
+void MipGenerator::createComputePipeline() {
+  setLayout = std::make_shared<DescriptorSetLayout>(
+      device,
+      DescriptorSetLayoutCreateInfo{
+          .flags = {},
+          .bindings = {
+              VkDescriptorSetLayoutBinding{
+                  .binding = 0,
+                  .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                  .descriptorCount = 1,
+                  .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                  .pImmutableSamplers = nullptr},
+              VkDescriptorSetLayoutBinding{
+                  .binding = 1,
+                  .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                  .descriptorCount = 1,
+                  .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+                  .pImmutableSamplers = nullptr}}});
+
+  pipelineLayout = std::make_shared<PipelineLayout>(
+      device, PipelineLayoutCreateInfo{.setLayouts = {*setLayout},
+                                       .pushConstantRanges = {}});
+
+  pipeline = std::make_shared<ComputePipeline>(
+      device,
+      ComputePipelineCreateInfo{
+          .shaderStage = ShaderStageCreateInfo{.stage =
+                                                   VK_SHADER_STAGE_COMPUTE_BIT,
+                                               .module = downsampleShader,
+                                               .name = "main",
+                                               .specializationInfo = {}},
+          .pipelineLayout = pipelineLayout});
+
+  sampler = std::make_shared<Sampler>(
+      device, VkSamplerCreateInfo{
+                  .magFilter = VK_FILTER_NEAREST,
+                  .minFilter = VK_FILTER_NEAREST,
+                  .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+                  .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                  .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                  .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                  .maxLod = 0.0f});
+}
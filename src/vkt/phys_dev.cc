@@ -1,4 +1,11 @@
 #include <vkt/phys_dev.h>
+#include <vkt/utils.h>
+#include <bit>
+
+// Core formats have contiguous enum values and are queried up front;
+// extension formats are looked up on first use.
+static constexpr uint32_t CORE_FORMAT_COUNT =
+    VK_FORMAT_ASTC_12x12_SRGB_BLOCK + 1;
 
 PhysicalDevice::PhysicalDevice(std::shared_ptr<Loader> loader,
                                VkPhysicalDevice physicalDevice) {
@@ -17,24 +24,47 @@ PhysicalDevice::PhysicalDevice(std::shared_ptr<Loader> loader,
       physicalDevice, &queueFamilyCount, queueFamilies.data());
 
   loader->vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProps);
+
+  caps = std::make_shared<CapabilityCache>();
+  caps->coreFormats.resize(CORE_FORMAT_COUNT);
+  for (uint32_t format = 0; format < CORE_FORMAT_COUNT; ++format)
+    loader->vkGetPhysicalDeviceFormatProperties(
+        physicalDevice, (VkFormat)format, &caps->coreFormats[format]);
 }
 
 PhysicalDevice::operator VkPhysicalDevice() {
   return physicalDevice;
 }
 
-std::optional<uint32_t>
-PhysicalDevice::findMemoryTypeIndex(uint32_t memoryTypeBits,
-                                    VkMemoryPropertyFlags requiredProperties) {
+std::optional<uint32_t> PhysicalDevice::findMemoryTypeIndex(
+    uint32_t memoryTypeBits, VkMemoryPropertyFlags requiredProperties,
+    VkMemoryPropertyFlags preferredProperties,
+    VkMemoryPropertyFlags avoidedProperties) const {
+  std::optional<uint32_t> best;
+  int bestScore = 0;
+
   for (uint32_t index = 0; index < memoryProps.memoryTypeCount; ++index) {
-    auto const &memoryType = memoryProps.memoryTypes[index];
-    if (memoryTypeBits & ((uint32_t)1 << index) == 0)
+    auto flags = memoryProps.memoryTypes[index].propertyFlags;
+    if ((memoryTypeBits & ((uint32_t)1 << index)) == 0)
       continue;
-    if ((memoryType.propertyFlags & requiredProperties) != requiredProperties)
+    if ((flags & requiredProperties) != requiredProperties)
       continue;
-    return index;
+
+    // Preferred and avoided flags dominate; unrequested extras (e.g.
+    // HOST_CACHED on an upload heap) only break ties.
+    auto unrequested =
+        flags & ~(requiredProperties | preferredProperties | avoidedProperties);
+    int score = 4 * std::popcount(flags & preferredProperties) -
+                4 * std::popcount(flags & avoidedProperties) -
+                std::popcount(unrequested);
+
+    if (!best.has_value() || score > bestScore) {
+      best = index;
+      bestScore = score;
+    }
   }
-  return std::nullopt;
+
+  return best;
 }
 
 std::optional<VkFormat>
@@ -42,17 +72,69 @@ PhysicalDevice::findSuitableFormat(std::vector<VkFormat> const &candidates,
                                    VkFormatFeatureFlags requiredFeatures,
                                    bool optimal) {
   for (auto format : candidates) {
-    VkFormatProperties props;
-    loader->vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
-
-    if (optimal) {
-      if (props.optimalTilingFeatures & requiredFeatures == requiredFeatures)
-        return format;
-    } else {
-      if (props.linearTilingFeatures & requiredFeatures == requiredFeatures)
-        return format;
-    }
+    auto props = getFormatProperties(format);
+    auto features =
+        optimal ? props.optimalTilingFeatures : props.linearTilingFeatures;
+    if ((features & requiredFeatures) == requiredFeatures)
+      return format;
   }
 
   return std::nullopt;
-}
\ No newline at end of file
+}
+
+std::optional<VkFormat> PhysicalDevice::findDepthFormat(bool stencil) {
+  if (stencil)
+    return findSuitableFormat({VK_FORMAT_D24_UNORM_S8_UINT,
+                               VK_FORMAT_D32_SFLOAT_S8_UINT,
+                               VK_FORMAT_D16_UNORM_S8_UINT},
+                              VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+
+  return findSuitableFormat(
+      {VK_FORMAT_D32_SFLOAT, VK_FORMAT_X8_D24_UNORM_PACK32,
+       VK_FORMAT_D16_UNORM, VK_FORMAT_D24_UNORM_S8_UINT,
+       VK_FORMAT_D32_SFLOAT_S8_UINT},
+      VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+}
+
+VkFormatProperties PhysicalDevice::getFormatProperties(VkFormat format) {
+  if ((uint32_t)format < CORE_FORMAT_COUNT)
+    return caps->coreFormats[format];
+
+  std::lock_guard<std::mutex> guard(caps->mutex);
+  auto iter = caps->extensionFormats.find(format);
+  if (iter == caps->extensionFormats.end()) {
+    VkFormatProperties props;
+    loader->vkGetPhysicalDeviceFormatProperties(physicalDevice, format,
+                                                &props);
+    iter = caps->extensionFormats.emplace(format, props).first;
+  }
+  return iter->second;
+}
+
+std::optional<VkImageFormatProperties>
+PhysicalDevice::getImageFormatProperties(ImageFormatQuery const &query) const {
+  {
+    std::shared_lock<std::shared_mutex> lock(caps->imageFormatsMutex);
+    auto iter = caps->imageFormats.find(query);
+    if (iter != caps->imageFormats.end())
+      return iter->second;
+  }
+
+  // Racing misses query twice and keep the first result, which is the same.
+  auto props = queryImageFormatProperties(query);
+  std::unique_lock<std::shared_mutex> lock(caps->imageFormatsMutex);
+  return caps->imageFormats.emplace(query, props).first->second;
+}
+
+std::optional<VkImageFormatProperties>
+PhysicalDevice::queryImageFormatProperties(
+    ImageFormatQuery const &query) const {
+  VkImageFormatProperties props;
+  auto result = loader->vkGetPhysicalDeviceImageFormatProperties(
+      physicalDevice, query.format, query.type, query.tiling, query.usage,
+      query.flags, &props);
+  if (result == VK_ERROR_FORMAT_NOT_SUPPORTED)
+    return std::nullopt;
+  VK_CHECK(result);
+  return props;
+}
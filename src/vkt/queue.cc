@@ -1,10 +1,29 @@
 #include <vkt/queue.h>
+#include <array>
+
+// Stack storage for up to N elements that only goes to the heap beyond.
+template <typename T, size_t N> class InlineBuffer {
+public:
+  explicit InlineBuffer(size_t size) : size{size} {
+    if (size > N)
+      heap.resize(size);
+  }
+
+  T *data() { return size > N ? heap.data() : local.data(); }
+  T &operator[](size_t index) { return data()[index]; }
+
+private:
+  size_t size;
+  std::array<T, N> local;
+  std::vector<T> heap;
+};
 
 Queue::Queue(std::shared_ptr<Device> device, uint32_t queueFamilyIndex,
              uint32_t queueIndex) {
   this->device = device;
   this->queueFamilyIndex = queueFamilyIndex;
   this->queueIndex = queueIndex;
+  this->mutex = &device->getQueueMutex(queueFamilyIndex, queueIndex);
   device->vkGetDeviceQueue(*device, queueFamilyIndex, queueIndex, &queue);
 }
 
@@ -15,7 +34,11 @@ Queue::Queue(Queue &&other) {
 Queue &Queue::operator=(Queue &&other) {
   device = std::move(other.device);
   queue = other.queue;
+  queueFamilyIndex = other.queueFamilyIndex;
+  queueIndex = other.queueIndex;
+  mutex = other.mutex;
   other.queue = VK_NULL_HANDLE;
+  other.mutex = nullptr;
   return *this;
 }
 
@@ -24,25 +47,147 @@ Queue::operator VkQueue() {
 }
 
 void Queue::submit(QueueSubmitInfo const &submitInfo) {
-  std::vector<VkSemaphore> waitSemaphores;
-  std::vector<VkPipelineStageFlags> waitDstStageMasks;
-  for (auto const &[semaphore, stage] : submitInfo.waitSemaphoresAndStages) {
-    waitSemaphores.push_back(semaphore);
-    waitDstStageMasks.push_back(stage);
+  auto waitCount = submitInfo.waitSemaphoresAndStages.size();
+  InlineBuffer<VkSemaphoreSubmitInfo, 8> waitSemaphores(waitCount);
+  for (size_t index = 0; index < waitCount; ++index) {
+    auto [semaphore, stage] = submitInfo.waitSemaphoresAndStages[index];
+    waitSemaphores[index] = VkSemaphoreSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .semaphore = semaphore,
+        .value = index < submitInfo.waitValues.size()
+                     ? submitInfo.waitValues[index]
+                     : 0,
+        .stageMask = stage,
+        .deviceIndex = 0};
   }
 
-  auto vk_submitInfo = VkSubmitInfo{
-      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-      .pNext = nullptr,
-      .waitSemaphoreCount = (uint32_t)waitSemaphores.size(),
-      .pWaitSemaphores = waitSemaphores.data(),
-      .pWaitDstStageMask = waitDstStageMasks.data(),
-      .commandBufferCount = (uint32_t)submitInfo.commandBuffers.size(),
-      .pCommandBuffers = submitInfo.commandBuffers.data(),
-      .signalSemaphoreCount = (uint32_t)submitInfo.signalSemaphores.size(),
-      .pSignalSemaphores = submitInfo.signalSemaphores.data()};
-
-  VK_CHECK(device->vkQueueSubmit(queue, 1, &vk_submitInfo, submitInfo.fence));
+  auto commandBufferCount = submitInfo.commandBuffers.size();
+  InlineBuffer<VkCommandBufferSubmitInfo, 8> commandBuffers(
+      commandBufferCount);
+  for (size_t index = 0; index < commandBufferCount; ++index)
+    commandBuffers[index] = VkCommandBufferSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .pNext = nullptr,
+        .commandBuffer = submitInfo.commandBuffers[index],
+        .deviceMask = 0};
+
+  // vkQueueSubmit signals once all commands have completed.
+  auto signalCount = submitInfo.signalSemaphores.size();
+  InlineBuffer<VkSemaphoreSubmitInfo, 8> signalSemaphores(signalCount);
+  for (size_t index = 0; index < signalCount; ++index)
+    signalSemaphores[index] = VkSemaphoreSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .semaphore = submitInfo.signalSemaphores[index],
+        .value = index < submitInfo.signalValues.size()
+                     ? submitInfo.signalValues[index]
+                     : 0,
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .deviceIndex = 0};
+
+  auto batch = QueueSubmitBatch{
+      .waitSemaphores = {waitSemaphores.data(), waitCount},
+      .commandBuffers = {commandBuffers.data(), commandBufferCount},
+      .signalSemaphores = {signalSemaphores.data(), signalCount}};
+  submit({&batch, 1}, submitInfo.fence);
+}
+
+void Queue::submit(std::span<QueueSubmitBatch const> batches, VkFence fence) {
+  if (!device->getExtendedFeatures().synchronization2) {
+    submitLegacy(batches, fence);
+    return;
+  }
+
+  InlineBuffer<VkSubmitInfo2, 8> submitInfos(batches.size());
+  for (size_t index = 0; index < batches.size(); ++index) {
+    auto const &batch = batches[index];
+    submitInfos[index] = VkSubmitInfo2{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .pNext = nullptr,
+        .flags = {},
+        .waitSemaphoreInfoCount = (uint32_t)batch.waitSemaphores.size(),
+        .pWaitSemaphoreInfos = batch.waitSemaphores.data(),
+        .commandBufferInfoCount = (uint32_t)batch.commandBuffers.size(),
+        .pCommandBufferInfos = batch.commandBuffers.data(),
+        .signalSemaphoreInfoCount = (uint32_t)batch.signalSemaphores.size(),
+        .pSignalSemaphoreInfos = batch.signalSemaphores.data()};
+  }
+
+  std::lock_guard<std::mutex> guard(*mutex);
+  VK_CHECK(device->vkQueueSubmit2(queue, (uint32_t)batches.size(),
+                                  submitInfos.data(), fence));
+}
+
+// Splits the batches' structs into the separate arrays of VkSubmitInfo.
+// Signals always wait for all commands, and stage bits beyond the first 32
+// are rejected.
+void Queue::submitLegacy(std::span<QueueSubmitBatch const> batches,
+                         VkFence fence) {
+  size_t waitCount = 0, commandBufferCount = 0, signalCount = 0;
+  for (auto const &batch : batches) {
+    waitCount += batch.waitSemaphores.size();
+    commandBufferCount += batch.commandBuffers.size();
+    signalCount += batch.signalSemaphores.size();
+  }
+
+  InlineBuffer<VkSemaphore, 16> waitSemaphores(waitCount);
+  InlineBuffer<VkPipelineStageFlags, 16> waitStages(waitCount);
+  InlineBuffer<uint64_t, 16> waitValues(waitCount);
+  InlineBuffer<VkCommandBuffer, 16> commandBuffers(commandBufferCount);
+  InlineBuffer<VkSemaphore, 16> signalSemaphores(signalCount);
+  InlineBuffer<uint64_t, 16> signalValues(signalCount);
+  InlineBuffer<VkTimelineSemaphoreSubmitInfo, 8> timelineInfos(batches.size());
+  InlineBuffer<VkSubmitInfo, 8> submitInfos(batches.size());
+
+  size_t wait = 0, commandBuffer = 0, signal = 0;
+  for (size_t index = 0; index < batches.size(); ++index) {
+    auto const &batch = batches[index];
+    auto firstWait = wait, firstCommandBuffer = commandBuffer,
+         firstSignal = signal;
+    auto hasValues = false;
+
+    for (auto const &semaphore : batch.waitSemaphores) {
+      if (semaphore.stageMask >> 32 != 0)
+        throw std::runtime_error("wait stage needs synchronization2");
+      waitSemaphores[wait] = semaphore.semaphore;
+      waitStages[wait] = (VkPipelineStageFlags)semaphore.stageMask;
+      waitValues[wait] = semaphore.value;
+      hasValues |= semaphore.value != 0;
+      ++wait;
+    }
+    for (auto const &info : batch.commandBuffers)
+      commandBuffers[commandBuffer++] = info.commandBuffer;
+    for (auto const &semaphore : batch.signalSemaphores) {
+      signalSemaphores[signal] = semaphore.semaphore;
+      signalValues[signal] = semaphore.value;
+      hasValues |= semaphore.value != 0;
+      ++signal;
+    }
+
+    timelineInfos[index] = VkTimelineSemaphoreSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .waitSemaphoreValueCount = (uint32_t)(wait - firstWait),
+        .pWaitSemaphoreValues = waitValues.data() + firstWait,
+        .signalSemaphoreValueCount = (uint32_t)(signal - firstSignal),
+        .pSignalSemaphoreValues = signalValues.data() + firstSignal};
+
+    submitInfos[index] = VkSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = hasValues ? &timelineInfos[index] : nullptr,
+        .waitSemaphoreCount = (uint32_t)(wait - firstWait),
+        .pWaitSemaphores = waitSemaphores.data() + firstWait,
+        .pWaitDstStageMask = waitStages.data() + firstWait,
+        .commandBufferCount = (uint32_t)(commandBuffer - firstCommandBuffer),
+        .pCommandBuffers = commandBuffers.data() + firstCommandBuffer,
+        .signalSemaphoreCount = (uint32_t)(signal - firstSignal),
+        .pSignalSemaphores = signalSemaphores.data() + firstSignal};
+  }
+
+  std::lock_guard<std::mutex> guard(*mutex);
+  VK_CHECK(device->vkQueueSubmit(queue, (uint32_t)batches.size(),
+                                 submitInfos.data(), fence));
 }
 
 VkResult Queue::present(QueuePresentInfo const &presentInfo) {
@@ -64,10 +209,12 @@ VkResult Queue::present(QueuePresentInfo const &presentInfo) {
       .pImageIndices = imageIndices.data(),
       .pResults = nullptr};
 
+  std::lock_guard<std::mutex> guard(*mutex);
   return device->vkQueuePresentKHR(queue, &vk_presentInfo);
 }
 
 void Queue::wait() {
+  std::lock_guard<std::mutex> guard(*mutex);
   VK_CHECK(device->vkQueueWaitIdle(queue));
 }
 
@@ -0,0 +1,246 @@
+#include <vkt/readback.h>
+#include <algorithm>
+
+ReadbackRing::ReadbackRing(std::shared_ptr<Device> device, Queue const &queue,
+                           ReadbackRingCreateInfo const &createInfo)
+    : queue{queue} {
+  this->device = device;
+  this->createInfo = createInfo;
+
+  commandPool = std::make_shared<CommandPool>(
+      device,
+      CommandPoolCreateInfo{
+          .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                   VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+          .queueFamilyIndex = this->queue.getQueueFamilyIndex()});
+
+  slots.resize(std::max(createInfo.slotCount, 1u));
+  for (auto &slot : slots) {
+    slot.commandBuffer = std::make_shared<CommandBuffer>(
+        device,
+        CommandBufferAllocateInfo{.commandPool = commandPool,
+                                  .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY});
+    slot.fence = std::make_shared<Fence>(device);
+  }
+}
+
+ReadbackRing::~ReadbackRing() {
+  for (; oldestInFlight < nextId; ++oldestInFlight)
+    slots[oldestInFlight % slots.size()].fence->wait();
+}
+
+std::optional<uint64_t> ReadbackRing::readImage(
+    Image &image, ReadbackImageInfo const &readInfo,
+    std::vector<std::pair<VkSemaphore, VkPipelineStageFlags>> const
+        &waitSemaphoresAndStages) {
+  auto format = image.createInfo.format;
+  auto texelSize = formatTexelSize(format);
+  if (texelSize == 0)
+    throw std::runtime_error("unsupported readback format");
+
+  auto extent = image.createInfo.extent;
+  extent.width = std::max(extent.width >> readInfo.mipLevel, 1u);
+  extent.height = std::max(extent.height >> readInfo.mipLevel, 1u);
+  extent.depth = std::max(extent.depth >> readInfo.mipLevel, 1u);
+  auto size = (VkDeviceSize)texelSize * extent.width * extent.height *
+              extent.depth;
+
+  auto *slot = acquireSlot(size);
+  if (slot == nullptr)
+    return std::nullopt;
+  slot->format = format;
+  slot->extent = extent;
+
+  auto subresourceRange =
+      VkImageSubresourceRange{.aspectMask = readInfo.aspectMask,
+                              .baseMipLevel = readInfo.mipLevel,
+                              .levelCount = 1,
+                              .baseArrayLayer = readInfo.arrayLayer,
+                              .layerCount = 1};
+
+  {
+    CommandBufferRecording recording(
+        slot->commandBuffer,
+        CommandBufferBeginInfo{
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT});
+
+    recording.pipelineBarrier(
+        DependencyInfo{.srcStageMask = readInfo.srcStageMask,
+                       .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       .dependencyFlags = {},
+                       .imageMemoryBarriers = {VkImageMemoryBarrier{
+                           .srcAccessMask = readInfo.srcAccessMask,
+                           .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+                           .oldLayout = readInfo.layout,
+                           .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                           .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                           .image = image,
+                           .subresourceRange = subresourceRange}}});
+
+    recording.copyImageToBuffer(CopyImageToBufferInfo{
+        .srcImage = image,
+        .srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .dstBuffer = *slot->buffer,
+        .regions = {VkBufferImageCopy{
+            .bufferOffset = 0,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = {.aspectMask = readInfo.aspectMask,
+                                 .mipLevel = readInfo.mipLevel,
+                                 .baseArrayLayer = readInfo.arrayLayer,
+                                 .layerCount = 1},
+            .imageOffset = {},
+            .imageExtent = extent}}});
+
+    recording.pipelineBarrier(DependencyInfo{
+        .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+        .dstStageMask = readInfo.dstStageMask | VK_PIPELINE_STAGE_HOST_BIT,
+        .dependencyFlags = {},
+        .memoryBarriers = {VkMemoryBarrier{
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT}},
+        .imageMemoryBarriers = {VkImageMemoryBarrier{
+            .srcAccessMask = {},
+            .dstAccessMask = readInfo.dstAccessMask,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .newLayout = readInfo.layout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = subresourceRange}}});
+  }
+
+  submit(*slot, waitSemaphoresAndStages);
+  return slot->id;
+}
+
+std::optional<uint64_t>
+ReadbackRing::readBuffer(Buffer &buffer, ReadbackBufferInfo const &readInfo) {
+  auto *slot = acquireSlot(readInfo.size);
+  if (slot == nullptr)
+    return std::nullopt;
+  slot->format = VK_FORMAT_UNDEFINED;
+  slot->extent = VkExtent3D{};
+
+  {
+    CommandBufferRecording recording(
+        slot->commandBuffer,
+        CommandBufferBeginInfo{
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT});
+
+    recording.pipelineBarrier(DependencyInfo{
+        .srcStageMask = readInfo.srcStageMask,
+        .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+        .dependencyFlags = {},
+        .memoryBarriers = {VkMemoryBarrier{
+            .srcAccessMask = readInfo.srcAccessMask,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT}}});
+
+    recording.copyBuffer(buffer, *slot->buffer,
+                         {VkBufferCopy{.srcOffset = readInfo.offset,
+                                       .dstOffset = 0,
+                                       .size = readInfo.size}});
+
+    recording.pipelineBarrier(DependencyInfo{
+        .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_HOST_BIT,
+        .dependencyFlags = {},
+        .memoryBarriers = {VkMemoryBarrier{
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT}}});
+  }
+
+  submit(*slot, {});
+  return slot->id;
+}
+
+uint32_t ReadbackRing::poll() {
+  uint32_t delivered = 0;
+  while (oldestInFlight < nextId &&
+         slots[oldestInFlight % slots.size()].fence->isSignalled()) {
+    deliverOldest();
+    ++delivered;
+  }
+  return delivered;
+}
+
+std::optional<ReadbackFrame> ReadbackRing::pop() {
+  if (completed.empty())
+    return std::nullopt;
+  auto frame = std::move(completed.front());
+  completed.pop_front();
+  return frame;
+}
+
+void ReadbackRing::waitIdle() {
+  while (oldestInFlight < nextId)
+    deliverOldest();
+}
+
+uint64_t ReadbackRing::getDroppedCount() const {
+  return droppedCount;
+}
+
+ReadbackRing::Slot *ReadbackRing::acquireSlot(VkDeviceSize size) {
+  if (nextId - oldestInFlight == slots.size()) {
+    auto &oldest = slots[oldestInFlight % slots.size()];
+    if (createInfo.dropWhenFull && !oldest.fence->isSignalled()) {
+      ++droppedCount;
+      return nullptr;
+    }
+    deliverOldest();
+  }
+
+  auto &slot = slots[nextId % slots.size()];
+  if (slot.capacity < size) {
+    slot.capacity = std::max(size, createInfo.initialSlotSize);
+    slot.buffer = std::make_shared<Buffer>(
+        device,
+        BufferCreateInfo{.size = slot.capacity,
+                         .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                         .queueFamilyIndices = {queue.getQueueFamilyIndex()}});
+    slot.memory = &slot.buffer->allocMemory(
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    slot.memory->map();
+  }
+
+  slot.id = nextId++;
+  slot.size = size;
+  return &slot;
+}
+
+void ReadbackRing::submit(
+    Slot &slot, std::vector<std::pair<VkSemaphore, VkPipelineStageFlags>> const
+                    &waitSemaphoresAndStages) {
+  slot.fence->reset();
+  queue.submit(QueueSubmitInfo{.waitSemaphoresAndStages =
+                                   waitSemaphoresAndStages,
+                               .commandBuffers = {*slot.commandBuffer},
+                               .signalSemaphores = {},
+                               .fence = *slot.fence});
+}
+
+void ReadbackRing::deliverOldest() {
+  auto &slot = slots[oldestInFlight % slots.size()];
+  slot.fence->wait();
+  slot.memory->invalidate(0, slot.size);
+
+  auto data = std::span<std::byte const>(
+      (std::byte const *)slot.memory->map(), (size_t)slot.size);
+  if (onReadback) {
+    onReadback(ReadbackView{.id = slot.id,
+                            .format = slot.format,
+                            .extent = slot.extent,
+                            .data = data});
+  } else {
+    completed.push_back(ReadbackFrame{.id = slot.id,
+                                      .format = slot.format,
+                                      .extent = slot.extent,
+                                      .data = {data.begin(), data.end()}});
+  }
+
+  ++oldestInFlight;
+}
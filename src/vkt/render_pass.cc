@@ -19,12 +19,31 @@ RenderPass::RenderPass(std::shared_ptr<Device> device,
             .pPreserveAttachments = subpass.preserve.data()};
       });
 
+  auto attachments = createInfo.attachments;
+  for (uint32_t index = 0; index < attachments.size(); ++index) {
+    auto &attachment = attachments[index];
+
+    if (!(formatAspects(attachment.format) & VK_IMAGE_ASPECT_STENCIL_BIT)) {
+      attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    }
+
+    if (createInfo.transientAttachments.contains(index)) {
+      if (attachment.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD)
+        attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      if (attachment.stencilLoadOp == VK_ATTACHMENT_LOAD_OP_LOAD)
+        attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    }
+  }
+
   auto vk_createInfo = VkRenderPassCreateInfo{
       .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
       .pNext = VK_NULL_HANDLE,
       .flags = {},
-      .attachmentCount = (uint32_t)createInfo.attachments.size(),
-      .pAttachments = createInfo.attachments.data(),
+      .attachmentCount = (uint32_t)attachments.size(),
+      .pAttachments = attachments.data(),
       .subpassCount = (uint32_t)vk_subpasses.size(),
       .pSubpasses = vk_subpasses.data(),
       .dependencyCount = (uint32_t)createInfo.dependencies.size(),
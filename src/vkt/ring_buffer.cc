@@ -0,0 +1,63 @@
+#include <vkt/ring_buffer.h>
+#include <stdexcept>
+
+uint32_t RingAllocation::dynamicOffset() const {
+  return (uint32_t)offset;
+}
+
+RingBuffer::RingBuffer(std::shared_ptr<Device> device,
+                       RingBufferCreateInfo const &createInfo) {
+  this->device = device;
+  this->framesInFlight = createInfo.framesInFlight;
+  if (framesInFlight == 0)
+    throw std::runtime_error("ring buffer needs at least one frame in flight");
+
+  auto const &limits = device->physDev.properties.limits;
+  alignment = std::max(limits.minUniformBufferOffsetAlignment,
+                       limits.minStorageBufferOffsetAlignment);
+  frameSize = (createInfo.frameSize + alignment - 1) / alignment * alignment;
+
+  buffer = std::make_shared<Buffer>(
+      device,
+      BufferCreateInfo{.size = frameSize * createInfo.framesInFlight,
+                       .usage = createInfo.usage,
+                       .sharingMode = VK_SHARING_MODE_CONCURRENT,
+                       .queueFamilyIndices = createInfo.queueFamilyIndices});
+
+  // Written every frame and read once by the GPU: device-local host-visible
+  // (ReBAR) memory is the best fit where it exists.
+  auto &memory = buffer->allocMemory(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  memoryMap = memory.map();
+}
+
+RingBuffer::operator VkBuffer() {
+  return *buffer;
+}
+
+void RingBuffer::beginFrame(uint32_t frameIndex, Fence &frameFence) {
+  if (frameIndex >= framesInFlight)
+    throw std::runtime_error("ring buffer frame index out of range");
+  frameFence.wait();
+  frameBegin = frameIndex * frameSize;
+  head = frameBegin;
+}
+
+RingAllocation RingBuffer::allocate(VkDeviceSize size,
+                                    VkDeviceSize alignment) {
+  alignment = std::max(alignment, this->alignment);
+  auto offset = (head + alignment - 1) / alignment * alignment;
+  if (offset + size > frameBegin + frameSize)
+    throw std::runtime_error("ring buffer frame region exhausted");
+
+  head = offset + size;
+  return RingAllocation{.buffer = *buffer,
+                        .offset = offset,
+                        .size = size,
+                        .data = (char *)memoryMap + (size_t)offset};
+}
+
+VkDescriptorBufferInfo RingBuffer::descriptorInfo(VkDeviceSize range) const {
+  return VkDescriptorBufferInfo{.buffer = *buffer, .offset = 0, .range = range};
+}
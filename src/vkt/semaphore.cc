@@ -21,4 +21,64 @@ Semaphore::Semaphore(std::shared_ptr<Device> device) {
 
 Semaphore::operator VkSemaphore() {
   return semaphore;
+}
+
+TimelineSemaphore::TimelineSemaphore(std::shared_ptr<Device> device,
+                                     uint64_t initialValue) {
+  this->device = device;
+  auto vk_typeCreateInfo = VkSemaphoreTypeCreateInfo{
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+      .pNext = nullptr,
+      .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+      .initialValue = initialValue};
+  auto vk_createInfo =
+      VkSemaphoreCreateInfo{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+                            .pNext = &vk_typeCreateInfo,
+                            .flags = {}};
+
+  VkSemaphore semaphore;
+  VK_CHECK(
+      device->vkCreateSemaphore(*device, &vk_createInfo, nullptr, &semaphore));
+
+  this->semaphore = Handle<VkSemaphore, Device>(
+      semaphore,
+      [](VkSemaphore semaphore, Device &device) -> void {
+        device.vkDestroySemaphore(device, semaphore, nullptr);
+      },
+      device);
+}
+
+TimelineSemaphore::operator VkSemaphore() {
+  return semaphore;
+}
+
+uint64_t TimelineSemaphore::getValue() {
+  uint64_t value;
+  VK_CHECK(device->vkGetSemaphoreCounterValue(*device, semaphore, &value));
+  return value;
+}
+
+void TimelineSemaphore::signal(uint64_t value) {
+  auto vk_signalInfo =
+      VkSemaphoreSignalInfo{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+                            .pNext = nullptr,
+                            .semaphore = semaphore,
+                            .value = value};
+  VK_CHECK(device->vkSignalSemaphore(*device, &vk_signalInfo));
+}
+
+bool TimelineSemaphore::wait(uint64_t value, uint64_t timeout) {
+  VkSemaphore vk_semaphore = semaphore;
+  auto vk_waitInfo =
+      VkSemaphoreWaitInfo{.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+                          .pNext = nullptr,
+                          .flags = {},
+                          .semaphoreCount = 1,
+                          .pSemaphores = &vk_semaphore,
+                          .pValues = &value};
+  auto result = device->vkWaitSemaphores(*device, &vk_waitInfo, timeout);
+  if (result == VK_TIMEOUT)
+    return false;
+  VK_CHECK(result);
+  return true;
 }
\ No newline at end of file
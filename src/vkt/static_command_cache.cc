@@ -0,0 +1,78 @@
+#include <vkt/static_command_cache.h>
+
+static bool
+sameTarget(std::optional<CommandBufferInheritanceInfo> const &a,
+           std::optional<CommandBufferInheritanceInfo> const &b) {
+  if (a.has_value() != b.has_value())
+    return false;
+  return !a.has_value() ||
+         (a->renderPass == b->renderPass && a->subpass == b->subpass &&
+          a->framebuffer == b->framebuffer &&
+          a->renderingInfo == b->renderingInfo &&
+          a->rasterizationSamples == b->rasterizationSamples);
+}
+
+StaticCommandCache::StaticCommandCache(
+    std::shared_ptr<Device> device,
+    StaticCommandCacheCreateInfo const &createInfo) {
+  this->device = device;
+  this->createInfo = createInfo;
+
+  commandPool = std::make_shared<CommandPool>(
+      device, CommandPoolCreateInfo{.flags = {},
+                                    .queueFamilyIndex =
+                                        createInfo.queueFamilyIndex});
+}
+
+std::shared_ptr<CommandBuffer> const &StaticCommandCache::get(
+    uint32_t slot,
+    std::optional<CommandBufferInheritanceInfo> const &inheritanceInfo) {
+  if (slot >= slots.size())
+    slots.resize(slot + 1);
+
+  auto &entry = slots[slot];
+  if (!entry.valid || !sameTarget(entry.inheritanceInfo, inheritanceInfo)) {
+    entry.inheritanceInfo = inheritanceInfo;
+    record(slot);
+  }
+  return entry.commandBuffer;
+}
+
+void StaticCommandCache::invalidate() {
+  for (auto &slot : slots)
+    slot.valid = false;
+}
+
+void StaticCommandCache::invalidate(uint32_t slot) {
+  if (slot < slots.size())
+    slots[slot].valid = false;
+}
+
+uint64_t StaticCommandCache::getRecordCount() const {
+  return recordCount;
+}
+
+void StaticCommandCache::record(uint32_t slot) {
+  auto &entry = slots[slot];
+
+  // The previous buffer may still be pending, so it is replaced rather than
+  // reset.
+  entry.commandBuffer = std::make_shared<CommandBuffer>(
+      device, CommandBufferAllocateInfo{.commandPool = commandPool,
+                                        .level = createInfo.level});
+
+  auto usage = createInfo.usage;
+  if (entry.inheritanceInfo.has_value())
+    usage |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+
+  {
+    CommandBufferRecording recording(
+        entry.commandBuffer,
+        CommandBufferBeginInfo{.flags = usage,
+                               .inheritanceInfo = entry.inheritanceInfo});
+    onRecord(recording, slot);
+  }
+
+  entry.valid = true;
+  ++recordCount;
+}
@@ -0,0 +1,232 @@
+#include <vkt/task_graph.h>
+#include <algorithm>
+
+TaskGraph::TaskGraph(std::shared_ptr<Device> device,
+                     TaskGraphCreateInfo const &createInfo) {
+  this->device = device;
+  if (!device->getExtendedFeatures().timelineSemaphore)
+    throw std::runtime_error("TaskGraph needs the timelineSemaphore feature");
+
+  queues.reserve(createInfo.queues.size());
+  for (auto const &queue : createInfo.queues)
+    queues.push_back(QueueTimeline{.queue = queue,
+                                   .timeline = TimelineSemaphore(device),
+                                   .lastValue = 0,
+                                   .clock = Clock(createInfo.queues.size())});
+}
+
+TaskGraph::Clock const *TaskGraph::findClock(GpuTask task) const {
+  auto const &queue = queues[task.queue];
+  if (task.value == queue.lastValue)
+    return &queue.clock;
+
+  for (auto const &pendingTask : pending)
+    if (pendingTask.task.queue == task.queue &&
+        pendingTask.task.value == task.value)
+      return &pendingTask.clock;
+  return nullptr;
+}
+
+GpuTask TaskGraph::add(GpuTaskInfo const &taskInfo) {
+  auto &queue = queues.at(taskInfo.queue);
+  auto task = GpuTask{.queue = taskInfo.queue, .value = queue.lastValue + 1};
+
+  // The timeline only grows, so one wait per queue for the latest value
+  // covers every dependency on it.
+  std::vector<Wait> waits;
+  for (auto const &dependency : taskInfo.dependencies) {
+    auto const &other = dependency.task;
+    if (other.queue >= queues.size() ||
+        other.value > queues[other.queue].lastValue)
+      throw std::runtime_error("task depends on a task that was not added");
+
+    auto it = std::find_if(waits.begin(), waits.end(),
+                           [&](Wait const &wait) -> bool {
+                             return wait.queue == other.queue;
+                           });
+    if (it == waits.end()) {
+      waits.push_back({.queue = other.queue,
+                       .value = other.value,
+                       .dstStageMask = dependency.dstStageMask});
+      continue;
+    }
+    it->value = std::max(it->value, other.value);
+    it->dstStageMask |= dependency.dstStageMask;
+    ++stats.elidedWaits;
+  }
+
+  // A wait is implied by another when that queue only reaches its value
+  // after this one's was reached.
+  for (size_t index = 0; index < waits.size();) {
+    auto const &wait = waits[index];
+    auto implying = std::find_if(
+        waits.begin(), waits.end(), [&](Wait const &other) -> bool {
+          if (other.queue == wait.queue)
+            return false;
+          auto const *clock = findClock({other.queue, other.value});
+          return clock && (*clock)[wait.queue] >= wait.value;
+        });
+    if (implying == waits.end()) {
+      ++index;
+      continue;
+    }
+    implying->dstStageMask |= wait.dstStageMask;
+    waits.erase(waits.begin() + index);
+    ++stats.elidedWaits;
+  }
+
+  // Signals complete after everything submitted earlier to the queue.
+  auto clock = queue.clock;
+  for (auto const &wait : waits) {
+    auto const *waitClock = findClock({wait.queue, wait.value});
+    if (!waitClock) {
+      clock[wait.queue] = std::max(clock[wait.queue], wait.value);
+      continue;
+    }
+    for (size_t index = 0; index < clock.size(); ++index)
+      clock[index] = std::max(clock[index], (*waitClock)[index]);
+  }
+  clock[task.queue] = task.value;
+
+  queue.lastValue = task.value;
+  queue.clock = clock;
+  pending.push_back({.task = task,
+                     .info = taskInfo,
+                     .waits = std::move(waits),
+                     .clock = std::move(clock)});
+  ++stats.tasks;
+  return task;
+}
+
+void TaskGraph::submit() {
+  if (pending.empty())
+    return;
+
+  Clock completed(queues.size());
+  for (size_t index = 0; index < queues.size(); ++index)
+    completed[index] = queues[index].timeline.getValue();
+
+  struct Batch {
+    std::vector<VkSemaphoreSubmitInfo> waitSemaphores, signalSemaphores;
+    std::vector<VkCommandBufferSubmitInfo> commandBuffers;
+  };
+  std::vector<Batch> batches(pending.size());
+  std::vector<QueueSubmitBatch> submitBatches(pending.size());
+  // Indices into `pending` of each queue's tasks, in the order added.
+  std::vector<std::vector<size_t>> queueTasks(queues.size());
+
+  auto semaphoreInfo = [](VkSemaphore semaphore, uint64_t value,
+                          VkPipelineStageFlags2 stageMask) -> auto {
+    return VkSemaphoreSubmitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext = nullptr,
+        .semaphore = semaphore,
+        .value = value,
+        .stageMask = stageMask,
+        .deviceIndex = 0};
+  };
+
+  for (size_t index = 0; index < pending.size(); ++index) {
+    auto const &[task, info, waits, _] = pending[index];
+    auto &batch = batches[index];
+
+    for (auto const &wait : waits) {
+      if (wait.value <= completed[wait.queue]) {
+        ++stats.elidedWaits;
+        continue;
+      }
+      batch.waitSemaphores.push_back(semaphoreInfo(
+          queues[wait.queue].timeline, wait.value, wait.dstStageMask));
+      ++stats.waits;
+    }
+    for (auto const &[semaphore, stage] : info.waitSemaphores)
+      batch.waitSemaphores.push_back(semaphoreInfo(semaphore, 0, stage));
+
+    for (auto commandBuffer : info.commandBuffers)
+      batch.commandBuffers.push_back(VkCommandBufferSubmitInfo{
+          .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+          .pNext = nullptr,
+          .commandBuffer = commandBuffer,
+          .deviceMask = 0});
+
+    batch.signalSemaphores.push_back(
+        semaphoreInfo(queues[task.queue].timeline, task.value,
+                      VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT));
+    for (auto semaphore : info.signalSemaphores)
+      batch.signalSemaphores.push_back(
+          semaphoreInfo(semaphore, 0, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT));
+
+    submitBatches[index] =
+        QueueSubmitBatch{.waitSemaphores = batch.waitSemaphores,
+                         .commandBuffers = batch.commandBuffers,
+                         .signalSemaphores = batch.signalSemaphores};
+    queueTasks[task.queue].push_back(index);
+  }
+
+  // Highest value of each timeline whose signal has been submitted.
+  Clock submitted(queues.size());
+  for (size_t index = 0; index < queues.size(); ++index)
+    submitted[index] = queueTasks[index].empty()
+                           ? queues[index].lastValue
+                           : pending[queueTasks[index].front()].task.value - 1;
+
+  // A wait is only submitted after its signal: two entries of `queues` may
+  // be the same VkQueue, which would never reach a signal queued behind the
+  // wait. Each round submits, per queue, the run of its next tasks whose
+  // waits are all submitted. Tasks only depend on earlier ones, so every
+  // round submits at least the earliest remaining task.
+  std::vector<size_t> next(queues.size(), 0);
+  std::vector<QueueSubmitBatch> run;
+  for (auto remaining = pending.size(); remaining > 0;) {
+    for (size_t queue = 0; queue < queues.size(); ++queue) {
+      auto const &tasks = queueTasks[queue];
+      run.clear();
+      for (; next[queue] < tasks.size(); ++next[queue]) {
+        auto const &pendingTask = pending[tasks[next[queue]]];
+        auto ready = std::all_of(
+            pendingTask.waits.begin(), pendingTask.waits.end(),
+            [&](Wait const &wait) -> bool {
+              return wait.queue == queue ||
+                     wait.value <= submitted[wait.queue];
+            });
+        if (!ready)
+          break;
+        run.push_back(submitBatches[tasks[next[queue]]]);
+        submitted[queue] = pendingTask.task.value;
+      }
+      if (run.empty())
+        continue;
+
+      queues[queue].queue.submit(run);
+      ++stats.submits;
+      remaining -= run.size();
+    }
+  }
+
+  pending.clear();
+}
+
+bool TaskGraph::isComplete(GpuTask task) {
+  return queues.at(task.queue).timeline.getValue() >= task.value;
+}
+
+void TaskGraph::wait(GpuTask task) {
+  auto isPending = std::any_of(
+      pending.begin(), pending.end(), [&](PendingTask const &other) -> bool {
+        return other.task.queue == task.queue &&
+               other.task.value == task.value;
+      });
+  if (isPending)
+    submit();
+  queues.at(task.queue).timeline.wait(task.value);
+}
+
+void TaskGraph::waitIdle() {
+  submit();
+  for (auto &queue : queues)
+    queue.timeline.wait(queue.lastValue);
+}
+
+TaskGraphStats const &TaskGraph::getStats() const {
+  return stats;
+}
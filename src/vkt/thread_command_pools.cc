@@ -0,0 +1,55 @@
+#include <vkt/thread_command_pools.h>
+#include <stdexcept>
+
+ThreadCommandPools::ThreadCommandPools(
+    std::shared_ptr<Device> device,
+    ThreadCommandPoolsCreateInfo const &createInfo) {
+  this->device = device;
+  this->createInfo = createInfo;
+
+  pools.resize((size_t)createInfo.framesInFlight * createInfo.threadCount);
+  for (auto &pool : pools)
+    pool.commandPool = std::make_shared<CommandPool>(
+        device,
+        CommandPoolCreateInfo{.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+                              .queueFamilyIndex = createInfo.queueFamilyIndex});
+}
+
+void ThreadCommandPools::beginFrame(uint32_t frameIndex) {
+  this->frameIndex = frameIndex % createInfo.framesInFlight;
+
+  for (uint32_t thread = 0; thread < createInfo.threadCount; ++thread) {
+    auto &pool = pools[this->frameIndex * createInfo.threadCount + thread];
+    if (pool.primariesUsed == 0 && pool.secondariesUsed == 0)
+      continue;
+    pool.commandPool->reset();
+    for (size_t i = 0; i < pool.primariesUsed; ++i)
+      pool.primaries[i]->releaseRetained();
+    for (size_t i = 0; i < pool.secondariesUsed; ++i)
+      pool.secondaries[i]->releaseRetained();
+    pool.primariesUsed = pool.secondariesUsed = 0;
+  }
+}
+
+std::shared_ptr<CommandBuffer>
+ThreadCommandPools::allocate(uint32_t threadIndex,
+                             VkCommandBufferLevel level) {
+  if (threadIndex >= createInfo.threadCount)
+    throw std::runtime_error("thread index out of range");
+
+  auto &pool = pools[frameIndex * createInfo.threadCount + threadIndex];
+
+  auto primary = level == VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  auto &buffers = primary ? pool.primaries : pool.secondaries;
+  auto &used = primary ? pool.primariesUsed : pool.secondariesUsed;
+
+  if (used == buffers.size())
+    buffers.push_back(std::make_shared<CommandBuffer>(
+        device, CommandBufferAllocateInfo{.commandPool = pool.commandPool,
+                                          .level = level}));
+  return buffers[used++];
+}
+
+uint32_t ThreadCommandPools::getThreadCount() const {
+  return createInfo.threadCount;
+}
@@ -0,0 +1,520 @@
+#include <vkt/upload_context.h>
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+static uint64_t alignUp(uint64_t x, uint64_t alignment) {
+  return (x + alignment - 1) / alignment * alignment;
+}
+
+UploadContext::UploadContext(std::shared_ptr<Device> device,
+                             Queue const &transferQueue,
+                             UploadContextCreateInfo const &createInfo)
+    : queue{transferQueue}, stagingFlushes{device} {
+  this->device = device;
+  this->createInfo = createInfo;
+  this->createInfo.chunkSize =
+      std::min(createInfo.chunkSize, createInfo.stagingSize);
+
+  commandPool = std::make_shared<CommandPool>(
+      device,
+      CommandPoolCreateInfo{
+          .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+                   VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+          .queueFamilyIndex = queue.getQueueFamilyIndex()});
+
+  batches.resize(std::max(createInfo.maxBatchesInFlight, 1u));
+  for (auto &batch : batches) {
+    batch.commandBuffer = std::make_shared<CommandBuffer>(
+        device,
+        CommandBufferAllocateInfo{.commandPool = commandPool,
+                                  .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY});
+    batch.fence = std::make_shared<Fence>(device, true);
+  }
+}
+
+UploadContext::~UploadContext() {
+  waitIdle();
+}
+
+UploadToken UploadContext::upload(std::shared_ptr<Buffer> const &dst,
+                                  void const *data, VkDeviceSize size,
+                                  BufferUploadInfo const &uploadInfo) {
+  return uploadBuffer(*dst, dst, data, size, uploadInfo);
+}
+
+UploadToken UploadContext::upload(Buffer &dst, void const *data,
+                                  VkDeviceSize size,
+                                  BufferUploadInfo const &uploadInfo) {
+  return uploadBuffer(dst, nullptr, data, size, uploadInfo);
+}
+
+UploadToken
+UploadContext::uploadFromHost(std::shared_ptr<Buffer> const &dst,
+                              void const *data, VkDeviceSize size,
+                              BufferUploadInfo const &uploadInfo) {
+  return uploadBufferFromHost(*dst, dst, data, size, uploadInfo);
+}
+
+UploadToken UploadContext::uploadFromHost(Buffer &dst, void const *data,
+                                          VkDeviceSize size,
+                                          BufferUploadInfo const &uploadInfo) {
+  return uploadBufferFromHost(dst, nullptr, data, size, uploadInfo);
+}
+
+UploadToken UploadContext::upload(std::shared_ptr<Image> const &dst,
+                                  void const *data, VkDeviceSize size,
+                                  ImageUploadInfo const &uploadInfo) {
+  return uploadImage(*dst, dst, data, size, uploadInfo);
+}
+
+UploadToken UploadContext::upload(Image &dst, void const *data,
+                                  VkDeviceSize size,
+                                  ImageUploadInfo const &uploadInfo) {
+  return uploadImage(dst, nullptr, data, size, uploadInfo);
+}
+
+void UploadContext::checkOwner(VkSharingMode sharingMode,
+                               void const *owner) const {
+  if (needsTransfer(sharingMode) && owner == nullptr)
+    throw std::runtime_error(
+        "ownership transfers need a destination passed by shared_ptr");
+}
+
+UploadToken UploadContext::uploadBuffer(Buffer &dst,
+                                        std::shared_ptr<Buffer> const &owner,
+                                        void const *data, VkDeviceSize size,
+                                        BufferUploadInfo const &uploadInfo) {
+  checkOwner(dst.getSharingMode(), owner.get());
+  std::lock_guard<std::mutex> guard(mutex);
+
+  auto dstOffset = uploadInfo.dstOffset;
+  auto alignment = std::max<VkDeviceSize>(
+      device->physDev.properties.limits.optimalBufferCopyOffsetAlignment, 4);
+
+  for (VkDeviceSize done = 0; done < size;) {
+    auto chunk = std::min(size - done, createInfo.chunkSize);
+    auto srcOffset = stage((char const *)data + done, chunk, alignment);
+
+    record().copyBuffer(*staging, dst,
+                        {VkBufferCopy{.srcOffset = srcOffset,
+                                      .dstOffset = dstOffset + done,
+                                      .size = chunk}});
+    done += chunk;
+  }
+
+  release(dst, owner, size, uploadInfo);
+  return UploadToken{.batch = recordingBatch};
+}
+
+UploadToken UploadContext::uploadBufferFromHost(
+    Buffer &dst, std::shared_ptr<Buffer> const &owner, void const *data,
+    VkDeviceSize size, BufferUploadInfo const &uploadInfo) {
+  checkOwner(dst.getSharingMode(), owner.get());
+  auto source = Buffer::importHostMemory(device, data, size);
+  if (source == nullptr)
+    return uploadBuffer(dst, owner, data, size, uploadInfo);
+
+  std::lock_guard<std::mutex> guard(mutex);
+
+  record().copyBuffer(*source, dst,
+                      {VkBufferCopy{.srcOffset = 0,
+                                    .dstOffset = uploadInfo.dstOffset,
+                                    .size = size}});
+  batch(recordingBatch).keepAlive.push_back(source);
+
+  release(dst, owner, size, uploadInfo);
+  return UploadToken{.batch = recordingBatch};
+}
+
+void UploadContext::release(Buffer &dst, std::shared_ptr<Buffer> const &owner,
+                            VkDeviceSize size,
+                            BufferUploadInfo const &uploadInfo) {
+  if (needsTransfer(dst.getSharingMode())) {
+    auto release = VkBufferMemoryBarrier{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = {},
+        .srcQueueFamilyIndex = queue.getQueueFamilyIndex(),
+        .dstQueueFamilyIndex = createInfo.dstQueueFamilyIndex,
+        .buffer = dst,
+        .offset = uploadInfo.dstOffset,
+        .size = size};
+    record().pipelineBarrier(
+        DependencyInfo{.srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       .dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                       .dependencyFlags = {},
+                       .bufferMemoryBarriers = {release}});
+
+    auto acquire = release;
+    acquire.srcAccessMask = {};
+    acquire.dstAccessMask = uploadInfo.dstAccessMask;
+    recordingTransfers.bufferBarriers.push_back(acquire);
+    recordingTransfers.dstStageMask |= uploadInfo.dstStageMask;
+    recordingTransfers.resources.push_back(owner);
+  }
+}
+
+UploadToken UploadContext::uploadImage(Image &dst,
+                                       std::shared_ptr<Image> const &owner,
+                                       void const *data, VkDeviceSize size,
+                                       ImageUploadInfo const &uploadInfo) {
+  checkOwner(dst.getSharingMode(), owner.get());
+  std::lock_guard<std::mutex> guard(mutex);
+
+  auto extent = dst.createInfo.extent;
+  auto subresourceRange =
+      VkImageSubresourceRange{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                              .baseMipLevel = 0,
+                              .levelCount = 1,
+                              .baseArrayLayer = 0,
+                              .layerCount = 1};
+
+  // Chunks are whole rows for 2D images and whole slices for 3D ones.
+  auto unitCount = extent.depth > 1 ? extent.depth : extent.height;
+  auto unitSize = size / unitCount;
+  auto texelSize = unitSize / (extent.depth > 1
+                                   ? (VkDeviceSize)extent.width * extent.height
+                                   : (VkDeviceSize)extent.width);
+  auto unitsPerChunk = (uint32_t)(createInfo.chunkSize / unitSize);
+  if (unitsPerChunk == 0)
+    throw std::runtime_error("image row or slice exceeds upload chunk size");
+
+  auto alignment = std::lcm(
+      std::lcm<VkDeviceSize>(texelSize, 4),
+      device->physDev.properties.limits.optimalBufferCopyOffsetAlignment);
+
+  auto transfer = needsTransfer(dst.getSharingMode());
+
+  // Mips are generated here if this queue can blit or dispatch; otherwise
+  // level 0 is handed over as is and the chain is built after the acquire.
+  // Checked before anything is recorded or staged, so a failed upload leaves
+  // nothing behind that refers to the image.
+  auto generateMips = uploadInfo.generateMips && dst.createInfo.mipLevels > 1;
+  auto generateHere = false;
+  if (generateMips) {
+    if (createInfo.mipGenerator == nullptr)
+      throw std::runtime_error("mip generation needs a MipGenerator");
+    if (!createInfo.mipGenerator->method(dst).has_value())
+      throw std::runtime_error("image format cannot be mip-mapped");
+
+    auto required = createInfo.mipGenerator->requiredQueueFlags(dst);
+    auto queueFlags =
+        device->physDev.queueFamilies[queue.getQueueFamilyIndex()].queueFlags;
+    generateHere = (queueFlags & required) == required;
+    if (!generateHere && !transfer)
+      throw std::runtime_error("upload queue cannot generate mips");
+  }
+
+  record().pipelineBarrier(
+      DependencyInfo{.srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                     .dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+                     .dependencyFlags = {},
+                     .imageMemoryBarriers = {VkImageMemoryBarrier{
+                         .srcAccessMask = {},
+                         .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                         .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                         .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                         .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                         .image = dst,
+                         .subresourceRange = subresourceRange}}});
+
+  for (uint32_t unit = 0; unit < unitCount; unit += unitsPerChunk) {
+    auto units = std::min(unitsPerChunk, unitCount - unit);
+    auto srcOffset =
+        stage((char const *)data + unit * unitSize, units * unitSize,
+              alignment);
+
+    auto imageOffset = VkOffset3D{};
+    auto imageExtent = extent;
+    if (extent.depth > 1) {
+      imageOffset.z = (int32_t)unit;
+      imageExtent.depth = units;
+    } else {
+      imageOffset.y = (int32_t)unit;
+      imageExtent.height = units;
+    }
+
+    record().copyBufferToImage(CopyBufferToImageInfo{
+        .srcBuffer = *staging,
+        .dstImage = dst,
+        .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .regions = {VkBufferImageCopy{
+            .bufferOffset = srcOffset,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource =
+                VkImageSubresourceLayers{.aspectMask =
+                                             VK_IMAGE_ASPECT_COLOR_BIT,
+                                         .mipLevel = 0,
+                                         .baseArrayLayer = 0,
+                                         .layerCount = 1},
+            .imageOffset = imageOffset,
+            .imageExtent = imageExtent}}});
+  }
+
+  if (generateHere) {
+    // Before a transfer, the generator's last barrier must reach the
+    // release's ALL_COMMANDS source scope to order the release after its
+    // writes.
+    createInfo.mipGenerator->generate(
+        record(), dst,
+        MipGenerateInfo{.dstStageMask =
+                            transfer ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+                                     : uploadInfo.dstStageMask,
+                        .dstAccessMask = transfer ? VK_ACCESS_MEMORY_WRITE_BIT
+                                                  : uploadInfo.dstAccessMask,
+                        .dstLayout = uploadInfo.dstLayout},
+        batch(recordingBatch).keepAlive);
+    subresourceRange.levelCount = dst.createInfo.mipLevels;
+  }
+
+  if (!transfer && !generateHere) {
+    record().pipelineBarrier(DependencyInfo{
+        .srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+        .dstStageMask = uploadInfo.dstStageMask,
+        .dependencyFlags = {},
+        .imageMemoryBarriers = {VkImageMemoryBarrier{
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = uploadInfo.dstAccessMask,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = uploadInfo.dstLayout,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = dst,
+            .subresourceRange = subresourceRange}}});
+  }
+
+  if (transfer) {
+    // Any layout transition happens in the release and is repeated verbatim
+    // in the acquire.
+    auto deferMips = generateMips && !generateHere;
+    auto oldLayout = generateHere ? uploadInfo.dstLayout
+                                  : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    auto newLayout = generateMips ? oldLayout : uploadInfo.dstLayout;
+
+    auto release = VkImageMemoryBarrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .pNext = nullptr,
+        .srcAccessMask = generateHere ? VK_ACCESS_MEMORY_WRITE_BIT
+                                      : VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = {},
+        .oldLayout = oldLayout,
+        .newLayout = newLayout,
+        .srcQueueFamilyIndex = queue.getQueueFamilyIndex(),
+        .dstQueueFamilyIndex = createInfo.dstQueueFamilyIndex,
+        .image = dst,
+        .subresourceRange = subresourceRange};
+    record().pipelineBarrier(DependencyInfo{
+        .srcStageMask = generateHere ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT
+                                     : VK_PIPELINE_STAGE_TRANSFER_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        .dependencyFlags = {},
+        .imageMemoryBarriers = {release}});
+
+    auto acquire = release;
+    acquire.srcAccessMask = {};
+    acquire.dstAccessMask = deferMips ? VK_ACCESS_TRANSFER_WRITE_BIT |
+                                            VK_ACCESS_TRANSFER_READ_BIT
+                                      : uploadInfo.dstAccessMask;
+    recordingTransfers.imageBarriers.push_back(acquire);
+    recordingTransfers.dstStageMask |=
+        deferMips ? VK_PIPELINE_STAGE_TRANSFER_BIT : uploadInfo.dstStageMask;
+    recordingTransfers.resources.push_back(owner);
+
+    if (deferMips)
+      recordingTransfers.deferredMips.emplace_back(
+          owner, MipGenerateInfo{.dstStageMask = uploadInfo.dstStageMask,
+                                 .dstAccessMask = uploadInfo.dstAccessMask,
+                                 .dstLayout = uploadInfo.dstLayout});
+  }
+
+  return UploadToken{.batch = recordingBatch};
+}
+
+UploadToken
+UploadContext::flush(std::vector<VkSemaphore> const &signalSemaphores) {
+  std::lock_guard<std::mutex> guard(mutex);
+  auto token = UploadToken{.batch = recordingBatch};
+  if (recording != nullptr || !signalSemaphores.empty())
+    submit(signalSemaphores);
+  else
+    token.batch -= 1;
+  return token;
+}
+
+OwnershipAcquire
+UploadContext::acquireOwnership(CommandBufferRecording &recording) {
+  std::lock_guard<std::mutex> guard(mutex);
+
+  if (!recordingTransfers.bufferBarriers.empty() ||
+      !recordingTransfers.imageBarriers.empty())
+    submit({});
+
+  OwnershipAcquire acquire = {.token = {.batch = recordingBatch - 1}};
+  for (auto &transfer : pendingTransfers) {
+    // Waiting at the acquire's own stages chains the semaphore wait to the
+    // barrier, so the acquire (and its layout transition) follow the
+    // release.
+    recording.pipelineBarrier(
+        DependencyInfo{.srcStageMask = transfer.dstStageMask,
+                       .dstStageMask = transfer.dstStageMask,
+                       .dependencyFlags = {},
+                       .bufferMemoryBarriers = transfer.bufferBarriers,
+                       .imageMemoryBarriers = transfer.imageBarriers});
+
+    acquire.waitSemaphoresAndStages.emplace_back(*transfer.semaphore,
+                                                 transfer.dstStageMask);
+    acquire.keepAlive.push_back(transfer.semaphore);
+    // The acquire barriers and mip generation refer to the resources.
+    for (auto &resource : transfer.resources)
+      acquire.keepAlive.push_back(std::move(resource));
+
+    for (auto &[image, generateInfo] : transfer.deferredMips)
+      createInfo.mipGenerator->generate(recording, *image, generateInfo,
+                                        acquire.keepAlive);
+  }
+  pendingTransfers.clear();
+
+  return acquire;
+}
+
+bool UploadContext::isComplete(UploadToken token) {
+  std::lock_guard<std::mutex> guard(mutex);
+  if (token.batch < oldestInFlight)
+    return true;
+  if (token.batch >= recordingBatch)
+    return false;
+  return batch(token.batch).fence->isSignalled();
+}
+
+void UploadContext::wait(UploadToken token) {
+  std::lock_guard<std::mutex> guard(mutex);
+  if (token.batch >= recordingBatch && recording != nullptr)
+    submit({});
+  while (oldestInFlight <= token.batch && oldestInFlight < recordingBatch)
+    retireOldest();
+}
+
+void UploadContext::waitIdle() {
+  wait(UploadToken{.batch = recordingBatch});
+}
+
+void UploadContext::keepAlive(std::shared_ptr<void> object) {
+  std::lock_guard<std::mutex> guard(mutex);
+  // Batches retire in order, so the newest one that may use the object is
+  // the last to let go of it.
+  if (recording != nullptr)
+    batch(recordingBatch).keepAlive.push_back(std::move(object));
+  else if (recordingBatch - 1 >= oldestInFlight)
+    batch(recordingBatch - 1).keepAlive.push_back(std::move(object));
+}
+
+bool UploadContext::canGenerateMips() const {
+  return createInfo.mipGenerator != nullptr;
+}
+
+bool UploadContext::needsTransfer(VkSharingMode sharingMode) const {
+  return sharingMode == VK_SHARING_MODE_EXCLUSIVE &&
+         createInfo.dstQueueFamilyIndex != VK_QUEUE_FAMILY_IGNORED &&
+         createInfo.dstQueueFamilyIndex != queue.getQueueFamilyIndex();
+}
+
+UploadContext::Batch &UploadContext::batch(uint64_t id) {
+  return batches[id % batches.size()];
+}
+
+CommandBufferRecording &UploadContext::record() {
+  if (recording == nullptr) {
+    // The slot is still owned by an older batch until that one retires.
+    while (recordingBatch - oldestInFlight >= batches.size())
+      retireOldest();
+
+    auto &current = batch(recordingBatch);
+    current.id = recordingBatch;
+    current.commandBuffer->reset();
+    recording = std::make_unique<CommandBufferRecording>(
+        current.commandBuffer,
+        CommandBufferBeginInfo{
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT});
+  }
+  return *recording;
+}
+
+VkDeviceSize UploadContext::stage(void const *data, VkDeviceSize size,
+                                  VkDeviceSize alignment) {
+  auto ringSize = createInfo.stagingSize;
+
+  // Created on first use, so that contexts only copying from imported host
+  // memory never allocate it.
+  if (staging == nullptr) {
+    staging = std::make_shared<Buffer>(
+        device,
+        BufferCreateInfo{.size = ringSize,
+                         .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+                         .queueFamilyIndices = {queue.getQueueFamilyIndex()}});
+    stagingMemory = &staging->allocMemory(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    stagingMemory->map();
+  }
+
+  while (true) {
+    auto position = alignUp(stagingHead, alignment);
+    if (position % ringSize + size > ringSize)
+      position = alignUp(position, ringSize);
+
+    if (position + size - stagingTail <= ringSize) {
+      stagingHead = position + size;
+      auto offset = position % ringSize;
+      std::memcpy((char *)stagingMemory->map() + offset, data, size);
+      stagingMemory->addTo(stagingFlushes, offset, size);
+      return offset;
+    }
+
+    if (oldestInFlight < recordingBatch) {
+      retireOldest();
+    } else if (recording != nullptr) {
+      // The copies recorded so far use the space this one needs.
+      submit({});
+    } else {
+      stagingHead = stagingTail = alignUp(stagingHead, ringSize);
+    }
+  }
+}
+
+void UploadContext::submit(std::vector<VkSemaphore> const &signalSemaphores) {
+  record();
+  recording = nullptr;
+  stagingFlushes.flush();
+
+  auto &current = batch(recordingBatch);
+  current.stagingEnd = stagingHead;
+  current.fence->reset();
+
+  auto semaphores = signalSemaphores;
+  if (!recordingTransfers.bufferBarriers.empty() ||
+      !recordingTransfers.imageBarriers.empty()) {
+    recordingTransfers.semaphore = std::make_shared<Semaphore>(device);
+    semaphores.push_back(*recordingTransfers.semaphore);
+    pendingTransfers.push_back(std::move(recordingTransfers));
+    recordingTransfers = {};
+  }
+
+  queue.submit(QueueSubmitInfo{.waitSemaphoresAndStages = {},
+                               .commandBuffers = {*current.commandBuffer},
+                               .signalSemaphores = semaphores,
+                               .fence = *current.fence});
+  recordingBatch += 1;
+}
+
+void UploadContext::retireOldest() {
+  auto &oldest = batch(oldestInFlight);
+  oldest.fence->wait();
+  oldest.keepAlive.clear();
+  stagingTail = oldest.stagingEnd;
+  oldestInFlight += 1;
+}